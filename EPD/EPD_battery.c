@@ -0,0 +1,174 @@
+#include <string.h>
+#include "EPD_battery.h"
+#include "nrf_log.h"
+
+#define BATTERY_HYSTERESIS 5 // 50 mV, a state is left only this far above its threshold
+
+typedef struct {
+    uint32_t day;                       // timestamp / 86400 of daily[0]
+    uint8_t daily[BATTERY_DAILY_SIZE];  // newest first
+    uint8_t reserved[2];                // word size
+} battery_record_t;
+
+static struct {
+    epd_config_t *cfg;
+    battery_state_t state;
+    uint8_t level;                        // last sample
+    uint32_t hour;                        // timestamp / 3600 of hourly[0]
+    uint8_t hourly[BATTERY_HOURLY_SIZE];  // newest first
+    battery_record_t record;              // written to flash once a day
+} m_battery;
+
+// Discharge curve of a lithium coin cell under a light load
+static const struct {
+    uint16_t mv;
+    uint8_t percent;
+} m_discharge[] = {
+    {BATTERY_FULL_MV, 100}, {2900, 80}, {2800, 60}, {2700, 40}, {2600, 25}, {2500, 15}, {2400, 8}, {2200, 0},
+};
+
+// Policies each state applies, if enabled in the config
+static const uint8_t m_state_policies[] = {
+    [BATTERY_OK]       = 0,
+    [BATTERY_LOW]      = BATTERY_POLICY_SLOW_CLOCK | BATTERY_POLICY_SLOW_ADV,
+    [BATTERY_CRITICAL] = BATTERY_POLICY_SLOW_CLOCK | BATTERY_POLICY_SLOW_ADV | BATTERY_POLICY_NO_CLOCK,
+    [BATTERY_EMPTY]    = BATTERY_POLICY_SLOW_CLOCK | BATTERY_POLICY_SLOW_ADV | BATTERY_POLICY_NO_CLOCK |
+                         BATTERY_POLICY_SKIP_REFRESH,
+};
+
+static uint8_t battery_threshold(uint8_t value, uint16_t mv)
+{
+    return value != BATTERY_NONE ? value : BATTERY_LEVEL(mv);
+}
+
+// Move the history by count slots, the newest ones are empty
+static void battery_shift(uint8_t *history, uint8_t size, uint32_t count)
+{
+    if (count < size)
+        memmove(history + count, history, size - count);
+    memset(history, BATTERY_NONE, count < size ? count : size);
+}
+
+static battery_state_t battery_state(uint8_t level)
+{
+    uint8_t thresholds[] = {
+        battery_threshold(m_battery.cfg->battery_low, BATTERY_LOW_MV),
+        battery_threshold(m_battery.cfg->battery_critical, BATTERY_CRITICAL_MV),
+        battery_threshold(m_battery.cfg->battery_empty, BATTERY_EMPTY_MV),
+    };
+    battery_state_t state = BATTERY_OK;
+
+    for (uint8_t i = 0; i < sizeof(thresholds); i++) {
+        uint16_t threshold = thresholds[i] + (m_battery.state > i ? BATTERY_HYSTERESIS : 0);
+        if (level < threshold) state = (battery_state_t)(i + 1);
+    }
+    return state;
+}
+
+// Days until the empty threshold at the discharge rate of the daily history
+static uint16_t battery_days_left(void)
+{
+    uint8_t *daily = m_battery.record.daily;
+    uint8_t empty = battery_threshold(m_battery.cfg->battery_empty, BATTERY_EMPTY_MV);
+
+    if (daily[0] == BATTERY_NONE || daily[0] <= empty) return daily[0] == BATTERY_NONE ? 0xFFFF : 0;
+    for (uint8_t i = BATTERY_DAILY_SIZE - 1; i >= 2; i--) {
+        if (daily[i] == BATTERY_NONE) continue;
+        if (daily[i] <= daily[0]) break; // not discharging
+        uint32_t days = (uint32_t)(daily[0] - empty) * i / (daily[i] - daily[0]);
+        return days < 0xFFFF ? days : 0xFFFE;
+    }
+    return 0xFFFF;
+}
+
+void epd_battery_init(epd_config_t *cfg)
+{
+    memset(&m_battery, 0, sizeof(m_battery));
+    m_battery.cfg = cfg;
+    m_battery.level = BATTERY_NONE;
+    memset(m_battery.hourly, BATTERY_NONE, sizeof(m_battery.hourly));
+    memset(m_battery.record.daily, BATTERY_NONE, sizeof(m_battery.record.daily));
+    epd_config_record_read(EPD_BATTERY_REC_KEY, &m_battery.record, sizeof(battery_record_t));
+}
+
+bool epd_battery_update(float voltage, uint32_t timestamp)
+{
+    uint16_t mv = voltage > 0 ? (uint16_t)(voltage * 1000) : 0;
+    uint8_t level = mv < 1000 ? 0 : mv >= BATTERY_MV(BATTERY_NONE) ? BATTERY_NONE - 1 : BATTERY_LEVEL(mv);
+    uint32_t hour = timestamp / 3600, day = timestamp / 86400;
+    bool new_day = false;
+
+    // the time restarts from the build default after a reset, keep it in the newest slot until synced
+    if (hour > m_battery.hour) {
+        battery_shift(m_battery.hourly, BATTERY_HOURLY_SIZE, hour - m_battery.hour);
+        m_battery.hour = hour;
+    }
+    if (day > m_battery.record.day) {
+        battery_shift(m_battery.record.daily, BATTERY_DAILY_SIZE, day - m_battery.record.day);
+        m_battery.record.day = day;
+        new_day = true;
+    }
+    if (level < m_battery.hourly[0]) m_battery.hourly[0] = level;
+    if (level < m_battery.record.daily[0]) m_battery.record.daily[0] = level;
+    if (new_day)
+        epd_config_record_write(EPD_BATTERY_REC_KEY, &m_battery.record, sizeof(battery_record_t));
+
+    battery_state_t state = battery_state(level);
+    bool changed = state != m_battery.state;
+    if (changed) NRF_LOG_INFO("battery state %d -> %d (%d mV)\n", m_battery.state, state, mv);
+    m_battery.level = level;
+    m_battery.state = state;
+    return changed;
+}
+
+battery_state_t epd_battery_state(void)
+{
+    return m_battery.state;
+}
+
+bool epd_battery_policy(uint8_t policy)
+{
+    return (m_battery.cfg->battery_policy & m_state_policies[m_battery.state] & policy) != 0;
+}
+
+uint16_t epd_battery_empty_mv(void)
+{
+    if (m_battery.cfg == NULL) return BATTERY_EMPTY_MV;
+    return BATTERY_MV(battery_threshold(m_battery.cfg->battery_empty, BATTERY_EMPTY_MV));
+}
+
+uint8_t epd_battery_percent(uint16_t mv)
+{
+    if (mv >= m_discharge[0].mv) return m_discharge[0].percent;
+    for (uint8_t i = 1; i < sizeof(m_discharge) / sizeof(m_discharge[0]); i++) {
+        if (mv >= m_discharge[i].mv) {
+            uint16_t span = m_discharge[i - 1].mv - m_discharge[i].mv;
+            return m_discharge[i].percent +
+                   (m_discharge[i - 1].percent - m_discharge[i].percent) * (mv - m_discharge[i].mv) / span;
+        }
+    }
+    return 0;
+}
+
+void epd_battery_status(uint8_t *buf)
+{
+    uint16_t mv = m_battery.level != BATTERY_NONE ? BATTERY_MV(m_battery.level) : 0;
+    uint16_t days = battery_days_left();
+
+    buf[0] = m_battery.state;
+    buf[1] = m_battery.level != BATTERY_NONE ? epd_battery_percent(mv) : 0xFF;
+    buf[2] = mv >> 8;
+    buf[3] = mv & 0xFF;
+    buf[4] = days >> 8;
+    buf[5] = days & 0xFF;
+    buf[6] = m_battery.cfg->battery_policy;
+    buf[7] = battery_threshold(m_battery.cfg->battery_low, BATTERY_LOW_MV);
+    buf[8] = battery_threshold(m_battery.cfg->battery_critical, BATTERY_CRITICAL_MV);
+    buf[9] = battery_threshold(m_battery.cfg->battery_empty, BATTERY_EMPTY_MV);
+}
+
+void epd_battery_history(uint8_t *buf)
+{
+    memcpy(buf, m_battery.hourly, BATTERY_HOURLY_SIZE);
+    memcpy(buf + BATTERY_HOURLY_SIZE, m_battery.record.daily, BATTERY_DAILY_SIZE);
+}
@@ -0,0 +1,56 @@
+#ifndef __EPD_BATTERY_H
+#define __EPD_BATTERY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "EPD_config.h"
+
+// Battery voltage in one byte: 10 mV steps above 1 V, BATTERY_NONE if not sampled
+#define BATTERY_LEVEL(mv)      ((uint8_t)(((mv) - 1000) / 10))
+#define BATTERY_MV(level)      ((uint16_t)((level) * 10 + 1000))
+#define BATTERY_NONE           0xFF
+
+// Thresholds used while the config has none (0xFF)
+#define BATTERY_LOW_MV         2600
+#define BATTERY_CRITICAL_MV    2400
+#define BATTERY_EMPTY_MV       2200
+// A fresh coin cell, the full end of the battery icon
+#define BATTERY_FULL_MV        3000
+
+typedef enum {
+    BATTERY_OK = 0,
+    BATTERY_LOW = 1,       // below battery_low
+    BATTERY_CRITICAL = 2,  // below battery_critical
+    BATTERY_EMPTY = 3,     // below battery_empty, too low to finish a waveform
+} battery_state_t;
+
+// Governor policies (epd_config_t.battery_policy bits) and the state they start at
+#define BATTERY_POLICY_SLOW_CLOCK    0x01 // LOW: clock mode refreshes every 5 minutes
+#define BATTERY_POLICY_SLOW_ADV      0x02 // LOW: longer advertising interval
+#define BATTERY_POLICY_NO_CLOCK      0x04 // CRITICAL: clock mode falls back to the calendar
+#define BATTERY_POLICY_SKIP_REFRESH  0x08 // EMPTY: no display updates
+
+#define BATTERY_HOURLY_SIZE 24 // RAM history, minimum of each hour
+#define BATTERY_DAILY_SIZE  14 // flash history, minimum of each day
+
+#define BATTERY_STATUS_SIZE  10
+#define BATTERY_HISTORY_SIZE (BATTERY_HOURLY_SIZE + BATTERY_DAILY_SIZE)
+
+// Load the history from flash, cfg holds the policy and thresholds
+void epd_battery_init(epd_config_t *cfg);
+// Add a sample taken at timestamp, returns true if the state changed
+bool epd_battery_update(float voltage, uint32_t timestamp);
+battery_state_t epd_battery_state(void);
+// True if the policy is enabled and the current state applies it
+bool epd_battery_policy(uint8_t policy);
+// Empty end of the battery icon (mV): the battery_empty threshold
+uint16_t epd_battery_empty_mv(void);
+// Remaining capacity estimated from the voltage (percent)
+uint8_t epd_battery_percent(uint16_t mv);
+// State, capacity (%), voltage (mV, big endian), days left (big endian, 0xFFFF: unknown),
+// policy and the low/critical/empty thresholds: BATTERY_STATUS_SIZE bytes
+void epd_battery_status(uint8_t *buf);
+// Hourly then daily history, newest first: BATTERY_HISTORY_SIZE bytes
+void epd_battery_history(uint8_t *buf);
+
+#endif
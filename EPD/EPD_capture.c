@@ -0,0 +1,174 @@
+#include <string.h>
+#include "EPD_capture.h"
+
+#if EPD_CAPTURE_SIZE > 0
+
+#if EPD_CAPTURE_SIZE < 4 * (10 + EPD_CAPTURE_DATA_MAX) || EPD_CAPTURE_SIZE > 0xFFFF
+#error "EPD_CAPTURE_SIZE out of range"
+#endif
+
+#define RECORD_NONE 0xFFFF
+
+static struct {
+    uint8_t buf[EPD_CAPTURE_SIZE];
+    uint16_t head;    // next write position
+    uint16_t tail;    // oldest record
+    uint16_t used;
+    uint16_t last;    // DATA/READ record still being merged into
+    uint16_t dropped;
+    uint32_t ticks;   // time of the previous record
+    bool enabled;
+} m_capture;
+
+static uint8_t capture_get(uint32_t pos)
+{
+    return m_capture.buf[pos % EPD_CAPTURE_SIZE];
+}
+
+static void capture_set(uint32_t pos, uint8_t value)
+{
+    m_capture.buf[pos % EPD_CAPTURE_SIZE] = value;
+}
+
+static uint16_t capture_get16(uint32_t pos)
+{
+    return capture_get(pos) | (capture_get(pos + 1) << 8);
+}
+
+static void capture_set16(uint32_t pos, uint16_t value)
+{
+    capture_set(pos, value & 0xFF);
+    capture_set(pos + 1, value >> 8);
+}
+
+static uint16_t capture_record_size(uint16_t pos)
+{
+    switch (capture_get(pos)) {
+        case EPD_CAPTURE_CMD:   return 4;
+        case EPD_CAPTURE_RESET: return 3;
+        case EPD_CAPTURE_BUSY:  return 5;
+        default:                return 10 + capture_get(pos + 9);
+    }
+}
+
+// Make room for len bytes by dropping the oldest records
+static void capture_reserve(uint16_t len)
+{
+    while (EPD_CAPTURE_SIZE - m_capture.used < len) {
+        uint16_t size = capture_record_size(m_capture.tail);
+        if (m_capture.tail == m_capture.last) m_capture.last = RECORD_NONE;
+        m_capture.tail = (m_capture.tail + size) % EPD_CAPTURE_SIZE;
+        m_capture.used -= size;
+        m_capture.dropped++;
+    }
+}
+
+static void capture_put(uint8_t value)
+{
+    m_capture.buf[m_capture.head] = value;
+    m_capture.head = (m_capture.head + 1) % EPD_CAPTURE_SIZE;
+    m_capture.used++;
+}
+
+static void capture_begin(uint8_t type, uint16_t size)
+{
+    uint32_t now = EPD_Capture_Ticks();
+    uint32_t dt = (((now - m_capture.ticks) & 0xFFFFFF) * 125) >> 12; // ticks to ms
+    m_capture.ticks = now;
+
+    capture_reserve(size);
+    capture_put(type);
+    capture_put(dt > 0xFFFF ? 0xFF : dt & 0xFF);
+    capture_put(dt > 0xFFFF ? 0xFF : dt >> 8);
+}
+
+static uint16_t capture_sum(uint16_t sum, uint8_t *data, uint8_t len)
+{
+    for (uint8_t i = 0; i < len; i++)
+        sum = ((sum << 1) | (sum >> 15)) ^ data[i];
+    return sum;
+}
+
+void EPD_Capture_Start(void)
+{
+    memset(&m_capture, 0, sizeof(m_capture));
+    m_capture.last = RECORD_NONE;
+    m_capture.ticks = EPD_Capture_Ticks();
+    m_capture.enabled = true;
+}
+
+void EPD_Capture_Stop(void)
+{
+    m_capture.enabled = false;
+    m_capture.last = RECORD_NONE;
+}
+
+void EPD_Capture_Record(uint8_t type, uint8_t *data, uint8_t len)
+{
+    if (!m_capture.enabled) return;
+
+    if (type != EPD_CAPTURE_DATA && type != EPD_CAPTURE_READ) {
+        m_capture.last = RECORD_NONE;
+        capture_begin(type, type == EPD_CAPTURE_CMD ? 4 : 3);
+        if (type == EPD_CAPTURE_CMD) capture_put(data[0]);
+        return;
+    }
+
+    uint16_t pos = m_capture.last;
+    if (pos == RECORD_NONE || capture_get(pos) != type) {
+        capture_begin(type, 10 + EPD_CAPTURE_DATA_MAX);
+        pos = (m_capture.head + EPD_CAPTURE_SIZE - 3) % EPD_CAPTURE_SIZE;
+        for (uint8_t i = 0; i < 7; i++) capture_put(0);
+        m_capture.last = pos;
+    }
+
+    uint16_t total = capture_get16(pos + 3);
+    capture_set16(pos + 3, total + len > 0xFFFF ? 0xFFFF : total + len);
+    capture_set16(pos + 5, capture_get16(pos + 5) + 1);
+    capture_set16(pos + 7, capture_sum(capture_get16(pos + 7), data, len));
+
+    uint8_t stored = capture_get(pos + 9);
+    uint8_t count = len < EPD_CAPTURE_DATA_MAX - stored ? len : EPD_CAPTURE_DATA_MAX - stored;
+    if (count == 0) return;
+
+    capture_reserve(count);
+    if (m_capture.last == RECORD_NONE) return; // too small to keep the record
+    for (uint8_t i = 0; i < count; i++)
+        capture_put(data[i]);
+    capture_set(pos + 9, stored + count);
+}
+
+void EPD_Capture_Busy(uint16_t wait_ms)
+{
+    if (!m_capture.enabled) return;
+
+    m_capture.last = RECORD_NONE;
+    capture_begin(EPD_CAPTURE_BUSY, 5);
+    capture_put(wait_ms & 0xFF);
+    capture_put(wait_ms >> 8);
+}
+
+// Read the capture stream (header + records, oldest first) from offset
+uint16_t EPD_Capture_Read(uint16_t offset, uint8_t *buf, uint16_t len)
+{
+    uint8_t header[EPD_CAPTURE_HEADER_SIZE] = {
+        EPD_CAPTURE_MAGIC0, EPD_CAPTURE_MAGIC1, EPD_CAPTURE_VERSION,
+        (m_capture.enabled ? 0x01 : 0x00) | (m_capture.dropped > 0 ? 0x02 : 0x00),
+        m_capture.used & 0xFF, m_capture.used >> 8,
+        m_capture.dropped & 0xFF, m_capture.dropped >> 8,
+    };
+    uint32_t total = EPD_CAPTURE_HEADER_SIZE + m_capture.used;
+    uint16_t count = 0;
+
+    while (count < len && offset + count < total) {
+        uint32_t pos = offset + count;
+        if (pos < EPD_CAPTURE_HEADER_SIZE)
+            buf[count] = header[pos];
+        else
+            buf[count] = capture_get(m_capture.tail + pos - EPD_CAPTURE_HEADER_SIZE);
+        count++;
+    }
+    return count;
+}
+
+#endif
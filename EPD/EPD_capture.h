@@ -0,0 +1,64 @@
+#ifndef __EPD_CAPTURE_H
+#define __EPD_CAPTURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// SPI command stream capture, records every transaction sent to the panel
+// into a RAM ring buffer. Disabled unless built with EPD_CAPTURE_SIZE > 0,
+// e.g. -DEPD_CAPTURE_SIZE=1024
+#ifndef EPD_CAPTURE_SIZE
+#define EPD_CAPTURE_SIZE 0
+#endif
+
+// Max data bytes stored per record, longer transfers keep their length and checksum only
+#ifndef EPD_CAPTURE_DATA_MAX
+#define EPD_CAPTURE_DATA_MAX 16
+#endif
+
+#define EPD_CAPTURE_MAGIC0  'E'
+#define EPD_CAPTURE_MAGIC1  'C'
+#define EPD_CAPTURE_VERSION 1
+#define EPD_CAPTURE_HEADER_SIZE 8
+
+/* Capture stream, all values little endian:
+ *
+ * header:  'E' 'C' version flags size[2] dropped[2]
+ *          flags bit0: capturing, bit1: oldest records were overwritten
+ *          size: bytes of records that follow, dropped: overwritten records
+ *
+ * records, dt = ms since the previous record:
+ *   CMD    type dt[2] cmd
+ *   DATA   type dt[2] len[2] xfers[2] sum[2] n data[n]   consecutive writes are merged
+ *   READ   type dt[2] len[2] xfers[2] sum[2] n data[n]
+ *   RESET  type dt[2]
+ *   BUSY   type dt[2] wait_ms[2]
+ *
+ * sum: sum = (sum << 1 | sum >> 15) ^ byte over all bytes, n = min(len, EPD_CAPTURE_DATA_MAX)
+ */
+enum {
+    EPD_CAPTURE_CMD   = 0x01,
+    EPD_CAPTURE_DATA  = 0x02,
+    EPD_CAPTURE_READ  = 0x03,
+    EPD_CAPTURE_RESET = 0x04,
+    EPD_CAPTURE_BUSY  = 0x05,
+};
+
+#if EPD_CAPTURE_SIZE > 0
+void EPD_Capture_Start(void);
+void EPD_Capture_Stop(void);
+void EPD_Capture_Record(uint8_t type, uint8_t *data, uint8_t len);
+void EPD_Capture_Busy(uint16_t wait_ms);
+uint16_t EPD_Capture_Read(uint16_t offset, uint8_t *buf, uint16_t len);
+
+// Time source, 32768Hz 24-bit counter (RTC1), provided by the HAL
+uint32_t EPD_Capture_Ticks(void);
+#else
+#define EPD_Capture_Start()
+#define EPD_Capture_Stop()
+#define EPD_Capture_Record(type, data, len)
+#define EPD_Capture_Busy(wait_ms)
+#define EPD_Capture_Read(offset, buf, len) 0
+#endif
+
+#endif
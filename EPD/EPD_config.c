@@ -1,16 +1,180 @@
+#include <stddef.h>
 #include <string.h>
 #include "nordic_common.h"
 #include "fds.h"
+#include "app_error.h"
 #include "app_scheduler.h"
+#include "app_timer.h"
 #include "EPD_config.h"
 #include "nrf_log.h"
 
-#define CONFIG_FILE_ID 0x0000
-#define CONFIG_REC_KEY 0x0001
+#define CONFIG_FILE_ID        0x0000
+#define CONFIG_LEGACY_REC_KEY 0x0001 // raw epd_config_t, read once and replaced by CONFIG_REC_KEY
+#define CONFIG_REC_KEY        0x0003 // versioned TLV record
+
+// Record: format, TLV length, CRC-16/CCITT of the TLVs (little endian), then key, length, value
+// entries. Keys unknown to this firmware are kept as they are, so a downgrade keeps newer settings.
+#define CONFIG_FORMAT       1
+#define CONFIG_HEADER_SIZE  4
+#define CONFIG_RECORD_SIZE  128  // bytes, whole words
+#define CONFIG_EXTRA_SIZE   32   // TLVs of unknown keys
+
+#define CONFIG_COMMIT_DELAY_MS  5000 // changes in this window go to flash as one record update
+#define CONFIG_GC_MIN_FREE      64   // words, garbage collection runs once less contiguous space is left
+
+#if defined(S112)
+#define CONFIG_TICKS(MS) APP_TIMER_TICKS(MS)
+#else
+#define CONFIG_TICKS(MS) APP_TIMER_TICKS(MS, 0)
+#endif
+
+APP_TIMER_DEF(m_commit_timer_id);
+
+// epd_config_t has no padding and keeps the legacy layout at its start
+typedef char config_layout_check[(sizeof(struct { uint8_t c; epd_config_t cfg; }) == 1 + sizeof(epd_config_t) &&
+                                  offsetof(epd_config_t, clock_drift) == EPD_CONFIG_LEGACY_SIZE) ? 1 : -1];
+
+#define CONFIG_FIELD(key, field) { key, offsetof(epd_config_t, field), sizeof(((epd_config_t *)0)->field) }
+
+static const struct {
+    uint8_t key;
+    uint8_t offset;
+    uint8_t size;
+} m_fields[] = {
+    CONFIG_FIELD(EPD_CFG_KEY_MOSI_PIN, mosi_pin),
+    CONFIG_FIELD(EPD_CFG_KEY_SCLK_PIN, sclk_pin),
+    CONFIG_FIELD(EPD_CFG_KEY_CS_PIN, cs_pin),
+    CONFIG_FIELD(EPD_CFG_KEY_DC_PIN, dc_pin),
+    CONFIG_FIELD(EPD_CFG_KEY_RST_PIN, rst_pin),
+    CONFIG_FIELD(EPD_CFG_KEY_BUSY_PIN, busy_pin),
+    CONFIG_FIELD(EPD_CFG_KEY_BS_PIN, bs_pin),
+    CONFIG_FIELD(EPD_CFG_KEY_MODEL_ID, model_id),
+    CONFIG_FIELD(EPD_CFG_KEY_WAKEUP_PIN, wakeup_pin),
+    CONFIG_FIELD(EPD_CFG_KEY_LED_PIN, led_pin),
+    CONFIG_FIELD(EPD_CFG_KEY_EN_PIN, en_pin),
+    CONFIG_FIELD(EPD_CFG_KEY_DISPLAY_MODE, display_mode),
+    CONFIG_FIELD(EPD_CFG_KEY_WEEK_START, week_start),
+    CONFIG_FIELD(EPD_CFG_KEY_CLOCK_DRIFT, clock_drift),
+    CONFIG_FIELD(EPD_CFG_KEY_BATTERY_POLICY, battery_policy),
+    CONFIG_FIELD(EPD_CFG_KEY_BATTERY_LOW, battery_low),
+    CONFIG_FIELD(EPD_CFG_KEY_BATTERY_CRITICAL, battery_critical),
+    CONFIG_FIELD(EPD_CFG_KEY_BATTERY_EMPTY, battery_empty),
+    CONFIG_FIELD(EPD_CFG_KEY_TEMP_TTL, temp_ttl),
+    CONFIG_FIELD(EPD_CFG_KEY_PANEL_FAMILY, panel_family),
+    CONFIG_FIELD(EPD_CFG_KEY_OVERLAY, overlay),
+};
+
+// RAM shadow of the config record, written to flash by the commit timer
+static struct {
+    epd_config_t config;    // latest config
+    uint32_t flash[CONFIG_RECORD_SIZE / sizeof(uint32_t)]; // record write in progress, kept until FDS is done with it
+    uint8_t extra[CONFIG_EXTRA_SIZE]; // entries of unknown keys read from flash
+    uint8_t extra_len;
+    bool legacy;            // the old raw record is still in flash
+    bool dirty;             // config differs from flash
+    bool pending;           // commit timer running
+    bool busy;              // record write in progress
+    epd_config_done_t done; // epd_config_flush() callback
+} m_shadow;
+
+static int8_t config_field(uint8_t key)
+{
+    for (uint8_t i = 0; i < ARRAY_SIZE(m_fields); i++)
+        if (m_fields[i].key == key) return i;
+    return -1;
+}
+
+static uint16_t config_crc16(uint8_t const *data, uint16_t len)
+{
+    uint16_t crc = 0xFFFF;
+    for (uint16_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (uint8_t bit = 0; bit < 8; bit++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+// Walks the entries of a TLV buffer, false if one runs past the end
+static bool config_tlv_valid(uint8_t const *tlv, uint16_t len)
+{
+    for (uint16_t pos = 0; pos < len; pos += 2 + tlv[pos + 1])
+        if (len - pos < 2 || tlv[pos + 1] > len - pos - 2) return false;
+    return true;
+}
+
+// Record of the shadow, set keys only, returns its size in bytes
+static uint16_t config_encode(uint8_t *record)
+{
+    uint8_t *tlv = record + CONFIG_HEADER_SIZE;
+    uint8_t len = 0;
+
+    memset(record, 0xFF, CONFIG_RECORD_SIZE);
+    for (uint8_t i = 0; i < ARRAY_SIZE(m_fields); i++) {
+        uint8_t const *value = (uint8_t const *)&m_shadow.config + m_fields[i].offset;
+        if (epd_config_empty_value(value, m_fields[i].size)) continue;
+        tlv[len++] = m_fields[i].key;
+        tlv[len++] = m_fields[i].size;
+        memcpy(&tlv[len], value, m_fields[i].size);
+        len += m_fields[i].size;
+    }
+    memcpy(&tlv[len], m_shadow.extra, m_shadow.extra_len);
+    len += m_shadow.extra_len;
+
+    uint16_t crc = config_crc16(tlv, len);
+    record[0] = CONFIG_FORMAT;
+    record[1] = len;
+    record[2] = crc & 0xFF;
+    record[3] = crc >> 8;
+    return CONFIG_HEADER_SIZE + len;
+}
+
+static bool config_decode(uint8_t const *record, epd_config_t *cfg)
+{
+    uint8_t const *tlv = record + CONFIG_HEADER_SIZE;
+    uint8_t len = record[1];
+
+    if (record[0] != CONFIG_FORMAT || len > CONFIG_RECORD_SIZE - CONFIG_HEADER_SIZE) return false;
+    if (config_crc16(tlv, len) != (record[2] | (record[3] << 8)) || !config_tlv_valid(tlv, len)) return false;
+
+    m_shadow.extra_len = 0;
+    for (uint8_t pos = 0; pos < len; pos += 2 + tlv[pos + 1]) {
+        int8_t i = config_field(tlv[pos]);
+        if (i >= 0) {
+            // a field that grew in a later version keeps its old prefix
+            memcpy((uint8_t *)cfg + m_fields[i].offset, &tlv[pos + 2], MIN(tlv[pos + 1], m_fields[i].size));
+        } else if (m_shadow.extra_len + 2 + tlv[pos + 1] <= CONFIG_EXTRA_SIZE) {
+            memcpy(&m_shadow.extra[m_shadow.extra_len], &tlv[pos], 2 + tlv[pos + 1]);
+            m_shadow.extra_len += 2 + tlv[pos + 1];
+        }
+    }
+    return true;
+}
+
+static void config_flush_done(void)
+{
+    epd_config_done_t done = m_shadow.done;
+    m_shadow.done = NULL;
+    if (done) done();
+}
+
+static void config_schedule(void)
+{
+    if (m_shadow.pending) return;
+    m_shadow.pending = true;
+    APP_ERROR_CHECK(app_timer_start(m_commit_timer_id, CONFIG_TICKS(CONFIG_COMMIT_DELAY_MS), NULL));
+}
 
 static void fds_evt_handler(fds_evt_t const * const p_fds_evt)
 {
     NRF_LOG_DEBUG("fds evt: id=%d result=%d\n", p_fds_evt->id, p_fds_evt->result);
+    if ((p_fds_evt->id == FDS_EVT_WRITE || p_fds_evt->id == FDS_EVT_UPDATE) &&
+        p_fds_evt->write.record_key == CONFIG_REC_KEY) {
+        m_shadow.busy = false;
+        config_flush_done();
+    }
+    // a commit that failed for lack of space is retried once the GC made room
+    if (p_fds_evt->id == FDS_EVT_GC && m_shadow.dirty) config_schedule();
 }
 
 static void run_fds_gc(void * p_event_data, uint16_t event_size)
@@ -19,10 +183,52 @@ static void run_fds_gc(void * p_event_data, uint16_t event_size)
     fds_gc();
 }
 
+// Garbage collection only when the free space runs low and there is something to reclaim
+static void config_check_gc(void)
+{
+    fds_stat_t stat;
+
+    if (fds_stat(&stat) != NRF_SUCCESS) return;
+    if (stat.largest_contig < CONFIG_GC_MIN_FREE && stat.freeable_words > 0)
+        app_sched_event_put(NULL, 0, run_fds_gc);
+}
+
+static void config_commit(void * p_event_data, uint16_t event_size)
+{
+    m_shadow.pending = false;
+    if (!m_shadow.dirty) return;
+    if (m_shadow.busy) { // the last write is still using the buffer
+        config_schedule();
+        return;
+    }
+
+    uint16_t size = config_encode((uint8_t *)m_shadow.flash);
+    m_shadow.dirty = false;
+    m_shadow.busy = true;
+    if (!epd_config_record_write(CONFIG_REC_KEY, m_shadow.flash, size)) {
+        m_shadow.busy = false;
+        m_shadow.dirty = true; // retried after the GC
+        return;
+    }
+    if (m_shadow.legacy && epd_config_record_delete(CONFIG_LEGACY_REC_KEY))
+        m_shadow.legacy = false;
+    config_check_gc();
+}
+
+static void commit_timeout_handler(void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+    app_sched_event_put(NULL, 0, config_commit);
+}
+
 void epd_config_init(epd_config_t *cfg)
 {
     ret_code_t ret;
 
+    memset(&m_shadow, 0, sizeof(m_shadow));
+    memset(&m_shadow.config, 0xFF, sizeof(epd_config_t));
+    APP_ERROR_CHECK(app_timer_create(&m_commit_timer_id, APP_TIMER_MODE_SINGLE_SHOT, commit_timeout_handler));
+
     ret = fds_register(fds_evt_handler);
     if (ret != NRF_SUCCESS) {
         NRF_LOG_ERROR("fds_register failed, code=%d\n", ret);
@@ -35,36 +241,36 @@ void epd_config_init(epd_config_t *cfg)
         return;
     }
 
-    run_fds_gc(NULL, 0);
+    config_check_gc();
 }
 
-void epd_config_read(epd_config_t *cfg)
+bool epd_config_record_read(uint16_t key, void *data, uint16_t size)
 {
     fds_flash_record_t  flash_record;
     fds_record_desc_t   record_desc;
     fds_find_token_t    ftok;
 
-    memset(cfg, 0xFF, sizeof(epd_config_t));
     memset(&ftok, 0x00, sizeof(fds_find_token_t));
 
-    if (fds_record_find(CONFIG_FILE_ID, CONFIG_REC_KEY, &record_desc, &ftok) != NRF_SUCCESS) {
-        NRF_LOG_DEBUG("epd_config_load: record not found\n");
-        return;
+    if (fds_record_find(CONFIG_FILE_ID, key, &record_desc, &ftok) != NRF_SUCCESS) {
+        NRF_LOG_DEBUG("epd_config_load: record %d not found\n", key);
+        return false;
     }
     if (fds_record_open(&record_desc, &flash_record) != NRF_SUCCESS) {
         NRF_LOG_ERROR("epd_config_load: record open failed!");
-        return;
+        return false;
     }
 #ifdef S112
     uint32_t record_len = flash_record.p_header->length_words * sizeof(uint32_t);
 #else
     uint32_t record_len = flash_record.p_header->tl.length_words * sizeof(uint32_t);
 #endif
-    memcpy(cfg, flash_record.p_data, MIN(sizeof(epd_config_t), record_len));
+    memcpy(data, flash_record.p_data, MIN(size, record_len));
     fds_record_close(&record_desc);
+    return true;
 }
 
-void epd_config_write(epd_config_t *cfg)
+bool epd_config_record_write(uint16_t key, void const *data, uint16_t size)
 {
     ret_code_t          ret;
     fds_record_t        record;
@@ -72,20 +278,20 @@ void epd_config_write(epd_config_t *cfg)
     fds_find_token_t    ftok;
 
     record.file_id = CONFIG_FILE_ID;
-    record.key = CONFIG_REC_KEY;
+    record.key = key;
 #ifdef S112
-    record.data.p_data = (void*)cfg;
-    record.data.length_words = BYTES_TO_WORDS(sizeof(epd_config_t));
+    record.data.p_data = data;
+    record.data.length_words = BYTES_TO_WORDS(size);
 #else
     fds_record_chunk_t record_chunk;
-    record_chunk.p_data = cfg;
-    record_chunk.length_words = BYTES_TO_WORDS(sizeof(epd_config_t));
+    record_chunk.p_data = data;
+    record_chunk.length_words = BYTES_TO_WORDS(size);
     record.data.p_chunks = &record_chunk;
     record.data.num_chunks = 1;
 #endif
 
     memset(&ftok, 0x00, sizeof(fds_find_token_t));
-    ret = fds_record_find(CONFIG_FILE_ID, CONFIG_REC_KEY, &record_desc, &ftok);
+    ret = fds_record_find(CONFIG_FILE_ID, key, &record_desc, &ftok);
     if (ret == NRF_SUCCESS)
         ret = fds_record_update(&record_desc, &record);
     else
@@ -95,32 +301,159 @@ void epd_config_write(epd_config_t *cfg)
         NRF_LOG_ERROR("epd_config_save: record write/update failed, code=%d\n", ret);
         if (ret == FDS_ERR_NO_SPACE_IN_FLASH)
             app_sched_event_put(NULL, 0, run_fds_gc);
+        return false;
     }
+    return true;
 }
 
-void epd_config_clear(epd_config_t *cfg)
+void epd_config_read(epd_config_t *cfg)
+{
+    memset(cfg, 0xFF, sizeof(epd_config_t));
+    memset(m_shadow.flash, 0xFF, sizeof(m_shadow.flash));
+    m_shadow.extra_len = 0;
+    m_shadow.dirty = false;
+
+    // the old raw record is migrated by the next commit
+    m_shadow.legacy = epd_config_record_read(CONFIG_LEGACY_REC_KEY, cfg, EPD_CONFIG_LEGACY_SIZE);
+    if (epd_config_record_read(CONFIG_REC_KEY, m_shadow.flash, sizeof(m_shadow.flash))) {
+        memset(cfg, 0xFF, sizeof(epd_config_t));
+        if (!config_decode((uint8_t *)m_shadow.flash, cfg)) {
+            NRF_LOG_ERROR("epd_config_read: bad record, using defaults\n");
+            memset(cfg, 0xFF, sizeof(epd_config_t));
+        }
+    }
+    memcpy(&m_shadow.config, cfg, sizeof(epd_config_t));
+    if (m_shadow.legacy) {
+        m_shadow.dirty = true;
+        config_schedule();
+    }
+}
+
+void epd_config_write(epd_config_t *cfg)
+{
+    if (!m_shadow.dirty && memcmp(&m_shadow.config, cfg, sizeof(epd_config_t)) == 0) return;
+
+    memcpy(&m_shadow.config, cfg, sizeof(epd_config_t));
+    m_shadow.dirty = true;
+    config_schedule();
+}
+
+void epd_config_flush(epd_config_done_t done)
+{
+    if (m_shadow.pending) {
+        app_timer_stop(m_commit_timer_id);
+        m_shadow.pending = false;
+    }
+    m_shadow.done = done;
+    if (!m_shadow.busy) config_commit(NULL, 0);
+    if (!m_shadow.busy) config_flush_done();
+}
+
+bool epd_config_record_delete(uint16_t key)
 {
     ret_code_t          ret;
     fds_record_desc_t   record_desc;
     fds_find_token_t    ftok;
 
     memset(&ftok, 0x00, sizeof(fds_find_token_t));
-    if (fds_record_find(CONFIG_FILE_ID, CONFIG_REC_KEY, &record_desc, &ftok) != NRF_SUCCESS) {
-        NRF_LOG_DEBUG("epd_config_clear: record not found\n");
-        return;
+    if (fds_record_find(CONFIG_FILE_ID, key, &record_desc, &ftok) != NRF_SUCCESS) {
+        NRF_LOG_DEBUG("epd_config_record_delete: record %d not found\n", key);
+        return true;
     }
 
     ret = fds_record_delete(&record_desc);
     if (ret != NRF_SUCCESS) {
         NRF_LOG_ERROR("fds_record_delete failed, code=%d\n", ret);
+        return false;
     }
+    return true;
 }
 
-bool epd_config_empty(epd_config_t *cfg)
+void epd_config_clear(epd_config_t *cfg)
 {
-    for (uint8_t i = 0; i < EPD_CONFIG_SIZE; i++) {
-        if (((uint8_t *)cfg)[i] != 0xFF)
+    if (m_shadow.pending) {
+        app_timer_stop(m_commit_timer_id);
+        m_shadow.pending = false;
+    }
+    memset(&m_shadow.config, 0xFF, sizeof(epd_config_t));
+    m_shadow.extra_len = 0;
+    m_shadow.dirty = false;
+
+    epd_config_record_delete(CONFIG_REC_KEY);
+    epd_config_record_delete(CONFIG_LEGACY_REC_KEY);
+    m_shadow.legacy = false;
+}
+
+bool epd_config_empty_value(void const *value, uint8_t size)
+{
+    for (uint8_t i = 0; i < size; i++) {
+        if (((uint8_t const *)value)[i] != 0xFF)
             return false;
     }
     return true;
 }
+
+int16_t epd_config_clock_drift(epd_config_t const *cfg)
+{
+    return (int16_t)(cfg->clock_drift[0] | (cfg->clock_drift[1] << 8));
+}
+
+void epd_config_set_clock_drift(epd_config_t *cfg, int16_t drift)
+{
+    cfg->clock_drift[0] = (uint16_t)drift & 0xFF;
+    cfg->clock_drift[1] = (uint16_t)drift >> 8;
+}
+
+bool epd_config_empty(epd_config_t *cfg)
+{
+    return epd_config_empty_value(cfg, EPD_CONFIG_SIZE);
+}
+
+uint8_t epd_config_get(epd_config_t const *cfg, uint8_t const *keys, uint8_t count, uint8_t *buf, uint8_t size)
+{
+    uint8_t len = 0;
+
+    for (uint8_t n = 0; n < (count > 0 ? count : ARRAY_SIZE(m_fields)); n++) {
+        int8_t i = count > 0 ? config_field(keys[n]) : (int8_t)n;
+        if (i < 0) continue;
+        if (len + 2 + m_fields[i].size > size) break;
+        buf[len++] = m_fields[i].key;
+        buf[len++] = m_fields[i].size;
+        memcpy(&buf[len], (uint8_t const *)cfg + m_fields[i].offset, m_fields[i].size);
+        len += m_fields[i].size;
+    }
+    return len;
+}
+
+void epd_config_legacy_get(epd_config_t const *cfg, uint8_t buf[EPD_CONFIG_LEGACY_SIZE])
+{
+    for (uint8_t n = 0; n < EPD_CONFIG_LEGACY_SIZE; n++)
+        buf[n] = *((uint8_t const *)cfg + m_fields[config_field(n + 1)].offset);
+}
+
+uint8_t epd_config_legacy_tlv(uint8_t const *data, uint8_t len, uint8_t *tlv)
+{
+    uint8_t pos = 0;
+
+    for (uint8_t n = 0; n < MIN(len, EPD_CONFIG_LEGACY_SIZE); n++) {
+        tlv[pos++] = n + 1; // key
+        tlv[pos++] = 1;
+        tlv[pos++] = data[n];
+    }
+    return pos;
+}
+
+epd_config_status_t epd_config_set(epd_config_t *cfg, uint8_t const *tlv, uint16_t len)
+{
+    if (!config_tlv_valid(tlv, len)) return EPD_CFG_ERR_FORMAT;
+    for (uint16_t pos = 0; pos < len; pos += 2 + tlv[pos + 1]) {
+        int8_t i = config_field(tlv[pos]);
+        if (i < 0) return EPD_CFG_ERR_KEY;
+        if (tlv[pos + 1] != m_fields[i].size) return EPD_CFG_ERR_LENGTH;
+    }
+
+    // all entries are valid, apply them together
+    for (uint16_t pos = 0; pos < len; pos += 2 + tlv[pos + 1])
+        memcpy((uint8_t *)cfg + m_fields[config_field(tlv[pos])].offset, &tlv[pos + 2], tlv[pos + 1]);
+    return EPD_CFG_OK;
+}
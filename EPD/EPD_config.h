@@ -3,6 +3,8 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+// Bytes only, no padding: the first EPD_CONFIG_LEGACY_SIZE bytes are the layout of the
+// old raw flash record and of the BLE config (EPD_CMD_SET_CONFIG, notification)
 typedef struct
 {
     uint8_t mosi_pin;
@@ -18,14 +20,89 @@ typedef struct
     uint8_t en_pin;
     uint8_t display_mode;
     uint8_t week_start;
+    uint8_t clock_drift[2];   // epd_config_clock_drift()
+    uint8_t battery_policy;   // BATTERY_POLICY_* applied when the battery runs low (EPD_battery.h)
+    uint8_t battery_low;      // battery state thresholds, 10 mV above 1 V (BATTERY_LEVEL())
+    uint8_t battery_critical;
+    uint8_t battery_empty;
+    uint8_t temp_ttl;         // minutes a panel temperature reading is reused, 0: MCU sensor only (EPD_temp.h)
+    uint8_t panel_family;     // controller family found by the probe (epd_driver_family_t)
+    uint8_t overlay;          // GUI_OVERLAY_* drawn over pictures (GUI.h), 0xFF: none
 } epd_config_t;
 
+#define EPD_CONFIG_LEGACY_SIZE 13                // mosi_pin .. week_start
+#define EPD_CLOCK_DRIFT_UNSET ((int16_t)0xFFFF) // erased flash
+#define EPD_PANEL_FAMILY_UNSET 0xFF                // not found yet, probed on the next boot
+#define EPD_OVERLAY_UNSET     0xFF                // no overlay
+
+// Keys of the config record and of the BLE config read/write commands, values are the
+// epd_config_t fields (little endian). New fields get new keys, keys are never reused.
+enum {
+    EPD_CFG_KEY_MOSI_PIN         = 0x01,
+    EPD_CFG_KEY_SCLK_PIN         = 0x02,
+    EPD_CFG_KEY_CS_PIN           = 0x03,
+    EPD_CFG_KEY_DC_PIN           = 0x04,
+    EPD_CFG_KEY_RST_PIN          = 0x05,
+    EPD_CFG_KEY_BUSY_PIN         = 0x06,
+    EPD_CFG_KEY_BS_PIN           = 0x07,
+    EPD_CFG_KEY_MODEL_ID         = 0x08,
+    EPD_CFG_KEY_WAKEUP_PIN       = 0x09,
+    EPD_CFG_KEY_LED_PIN          = 0x0A,
+    EPD_CFG_KEY_EN_PIN           = 0x0B,
+    EPD_CFG_KEY_DISPLAY_MODE     = 0x0C,
+    EPD_CFG_KEY_WEEK_START       = 0x0D,
+    EPD_CFG_KEY_CLOCK_DRIFT      = 0x0E,
+    EPD_CFG_KEY_BATTERY_POLICY   = 0x0F,
+    EPD_CFG_KEY_BATTERY_LOW      = 0x10,
+    EPD_CFG_KEY_BATTERY_CRITICAL = 0x11,
+    EPD_CFG_KEY_BATTERY_EMPTY    = 0x12,
+    EPD_CFG_KEY_TEMP_TTL         = 0x13,
+    EPD_CFG_KEY_PANEL_FAMILY     = 0x14,
+    EPD_CFG_KEY_OVERLAY          = 0x15,
+};
+
+typedef enum {
+    EPD_CFG_OK = 0,
+    EPD_CFG_ERR_FORMAT = 1,   // an entry runs past the end
+    EPD_CFG_ERR_KEY = 2,      // unknown key
+    EPD_CFG_ERR_LENGTH = 3,   // value length differs from the field
+} epd_config_status_t;
+
 #define EPD_CONFIG_SIZE (sizeof(epd_config_t) / sizeof(uint8_t))
     
+// Other records of the config file, read and written with epd_config_record_*()
+#define EPD_BATTERY_REC_KEY 0x0002 // voltage history
+// 0x0001 (raw epd_config_t) and 0x0003 (TLV config) are used by EPD_config.c
+
+typedef void (*epd_config_done_t)(void);
+
 void epd_config_init(epd_config_t *cfg);
 void epd_config_read(epd_config_t *cfg);
+// Only updates the RAM shadow, the change goes to flash a few seconds later (or on epd_config_flush)
 void epd_config_write(epd_config_t *cfg);
+// Write a pending change now, done is called once it is in flash (before a reset or sleep)
+void epd_config_flush(epd_config_done_t done);
 void epd_config_clear(epd_config_t *cfg);
 bool epd_config_empty(epd_config_t *cfg);
+// RTC drift measured between time syncs (0.1 ppm, > 0: clock runs fast), little endian in the config
+int16_t epd_config_clock_drift(epd_config_t const *cfg);
+void epd_config_set_clock_drift(epd_config_t *cfg, int16_t drift);
+bool epd_config_empty_value(void const *value, uint8_t size);
+bool epd_config_record_read(uint16_t key, void *data, uint16_t size);
+bool epd_config_record_write(uint16_t key, void const *data, uint16_t size);
+bool epd_config_record_delete(uint16_t key);
+
+// Key, length, value entries of the given keys (all when count is 0), unknown keys are skipped;
+// stops before the entry that does not fit in size, returns the length written
+uint8_t epd_config_get(epd_config_t const *cfg, uint8_t const *keys, uint8_t count, uint8_t *buf, uint8_t size);
+// Applies all the entries or none of them (unknown key, wrong length or truncated entry)
+epd_config_status_t epd_config_set(epd_config_t *cfg, uint8_t const *tlv, uint16_t len);
+
+// Legacy BLE layout (EPD_CMD_SET_CONFIG, config notification): the values of keys 0x01 ..
+// EPD_CONFIG_LEGACY_SIZE in key order, one byte each. Newer fields only go through the keys.
+void epd_config_legacy_get(epd_config_t const *cfg, uint8_t buf[EPD_CONFIG_LEGACY_SIZE]);
+// Entries of the first len legacy values (at most EPD_CONFIG_LEGACY_SIZE) for epd_config_set,
+// tlv holds 3 bytes per value, returns the length written
+uint8_t epd_config_legacy_tlv(uint8_t const *data, uint8_t len, uint8_t *tlv);
 
 #endif
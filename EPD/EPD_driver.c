@@ -1,7 +1,14 @@
+#include <string.h>
 #include "app_error.h"
 #include "nrf_drv_spi.h"
 #include "EPD_driver.h"
+#include "EPD_battery.h"
+#include "EPD_capture.h"
+#include "EPD_energy.h"
 #include "nrf_log.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+#include "nrf_soc.h"
 
 #define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
 #define BUFFER_SIZE 128
@@ -56,12 +63,30 @@ void pinMode(uint32_t pin, uint32_t mode)
     }
 }
 
+#if defined(S112)
+#define SEQUENCE_TICKS(MS) APP_TIMER_TICKS(MS)
+#else
+#define SEQUENCE_TICKS(MS) APP_TIMER_TICKS(MS, 0)
+#endif
+
+APP_TIMER_DEF(m_sequence_timer_id);
+static bool m_sequence_timer_created = false;
+
 // GPIO
 static uint16_t m_driver_refs = 0;
+static epd_state_t m_state = EPD_STATE_OFF;
+static epd_model_t *m_epd = NULL; // configured by the last epd_init()
+
+// Pins are held between updates only if the controller can resume and stays powered
+static bool EPD_GPIO_Retain(void)
+{
+    return m_state == EPD_STATE_STANDBY && m_epd != NULL && m_epd->drv->wake != NULL && EPD_EN_PIN == 0xFF;
+}
 
 void EPD_GPIO_Load(epd_config_t *cfg)
 {
     if (cfg == NULL) return;
+    EPD_GPIO_Release(); // held pins of the old config
     EPD_MOSI_PIN = cfg->mosi_pin;
     EPD_SCLK_PIN = cfg->sclk_pin;
     EPD_CS_PIN = cfg->cs_pin;
@@ -75,6 +100,7 @@ void EPD_GPIO_Load(epd_config_t *cfg)
 
 void EPD_GPIO_Init(void)
 {
+    epd_sequence_flush(); // e.g. the release after a sleep sequence
     if (m_driver_refs++ > 0) return;
 
     pinMode(EPD_DC_PIN, OUTPUT);
@@ -118,21 +144,42 @@ void EPD_GPIO_Uninit(void)
     nrf_drv_spi_uninit(&spi);
 
     digitalWrite(EPD_DC_PIN, LOW);
-    digitalWrite(EPD_CS_PIN, LOW);
-    digitalWrite(EPD_RST_PIN, LOW);
-    if (EPD_EN_PIN != 0xFF)
-        digitalWrite(EPD_EN_PIN, LOW);
+    if (EPD_GPIO_Retain()) {
+        // out of reset and deselected, the registers survive until the next update
+        pinMode(EPD_CS_PIN, OUTPUT);
+        digitalWrite(EPD_CS_PIN, HIGH);
+    } else {
+        digitalWrite(EPD_CS_PIN, LOW);
+        digitalWrite(EPD_RST_PIN, LOW);
+        if (EPD_EN_PIN != 0xFF)
+            digitalWrite(EPD_EN_PIN, LOW);
+        pinMode(EPD_CS_PIN, DEFAULT);
+        pinMode(EPD_RST_PIN, DEFAULT);
+        m_state = EPD_STATE_OFF;
+    }
 
     // reset pin state
     pinMode(EPD_MOSI_PIN, DEFAULT);
     pinMode(EPD_SCLK_PIN, DEFAULT);
-    pinMode(EPD_CS_PIN, DEFAULT);
     pinMode(EPD_DC_PIN, DEFAULT);
-    pinMode(EPD_RST_PIN, DEFAULT);
     pinMode(EPD_BUSY_PIN, DEFAULT);
     pinMode(EPD_BS_PIN, DEFAULT);
     pinMode(EPD_EN_PIN, DEFAULT);
     pinMode(EPD_LED_PIN, DEFAULT);
+
+    EPD_VoltageStart(); // the panel is off, an idle point to sample the supply
+}
+
+void EPD_GPIO_Release(void)
+{
+    epd_sequence_flush();
+    if (m_driver_refs > 0 || m_state == EPD_STATE_OFF) return;
+
+    m_state = EPD_STATE_OFF;
+    digitalWrite(EPD_CS_PIN, LOW);
+    digitalWrite(EPD_RST_PIN, LOW);
+    pinMode(EPD_CS_PIN, DEFAULT);
+    pinMode(EPD_RST_PIN, DEFAULT);
 }
 
 // SPI
@@ -144,6 +191,7 @@ void EPD_SPI_Write(uint8_t *value, uint8_t len)
         nrf_spi_pins_set(HAL_SPI_INSTANCE, EPD_SCLK_PIN, EPD_MOSI_PIN, NRF_SPI_PIN_NOT_CONNECTED);
     }
     APP_ERROR_CHECK(nrf_drv_spi_transfer(&spi, value, len, NULL, 0));
+    epd_energy_spi(len);
 }
 
 void EPD_SPI_Read(uint8_t *value, uint8_t len)
@@ -154,17 +202,21 @@ void EPD_SPI_Read(uint8_t *value, uint8_t len)
         nrf_spi_pins_set(HAL_SPI_INSTANCE, EPD_SCLK_PIN, NRF_SPI_PIN_NOT_CONNECTED, EPD_MOSI_PIN);
     }
     APP_ERROR_CHECK(nrf_drv_spi_transfer(&spi, NULL, 0, value, len));
+    epd_energy_spi(len);
 }
 
 // EPD
 void EPD_WriteCmd(uint8_t cmd)
 {
+    epd_sequence_flush(); // after the steps still waiting for the timer
+    EPD_Capture_Record(EPD_CAPTURE_CMD, &cmd, 1);
     digitalWrite(EPD_DC_PIN, LOW);
     EPD_SPI_Write(&cmd, 1);
 }
 
 void EPD_WriteData(uint8_t *value, uint8_t len)
 {
+    EPD_Capture_Record(EPD_CAPTURE_DATA, value, len);
     digitalWrite(EPD_DC_PIN, HIGH);
     EPD_SPI_Write(value, len);
 }
@@ -173,10 +225,12 @@ void EPD_ReadData(uint8_t *value, uint8_t len)
 {
     digitalWrite(EPD_DC_PIN, HIGH);
     EPD_SPI_Read(value, len);
+    EPD_Capture_Record(EPD_CAPTURE_READ, value, len);
 }
 
 void EPD_WriteByte(uint8_t value)
 {
+    EPD_Capture_Record(EPD_CAPTURE_DATA, &value, 1);
     digitalWrite(EPD_DC_PIN, HIGH);
     EPD_SPI_Write(&value, 1);
 }
@@ -186,6 +240,7 @@ uint8_t EPD_ReadByte(void)
     uint8_t value;
     digitalWrite(EPD_DC_PIN, HIGH);
     EPD_SPI_Read(&value, 1);
+    EPD_Capture_Record(EPD_CAPTURE_READ, &value, 1);
     return value;
 }
 
@@ -204,19 +259,10 @@ void EPD_FillRAM(uint8_t cmd, uint8_t value, uint32_t len)
     }
 }
 
-void EPD_Reset(uint32_t value, uint16_t duration)
-{
-    digitalWrite(EPD_RST_PIN, value);
-    delay(duration);
-    digitalWrite(EPD_RST_PIN, (value == LOW) ? HIGH : LOW);
-    delay(duration);
-    digitalWrite(EPD_RST_PIN, value);
-    delay(duration);
-}
-
 void EPD_WaitBusy(uint32_t value, uint16_t timeout)
 {
     uint32_t led_status = digitalRead(EPD_LED_PIN);
+    uint16_t wait_ms = timeout;
 
     NRF_LOG_DEBUG("[EPD]: check busy\n");
     while (digitalRead(EPD_BUSY_PIN) == value) {
@@ -229,6 +275,8 @@ void EPD_WaitBusy(uint32_t value, uint16_t timeout)
         }
     }
     NRF_LOG_DEBUG("[EPD]: busy release\n");
+    EPD_Capture_Busy(wait_ms - timeout);
+    epd_energy_busy(wait_ms - timeout);
 
     // restore led status
     if (led_status == LOW)
@@ -237,6 +285,51 @@ void EPD_WaitBusy(uint32_t value, uint16_t timeout)
         EPD_LED_OFF();
 }
 
+void EPD_ResetPin(uint32_t value)
+{
+    if (value == LOW && digitalRead(EPD_RST_PIN) != LOW)
+        EPD_Capture_Record(EPD_CAPTURE_RESET, NULL, 0);
+    digitalWrite(EPD_RST_PIN, value);
+}
+
+uint32_t EPD_BusyPin(void)
+{
+    return digitalRead(EPD_BUSY_PIN);
+}
+
+static void sequence_timeout_handler(void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+    epd_sequence_timeout();
+}
+
+void EPD_SeqTimerStart(uint16_t ms)
+{
+    if (!m_sequence_timer_created) {
+        APP_ERROR_CHECK(app_timer_create(&m_sequence_timer_id, APP_TIMER_MODE_SINGLE_SHOT, sequence_timeout_handler));
+        m_sequence_timer_created = true;
+    }
+    APP_ERROR_CHECK(app_timer_start(m_sequence_timer_id, SEQUENCE_TICKS(ms), NULL));
+}
+
+void EPD_SeqTimerStop(void)
+{
+    if (m_sequence_timer_created)
+        app_timer_stop(m_sequence_timer_id);
+}
+
+uint32_t EPD_Ticks(void)
+{
+    return app_timer_cnt_get();
+}
+
+#if EPD_CAPTURE_SIZE > 0
+uint32_t EPD_Capture_Ticks(void)
+{
+    return EPD_Ticks();
+}
+#endif
+
 // lED
 void EPD_LED_ON(void)
 {
@@ -268,49 +361,193 @@ void EPD_LED_BLINK(void)
     }
 }
 
-float EPD_ReadVoltage(void)
+// VDD voltage, sampled in the background while the panel is off
+#define VOLTAGE_SAMPLES     8     // conversions averaged per measurement
+#define VOLTAGE_SAMPLE_MS   2     // between conversions
+#define VOLTAGE_SETTLE_MS   500   // after the panel is off, the cell recovers from the refresh load
+
+#if defined(S112)
+#define VOLTAGE_FULL_SCALE  3.6f  // VDD gain 1/6 on the 0.6V internal reference
+#define VOLTAGE_TICKS(MS) APP_TIMER_TICKS(MS)
+#else
+#define VOLTAGE_FULL_SCALE  3.6f  // VDD 1/3 prescaling on the 1.2V bandgap
+#define VOLTAGE_TICKS(MS) APP_TIMER_TICKS(MS, 0)
+#endif
+
+APP_TIMER_DEF(m_voltage_timer_id);
+static struct {
+    bool created;
+    bool converting;   // a conversion was started on the last tick
+    uint8_t count;
+    uint32_t sum;
+    float value;       // last measurement
+} m_voltage;
+
+#if defined(S112)
+static volatile int16_t m_saadc_result;  // EasyDMA target
+#endif
+
+static void ADC_Enable(void)
 {
 #if defined(S112)
-    volatile int16_t value = 0;
     NRF_SAADC->RESOLUTION = SAADC_RESOLUTION_VAL_10bit;
+    NRF_SAADC->OVERSAMPLE = SAADC_OVERSAMPLE_OVERSAMPLE_Over8x; // averaged in hardware, one SAMPLE task with BURST
     NRF_SAADC->ENABLE = (SAADC_ENABLE_ENABLE_Enabled << SAADC_ENABLE_ENABLE_Pos);
     NRF_SAADC->CH[0].CONFIG = ((SAADC_CH_CONFIG_RESP_Bypass     << SAADC_CH_CONFIG_RESP_Pos)   & SAADC_CH_CONFIG_RESP_Msk)
                             | ((SAADC_CH_CONFIG_RESP_Bypass     << SAADC_CH_CONFIG_RESN_Pos)   & SAADC_CH_CONFIG_RESN_Msk)
                             | ((SAADC_CH_CONFIG_GAIN_Gain1_6    << SAADC_CH_CONFIG_GAIN_Pos)   & SAADC_CH_CONFIG_GAIN_Msk)
                             | ((SAADC_CH_CONFIG_REFSEL_Internal << SAADC_CH_CONFIG_REFSEL_Pos) & SAADC_CH_CONFIG_REFSEL_Msk)
                             | ((SAADC_CH_CONFIG_TACQ_3us        << SAADC_CH_CONFIG_TACQ_Pos)   & SAADC_CH_CONFIG_TACQ_Msk)
-                            | ((SAADC_CH_CONFIG_MODE_SE         << SAADC_CH_CONFIG_MODE_Pos)   & SAADC_CH_CONFIG_MODE_Msk);
+                            | ((SAADC_CH_CONFIG_MODE_SE         << SAADC_CH_CONFIG_MODE_Pos)   & SAADC_CH_CONFIG_MODE_Msk)
+                            | ((SAADC_CH_CONFIG_BURST_Enabled   << SAADC_CH_CONFIG_BURST_Pos)  & SAADC_CH_CONFIG_BURST_Msk);
     NRF_SAADC->CH[0].PSELN = SAADC_CH_PSELN_PSELN_NC;
     NRF_SAADC->CH[0].PSELP = SAADC_CH_PSELP_PSELP_VDD;
-    NRF_SAADC->RESULT.PTR = (uint32_t)&value;
+    NRF_SAADC->RESULT.PTR = (uint32_t)&m_saadc_result;
     NRF_SAADC->RESULT.MAXCNT = 1;
+#else
+    NRF_ADC->ENABLE = 1;
+    NRF_ADC->CONFIG = (ADC_CONFIG_RES_10bit << ADC_CONFIG_RES_Pos) |
+                      (ADC_CONFIG_INPSEL_SupplyOneThirdPrescaling << ADC_CONFIG_INPSEL_Pos) |
+                      (ADC_CONFIG_REFSEL_VBG << ADC_CONFIG_REFSEL_Pos) |
+                      (ADC_CONFIG_PSEL_Disabled << ADC_CONFIG_PSEL_Pos) |
+                      (ADC_CONFIG_EXTREFSEL_None << ADC_CONFIG_EXTREFSEL_Pos);
+#endif
+}
+
+static void ADC_Disable(void)
+{
+#if defined(S112)
+    NRF_SAADC->ENABLE = (SAADC_ENABLE_ENABLE_Disabled << SAADC_ENABLE_ENABLE_Pos);
+#else
+    NRF_ADC->ENABLE = 0;
+#endif
+}
+
+// Start one conversion, the result is ready within ~70us
+static void ADC_Start(void)
+{
+#if defined(S112)
+    NRF_SAADC->EVENTS_END = 0x00UL;
     NRF_SAADC->TASKS_START = 0x01UL;
     while (!NRF_SAADC->EVENTS_STARTED);
     NRF_SAADC->EVENTS_STARTED = 0x00UL;
     NRF_SAADC->TASKS_SAMPLE = 0x01UL;
+#else
+    NRF_ADC->EVENTS_END = 0;
+    NRF_ADC->TASKS_START = 1;
+#endif
+}
+
+static uint16_t ADC_Result(void)
+{
+#if defined(S112)
     while (!NRF_SAADC->EVENTS_END);
     NRF_SAADC->EVENTS_END = 0x00UL;
     NRF_SAADC->TASKS_STOP = 0x01UL;
     while (!NRF_SAADC->EVENTS_STOPPED);
     NRF_SAADC->EVENTS_STOPPED = 0x00UL;
-    if (value < 0) value = 0;
-    NRF_SAADC->ENABLE = (SAADC_ENABLE_ENABLE_Disabled << SAADC_ENABLE_ENABLE_Pos);
+    return m_saadc_result < 0 ? 0 : m_saadc_result;
 #else
-    NRF_ADC->ENABLE = 1;
-    NRF_ADC->CONFIG = (ADC_CONFIG_RES_10bit << ADC_CONFIG_RES_Pos) |
-                      (ADC_CONFIG_INPSEL_SupplyOneThirdPrescaling << ADC_CONFIG_INPSEL_Pos) |
-                      (ADC_CONFIG_REFSEL_VBG << ADC_CONFIG_REFSEL_Pos) |
-                      (ADC_CONFIG_PSEL_Disabled << ADC_CONFIG_PSEL_Pos) |
-                      (ADC_CONFIG_EXTREFSEL_None << ADC_CONFIG_EXTREFSEL_Pos);
-    NRF_ADC->TASKS_START = 1;
-    while(!NRF_ADC->EVENTS_END);
+    while (!NRF_ADC->EVENTS_END);
     NRF_ADC->EVENTS_END = 0;
     uint16_t value = NRF_ADC->RESULT;
     NRF_ADC->TASKS_STOP = 1;
-    NRF_ADC->ENABLE = 0;
+    return value;
+#endif
+}
+
+static float ADC_Voltage(uint32_t sum, uint8_t count)
+{
+    NRF_LOG_DEBUG("ADC value: %d\n", sum / count);
+    return sum * VOLTAGE_FULL_SCALE / count / (1 << 10);
+}
+
+// One conversion per tick, in the timer interrupt; the measurement is dropped if the panel is powered
+static void voltage_timeout_handler(void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+
+    if (m_driver_refs > 0) { // restarted by EPD_GPIO_Uninit
+        if (m_voltage.converting) ADC_Disable();
+        m_voltage.converting = false;
+        return;
+    }
+
+    if (m_voltage.converting) {
+        m_voltage.sum += ADC_Result();
+        if (++m_voltage.count == VOLTAGE_SAMPLES) {
+            ADC_Disable();
+            m_voltage.converting = false;
+            m_voltage.value = ADC_Voltage(m_voltage.sum, m_voltage.count);
+            return;
+        }
+    } else {
+        ADC_Enable();
+    }
+    ADC_Start();
+    m_voltage.converting = true;
+    APP_ERROR_CHECK(app_timer_start(m_voltage_timer_id, VOLTAGE_TICKS(VOLTAGE_SAMPLE_MS), NULL));
+}
+
+void EPD_VoltageInit(void)
+{
+    uint32_t sum = 0;
+
+    if (!m_voltage.created) {
+        APP_ERROR_CHECK(app_timer_create(&m_voltage_timer_id, APP_TIMER_MODE_SINGLE_SHOT, voltage_timeout_handler));
+        m_voltage.created = true;
+    }
+
+    // first measurement, blocking
+    ADC_Enable();
+#if defined(S112)
+    NRF_SAADC->EVENTS_CALIBRATEDONE = 0x00UL;
+    NRF_SAADC->TASKS_CALIBRATEOFFSET = 0x01UL;
+    while (!NRF_SAADC->EVENTS_CALIBRATEDONE);
+    NRF_SAADC->EVENTS_CALIBRATEDONE = 0x00UL;
 #endif
-    NRF_LOG_DEBUG("ADC value: %d\n", value);
-    return (value * 3.6) / (1 << 10);
+    for (uint8_t i = 0; i < VOLTAGE_SAMPLES; i++) {
+        ADC_Start();
+        sum += ADC_Result();
+    }
+    ADC_Disable();
+    m_voltage.value = ADC_Voltage(sum, VOLTAGE_SAMPLES);
+}
+
+void EPD_VoltageStart(void)
+{
+    if (!m_voltage.created) return;
+
+    CRITICAL_REGION_ENTER();
+    app_timer_stop(m_voltage_timer_id);
+    if (m_voltage.converting) ADC_Disable();
+    m_voltage.converting = false;
+    m_voltage.count = 0;
+    m_voltage.sum = 0;
+    CRITICAL_REGION_EXIT();
+    APP_ERROR_CHECK(app_timer_start(m_voltage_timer_id, VOLTAGE_TICKS(VOLTAGE_SETTLE_MS), NULL));
+}
+
+float EPD_ReadVoltage(void)
+{
+    return m_voltage.value;
+}
+
+// A fresh coin cell down to the battery_empty threshold, the panel stops refreshing there
+uint8_t EPD_VoltageLevel(float voltage)
+{
+    uint16_t mv = (uint16_t)(voltage * 1000), empty = epd_battery_empty_mv();
+    if (mv >= BATTERY_FULL_MV) return 100;
+    if (mv <= empty) return 0;
+    return (uint8_t)((uint32_t)(mv - empty) * 100 / (BATTERY_FULL_MV - empty));
+}
+
+int8_t EPD_ReadDieTemp(void)
+{
+    int32_t temp; // 0.25 degC
+
+    if (sd_temp_get(&temp) != NRF_SUCCESS) return 0;
+    return (int8_t)(temp / 4);
 }
 
 // EPD models
@@ -342,15 +579,108 @@ static epd_model_t *epd_models[] = {
     &epd_jd79668_750_bwry,
 };
 
-epd_model_t *epd_init(epd_model_id_t id)
+epd_state_t EPD_State(void)
+{
+    return m_state;
+}
+
+void EPD_SetState(epd_state_t state)
+{
+    m_state = state;
+}
+
+static epd_ready_t m_ready = NULL;
+static epd_model_t *m_custom = NULL; // uploaded model
+
+static epd_model_t *epd_model(epd_model_id_t id)
 {
     epd_model_t *epd = NULL;
+    if (m_custom != NULL && m_custom->id == id) return m_custom;
     for (uint8_t i = 0; i < ARRAY_SIZE(epd_models); i++) {
         if (epd_models[i]->id == id) {
             epd = epd_models[i];
         }
     }
     if (epd == NULL) epd = epd_models[0];
-    epd->drv->init(epd);
     return epd;
 }
+
+epd_driver_t *epd_driver(epd_driver_ic_t ic)
+{
+    for (uint8_t i = 0; i < ARRAY_SIZE(epd_models); i++) {
+        if (epd_models[i]->drv->ic == ic)
+            return epd_models[i]->drv;
+    }
+    return NULL;
+}
+
+void epd_model_register(epd_model_t *epd)
+{
+    epd_sequence_flush(); // may run the init sequence of the old one
+    m_custom = epd;
+    if (m_state == EPD_STATE_STANDBY) m_state = EPD_STATE_DEEP_SLEEP; // no wake, pins released as usual
+}
+
+static const uint8_t m_probe_reset[] = { EPD_SEQ_RESET(10), EPD_SEQ_END };
+
+bool epd_probe(epd_model_id_t id, epd_probe_t *result)
+{
+    epd_model_t *epd = epd_model(id);
+
+    memset(result, 0, sizeof(epd_probe_t));
+    result->model = epd->id;
+    epd_sequence_run(NULL, m_probe_reset);
+    m_state = EPD_STATE_OFF;
+    // every probe once, in the order of the models (UC81xx first)
+    for (uint8_t i = 0; i < ARRAY_SIZE(epd_models); i++) {
+        epd_driver_t *drv = epd_models[i]->drv;
+        bool tried = drv->probe == NULL;
+        for (uint8_t j = 0; j < i && !tried; j++)
+            tried = epd_models[j]->drv->probe == drv->probe;
+        if (tried) continue;
+
+        result->len = drv->probe(result->id);
+        if (result->len == 0) continue;
+        if (epd->drv->probe != drv->probe) epd = epd_models[i];
+        result->model = epd->id;
+        result->family = drv->family;
+        NRF_LOG_INFO("[EPD]: probe found family %d, model %d\n", result->family, result->model);
+        return true;
+    }
+    NRF_LOG_INFO("[EPD]: probe found no controller\n");
+    return false;
+}
+
+epd_model_t *epd_init(epd_model_id_t id)
+{
+    epd_model_t *epd = epd_model(id);
+    epd_sequence_run(epd, epd->drv->init_seq);
+    if (epd->drv->init != NULL) epd->drv->init(epd);
+    m_state = EPD_STATE_STANDBY;
+    m_epd = epd;
+    return epd;
+}
+
+static void epd_resume_init(void)
+{
+    if (m_epd->drv->init != NULL) m_epd->drv->init(m_epd);
+    m_state = EPD_STATE_STANDBY;
+    m_ready(m_epd);
+}
+
+void epd_resume(epd_model_id_t id, epd_ready_t ready)
+{
+    epd_sequence_flush();
+    epd_model_t *epd = epd_model(id);
+
+    if (m_state == EPD_STATE_STANDBY && m_epd == epd && epd->drv->wake != NULL) {
+        NRF_LOG_DEBUG("[EPD]: resume\n");
+        epd->drv->wake(epd);
+        ready(epd);
+        return;
+    }
+    // the state stays until the init is done, its hook tells a power cut from a reset
+    m_epd = epd;
+    m_ready = ready;
+    epd_sequence_start(epd, epd->drv->init_seq, epd_resume_init);
+}
@@ -7,6 +7,7 @@
 #include "nrf_delay.h"
 #include "nrf_gpio.h"
 #include "EPD_config.h"
+#include "EPD_sequence.h"
 
 // EPD driver IC types
 typedef enum
@@ -20,6 +21,13 @@ typedef enum
     EPD_DRIVER_IC_JD79665 = 0x31,
 } epd_driver_ic_t;
 
+// Controller families told apart by epd_probe(), the ICs of a family answer its probe alike
+typedef enum
+{
+    EPD_DRIVER_FAMILY_UC81XX = 0x01,  // UC8159, UC8176, UC8179, JD79668, JD79665
+    EPD_DRIVER_FAMILY_SSD16XX = 0x02, // SSD1619, SSD1677
+} epd_driver_family_t;
+
 // UC81xx commands
 enum {
     UC81xx_PSR = 0x00,   // Panel Setting
@@ -146,7 +154,7 @@ typedef enum
 
 struct epd_driver;
 
-typedef struct
+typedef struct epd_model
 {
     epd_model_id_t id;
     epd_color_t color;
@@ -162,15 +170,42 @@ typedef struct
 typedef struct epd_driver
 {
     epd_driver_ic_t ic;                             /**< EPD driver IC type */
-    void (*init)(epd_model_t *epd);                 /**< Initialize the e-Paper register */
+    epd_driver_family_t family;                     /**< Family answering the probe */
+    const uint8_t *init_seq;                        /**< Reset and register writes (EPD_sequence.h) */
+    void (*init)(epd_model_t *epd);                 /**< Registers set in code after init_seq, may be NULL */
     void (*clear)(epd_model_t *epd, bool refresh);  /**< Clear screen */
     void (*write_image)(epd_model_t *epd, uint8_t *black, uint8_t *color, uint16_t x, uint16_t y, uint16_t w, uint16_t h); /**< write image */
+    void (*write_partial)(epd_model_t *epd, uint8_t *black, uint8_t *color, uint16_t x, uint16_t y, uint16_t w, uint16_t h); /**< Write a window for partial_refresh, NULL: write_image */
     void (*write_ram)(epd_model_t *epd, uint8_t cfg, uint8_t *data, uint8_t len); /* write data to epd ram */
+    void (*read_image)(epd_model_t *epd, uint8_t *black, uint8_t *color, uint16_t x, uint16_t y, uint16_t w, uint16_t h); /**< Read back a window written by write_image, same layout, NULL if not supported */
     void (*refresh)(epd_model_t *epd);              /**< Sends the image buffer in RAM to e-Paper and displays */
+    bool (*partial_refresh)(epd_model_t *epd, uint16_t x, uint16_t y, uint16_t w, uint16_t h); /**< Refresh a window of the screen only, NULL if not supported. False if the controller lost the rest of the image (power cut), nothing is refreshed */
     void (*sleep)(epd_model_t *epd);                /**< Enter sleep mode */
     int8_t (*read_temp)(epd_model_t *epd);          /**< Read temperature from driver chip */
+    void (*set_temp)(epd_model_t *epd, int8_t temp); /**< Temperature for the waveform of the next refresh, NULL: the chip reads its sensor */
+    void (*wake)(epd_model_t *epd);                 /**< Resume from standby with the registers of the last init, NULL: init runs again */
+    uint8_t (*probe)(uint8_t *id);                  /**< Check the controller after a reset, ID bytes read (EPD_PROBE_ID_SIZE max), 0: other controller */
 } epd_driver_t;
 
+#define EPD_PROBE_ID_SIZE 11
+
+/**@brief Result of epd_probe(). */
+typedef struct
+{
+    epd_model_id_t model;            /**< Model to use: the given one if its driver answered, else the first of the answering driver */
+    uint8_t family;                  /**< epd_driver_family_t of the answering driver, 0 if no controller answered */
+    uint8_t len;                     /**< Bytes of id */
+    uint8_t id[EPD_PROBE_ID_SIZE];   /**< Read by the probe: FLG and REV (UC81xx), status and user ID (SSD16xx) */
+} epd_probe_t;
+
+/**@brief Controller state between updates, tells what a resume has to send again. */
+typedef enum
+{
+    EPD_STATE_OFF = 0,     /**< Unpowered or held in reset, registers and RAM are lost */
+    EPD_STATE_DEEP_SLEEP,  /**< Deep sleep, only a hardware reset wakes it up, with reset registers */
+    EPD_STATE_STANDBY,     /**< Configured by the last init, analog power off */
+} epd_state_t;
+
 #define LOW             (0x0)
 #define HIGH            (0x1)
 
@@ -189,7 +224,8 @@ void pinMode(uint32_t pin, uint32_t mode);
 // GPIO
 void EPD_GPIO_Load(epd_config_t *cfg);
 void EPD_GPIO_Init(void);
-void EPD_GPIO_Uninit(void);
+void EPD_GPIO_Uninit(void);   // keeps RST and CS high while a controller in standby can resume
+void EPD_GPIO_Release(void);  // hold the controller in reset again, e.g. before system off
 
 // SPI
 void EPD_SPI_Write(uint8_t *value, uint8_t len);
@@ -208,8 +244,16 @@ uint8_t EPD_ReadByte(void);
         EPD_WriteData(_data, sizeof(_data)); \
     } while (0)
 void EPD_FillRAM(uint8_t cmd, uint8_t value, uint32_t len);
-void EPD_Reset(uint32_t value, uint16_t duration);
 void EPD_WaitBusy(uint32_t value, uint16_t timeout);
+void EPD_ResetPin(uint32_t value);
+uint32_t EPD_BusyPin(void);
+// Single shot timer of the step executor (EPD_sequence.h), expires into epd_sequence_timeout()
+void EPD_SeqTimerStart(uint16_t ms);
+void EPD_SeqTimerStop(void);
+epd_state_t EPD_State(void);
+void EPD_SetState(epd_state_t state);
+// RTC1 ticks (32768Hz, 24-bit)
+uint32_t EPD_Ticks(void);
 
 // LED
 void EPD_LED_ON(void);
@@ -217,9 +261,28 @@ void EPD_LED_OFF(void);
 void EPD_LED_Toggle(void);
 void EPD_LED_BLINK(void);
 
-// VDD voltage
-float EPD_ReadVoltage(void);
+// VDD voltage, measured in the background after the panel is powered off (EPD_GPIO_Uninit)
+void EPD_VoltageInit(void);   // first measurement (blocking), call after app_timer_init
+void EPD_VoltageStart(void);  // new measurement after a settle time
+float EPD_ReadVoltage(void);  // last measurement, returns at once
+uint8_t EPD_VoltageLevel(float voltage); // battery icon fill 0..100, BATTERY_FULL_MV down to battery_empty
+
+// MCU die temperature (sd_temp_get), no panel access
+int8_t EPD_ReadDieTemp(void);
+
+typedef void (*epd_ready_t)(epd_model_t *epd);
 
 epd_model_t *epd_init(epd_model_id_t id);
+// epd_init() with the waits of the init sequence on the timer, ready runs from the timer interrupt
+// once the init is done. Calls ready at once if the controller is in standby with this model (wake).
+void epd_resume(epd_model_id_t id, epd_ready_t ready);
+// Finds the driver of the attached controller with reads only (and a SSD16xx software reset),
+// the panel has to be initialized again afterwards. Returns false if no controller answered.
+bool epd_probe(epd_model_id_t id, epd_probe_t *result);
+// Driver of the first built-in model with this IC, NULL if there is none
+epd_driver_t *epd_driver(epd_driver_ic_t ic);
+// Model looked up before the built-in ones (uploaded, EPD_model.h), NULL removes it.
+// The next update initializes the controller again.
+void epd_model_register(epd_model_t *epd);
 
 #endif
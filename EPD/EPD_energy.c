@@ -0,0 +1,200 @@
+#include <string.h>
+#include "EPD_energy.h"
+#include "EPD_driver.h"
+
+#define ENERGY_SPI_BYTE_US  2      // 4 MHz (NRF_DRV_SPI_DEFAULT_CONFIG)
+#define ENERGY_PANEL_NA     4000000 // panel supply while running a waveform, typical 4.2" panel
+
+// Typical currents at 3 V with the LDO (datasheets), nA; ENERGY_ADVERTISING is the charge of
+// one advertising event on 3 channels at 0 dBm, nC
+static const struct {
+    const char *name;
+    uint32_t current[ENERGY_STATE_COUNT];
+    uint8_t spi_call_us;   // driver overhead of one SPI transfer
+} m_chips[] = {
+    [ENERGY_CHIP_NRF51822] = { "nRF51822", { 4000, 11000, 600000, 4600000, 4400000 + ENERGY_PANEL_NA, 4400000 }, 10 },
+    [ENERGY_CHIP_NRF52811] = { "nRF52811", { 2000, 6000, 300000, 3600000, 3300000 + ENERGY_PANEL_NA, 3300000 }, 5 },
+};
+
+static struct {
+    energy_chip_t chip;
+    uint32_t day;                           // timestamp / 86400 of today
+    uint32_t start;                         // timestamp today's accounting started
+    uint64_t us[ENERGY_STATE_COUNT];        // time in the CPU and connected states since init
+    uint64_t day_us[ENERGY_STATE_COUNT];    // us at the start of today
+    uint32_t adv_events;                    // advertising events since init
+    uint32_t day_adv_events;                // adv_events at the start of today
+    energy_state_t radio;
+    uint16_t adv_interval_ms;
+    uint32_t radio_since;                   // timestamp of the last radio change
+    energy_report_t yesterday;
+    uint32_t update_ticks;                  // display update bracket
+    uint64_t update_us[ENERGY_STATE_COUNT];
+    uint64_t wait_us;                       // timer waits in the bracket, the MCU sleeps
+    uint64_t session_us[ENERGY_STATE_COUNT];
+    uint32_t last_update;                   // uC
+    uint32_t last_session;                  // uC
+} m_energy;
+
+uint32_t epd_energy_charge(energy_state_t state, uint64_t us)
+{
+    return (uint32_t)(us * m_chips[m_energy.chip].current[state] / 1000000000);
+}
+
+uint64_t epd_energy_time(energy_state_t state)
+{
+    return m_energy.us[state];
+}
+
+// Charge of the connection and CPU states since a snapshot of us
+static uint32_t energy_charge_since(const uint64_t *since)
+{
+    uint32_t charge = 0;
+    for (uint8_t i = ENERGY_CONNECTED; i < ENERGY_STATE_COUNT; i++)
+        charge += epd_energy_charge((energy_state_t)i, m_energy.us[i] - since[i]);
+    return charge;
+}
+
+// Count the radio time up to timestamp and start a new day if needed
+static void energy_settle(uint32_t timestamp)
+{
+    // not synced yet (epd_energy_set_time)
+    if (timestamp < m_energy.radio_since) m_energy.radio_since = timestamp;
+    if (timestamp < m_energy.start) {
+        m_energy.day = timestamp / 86400;
+        m_energy.start = timestamp;
+    }
+
+    if (timestamp > m_energy.radio_since) {
+        uint32_t seconds = timestamp - m_energy.radio_since;
+        if (m_energy.radio == ENERGY_CONNECTED)
+            m_energy.us[ENERGY_CONNECTED] += (uint64_t)seconds * 1000000;
+        else if (m_energy.radio == ENERGY_ADVERTISING && m_energy.adv_interval_ms > 0)
+            m_energy.adv_events += seconds * 1000 / m_energy.adv_interval_ms;
+        m_energy.radio_since = timestamp;
+    }
+
+    // the day is closed at the first event after midnight, the calendar updates at midnight
+    if (timestamp / 86400 > m_energy.day) {
+        m_energy.day = timestamp / 86400;
+        epd_energy_report(0, timestamp, &m_energy.yesterday);
+        memcpy(m_energy.day_us, m_energy.us, sizeof(m_energy.us));
+        m_energy.day_adv_events = m_energy.adv_events;
+        m_energy.start = timestamp;
+    }
+}
+
+void epd_energy_init(energy_chip_t chip, uint32_t timestamp)
+{
+    memset(&m_energy, 0, sizeof(m_energy));
+    m_energy.chip = chip < sizeof(m_chips) / sizeof(m_chips[0]) ? chip : ENERGY_CHIP_DEFAULT;
+    m_energy.day = timestamp / 86400;
+    m_energy.start = timestamp;
+    m_energy.radio = ENERGY_SLEEP;
+    m_energy.radio_since = timestamp;
+}
+
+void epd_energy_set_time(uint32_t now, uint32_t timestamp)
+{
+    energy_settle(now);
+    m_energy.start = timestamp - (now - m_energy.start); // keep the time counted today
+    m_energy.radio_since = timestamp;
+    m_energy.day = timestamp / 86400;
+}
+
+const char *epd_energy_chip_name(void)
+{
+    return m_chips[m_energy.chip].name;
+}
+
+void epd_energy_radio(energy_state_t state, uint16_t interval_ms, uint32_t timestamp)
+{
+    energy_settle(timestamp);
+    if (m_energy.radio == ENERGY_CONNECTED && state != ENERGY_CONNECTED)
+        m_energy.last_session = energy_charge_since(m_energy.session_us);
+    if (state == ENERGY_CONNECTED && m_energy.radio != ENERGY_CONNECTED)
+        memcpy(m_energy.session_us, m_energy.us, sizeof(m_energy.us));
+    m_energy.radio = state;
+    m_energy.adv_interval_ms = interval_ms;
+}
+
+void epd_energy_spi(uint8_t len)
+{
+    m_energy.us[ENERGY_SPI] += m_chips[m_energy.chip].spi_call_us + len * ENERGY_SPI_BYTE_US;
+}
+
+void epd_energy_busy(uint32_t ms)
+{
+    m_energy.us[ENERGY_BUSY] += (uint64_t)ms * 1000;
+}
+
+void epd_energy_wait(uint32_t ms)
+{
+    m_energy.wait_us += (uint64_t)ms * 1000;
+}
+
+void epd_energy_update_begin(void)
+{
+    m_energy.update_ticks = EPD_Ticks();
+    m_energy.wait_us = 0;
+    memcpy(m_energy.update_us, m_energy.us, sizeof(m_energy.us));
+}
+
+uint32_t epd_energy_update_end(uint32_t timestamp)
+{
+    uint64_t elapsed = (uint64_t)((EPD_Ticks() - m_energy.update_ticks) & 0xFFFFFF) * 1000000 / 32768;
+    uint64_t active = (m_energy.us[ENERGY_SPI] - m_energy.update_us[ENERGY_SPI]) +
+                      (m_energy.us[ENERGY_BUSY] - m_energy.update_us[ENERGY_BUSY]) + m_energy.wait_us;
+
+    if (elapsed > active) m_energy.us[ENERGY_RENDER] += elapsed - active;
+    m_energy.last_update = 0;
+    for (uint8_t i = ENERGY_SPI; i < ENERGY_STATE_COUNT; i++)
+        m_energy.last_update += epd_energy_charge((energy_state_t)i, m_energy.us[i] - m_energy.update_us[i]);
+    energy_settle(timestamp);
+    return m_energy.last_update;
+}
+
+void epd_energy_report(uint8_t day, uint32_t timestamp, energy_report_t *report)
+{
+    energy_settle(timestamp);
+    if (day != 0) {
+        *report = m_energy.yesterday;
+        return;
+    }
+
+    memset(report, 0, sizeof(energy_report_t));
+    report->seconds = timestamp > m_energy.start ? timestamp - m_energy.start : 0;
+
+    uint64_t cpu_us = 0;
+    for (uint8_t i = ENERGY_CONNECTED; i < ENERGY_STATE_COUNT; i++) {
+        uint64_t us = m_energy.us[i] - m_energy.day_us[i];
+        report->charge[i] = epd_energy_charge((energy_state_t)i, us);
+        if (i != ENERGY_CONNECTED) cpu_us += us;
+    }
+    report->charge[ENERGY_ADVERTISING] = (uint32_t)((uint64_t)(m_energy.adv_events - m_energy.day_adv_events) *
+                                                    m_chips[m_energy.chip].current[ENERGY_ADVERTISING] / 1000);
+
+    uint64_t total_us = (uint64_t)report->seconds * 1000000;
+    report->charge[ENERGY_SLEEP] = epd_energy_charge(ENERGY_SLEEP, total_us > cpu_us ? total_us - cpu_us : 0);
+}
+
+static uint8_t *energy_put32(uint8_t *buf, uint32_t value)
+{
+    buf[0] = value >> 24;
+    buf[1] = value >> 16;
+    buf[2] = value >> 8;
+    buf[3] = value;
+    return buf + 4;
+}
+
+void epd_energy_report_encode(uint8_t day, uint32_t timestamp, uint8_t *buf)
+{
+    energy_report_t report;
+
+    epd_energy_report(day, timestamp, &report);
+    buf = energy_put32(buf, report.seconds);
+    for (uint8_t i = 0; i < ENERGY_STATE_COUNT; i++)
+        buf = energy_put32(buf, report.charge[i]);
+    buf = energy_put32(buf, m_energy.last_update);
+    energy_put32(buf, m_energy.last_session);
+}
@@ -0,0 +1,64 @@
+#ifndef __EPD_ENERGY_H
+#define __EPD_ENERGY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Charge model: time spent in each state times the typical supply current of the chip
+typedef enum {
+    ENERGY_SLEEP = 0,        // System ON idle with the RTC running, all the time not in a CPU state
+    ENERGY_ADVERTISING = 1,  // radio, counted per advertising event on top of the CPU states
+    ENERGY_CONNECTED = 2,    // radio, average current of a connection
+    ENERGY_SPI = 3,          // CPU and SPI transferring to the panel
+    ENERGY_BUSY = 4,         // CPU polling BUSY while the panel runs a waveform
+    ENERGY_RENDER = 5,       // CPU drawing the GUI and the other work of a display update
+    ENERGY_STATE_COUNT
+} energy_state_t;
+
+typedef enum {
+    ENERGY_CHIP_NRF51822 = 0,
+    ENERGY_CHIP_NRF52811 = 1,
+} energy_chip_t;
+
+#if defined(S112)
+#define ENERGY_CHIP_DEFAULT ENERGY_CHIP_NRF52811
+#else
+#define ENERGY_CHIP_DEFAULT ENERGY_CHIP_NRF51822
+#endif
+
+typedef struct {
+    uint32_t seconds;                     // time covered
+    uint32_t charge[ENERGY_STATE_COUNT];  // uC
+} energy_report_t;
+
+// Day: 0 today so far, 1 yesterday; per refresh and per session: last ones
+// Reply: seconds, charge of each state (uC), last display update, last BLE session (uC), big endian
+#define ENERGY_REPORT_SIZE (4 + 4 * ENERGY_STATE_COUNT + 4 + 4)
+
+void epd_energy_init(energy_chip_t chip, uint32_t timestamp);
+// The clock is set from now to timestamp, the accounting continues across the jump
+void epd_energy_set_time(uint32_t now, uint32_t timestamp);
+const char *epd_energy_chip_name(void);
+
+// Radio state changes: ENERGY_ADVERTISING (with its interval), ENERGY_CONNECTED, or ENERGY_SLEEP when off
+void epd_energy_radio(energy_state_t state, uint16_t interval_ms, uint32_t timestamp);
+
+// CPU states, reported by the HAL
+void epd_energy_spi(uint8_t len);
+void epd_energy_busy(uint32_t ms);
+void epd_energy_wait(uint32_t ms);  // timer wait of a panel sequence, sleep instead of render
+
+// Brackets a display update, the time not spent on SPI or BUSY is counted as render,
+// returns the charge of the update (uC)
+void epd_energy_update_begin(void);
+uint32_t epd_energy_update_end(uint32_t timestamp);
+
+// Charge of a state over a time (uC)
+uint32_t epd_energy_charge(energy_state_t state, uint64_t us);
+// Time counted in a CPU state since init (us)
+uint64_t epd_energy_time(energy_state_t state);
+
+void epd_energy_report(uint8_t day, uint32_t timestamp, energy_report_t *report);
+void epd_energy_report_encode(uint8_t day, uint32_t timestamp, uint8_t *buf);
+
+#endif
@@ -0,0 +1,89 @@
+#include <string.h>
+#include "fds.h"
+#include "EPD_holiday.h"
+#include "EPD_config.h"
+#include "nrf_log.h"
+
+#define HOLIDAY_YEAR_MIN  2000
+#define HOLIDAY_YEAR_MAX  2199 // range of the lunar calendar (Lunar.c)
+#define HOLIDAY_YEAR_NONE 0xFFFF
+
+typedef struct {
+    uint16_t year;
+    uint8_t bitmap[HOLIDAY_BITMAP_SIZE];
+    uint8_t reserved[2];                 // word size
+} holiday_record_t;
+
+static struct {
+    uint16_t lookup;           // year of the last lookup, the record is read once per year
+    holiday_record_t cache;    // record of that year, year is HOLIDAY_YEAR_NONE if there is none
+    holiday_record_t upload;   // filled by the BLE chunks, kept until FDS is done with it
+    bool busy;                 // record write in progress
+} m_holiday;
+
+static uint16_t holiday_key(uint16_t year)
+{
+    return HOLIDAY_REC_KEY + year % HOLIDAY_SLOTS;
+}
+
+static void fds_evt_handler(fds_evt_t const * const p_fds_evt)
+{
+    if ((p_fds_evt->id == FDS_EVT_WRITE || p_fds_evt->id == FDS_EVT_UPDATE) &&
+        p_fds_evt->write.record_key == holiday_key(m_holiday.upload.year))
+        m_holiday.busy = false;
+}
+
+void epd_holiday_init(void)
+{
+    memset(&m_holiday, 0, sizeof(m_holiday));
+    m_holiday.cache.year = HOLIDAY_YEAR_NONE;
+    if (fds_register(fds_evt_handler) != NRF_SUCCESS)
+        NRF_LOG_ERROR("epd_holiday_init: fds_register failed\n");
+}
+
+const uint8_t *epd_holiday_get(uint16_t year)
+{
+    if (m_holiday.lookup != year) {
+        m_holiday.lookup = year;
+        m_holiday.cache.year = HOLIDAY_YEAR_NONE;
+        if (year >= HOLIDAY_YEAR_MIN && year <= HOLIDAY_YEAR_MAX &&
+            epd_config_record_read(holiday_key(year), &m_holiday.cache, sizeof(holiday_record_t)) &&
+            m_holiday.cache.year != year) // an older year in the same slot
+            m_holiday.cache.year = HOLIDAY_YEAR_NONE;
+    }
+    return m_holiday.cache.year == year ? m_holiday.cache.bitmap : NULL;
+}
+
+holiday_upload_t epd_holiday_upload(uint16_t year, uint8_t offset, uint8_t const *data, uint8_t len)
+{
+    if (year < HOLIDAY_YEAR_MIN || year > HOLIDAY_YEAR_MAX || offset + len > HOLIDAY_BITMAP_SIZE)
+        return HOLIDAY_UPLOAD_ERR_PARAM;
+    if (m_holiday.busy) return HOLIDAY_UPLOAD_ERR_BUSY;
+
+    if (len == 0 && offset == 0) {
+        holiday_record_t record;
+        if (epd_config_record_read(holiday_key(year), &record, sizeof(record)) && record.year == year &&
+            !epd_config_record_delete(holiday_key(year)))
+            return HOLIDAY_UPLOAD_ERR_FLASH;
+        if (m_holiday.lookup == year) m_holiday.cache.year = HOLIDAY_YEAR_NONE;
+        return HOLIDAY_UPLOAD_OK;
+    }
+
+    if (offset == 0) {
+        memset(&m_holiday.upload, 0, sizeof(holiday_record_t));
+        m_holiday.upload.year = year;
+    } else if (m_holiday.upload.year != year) {
+        return HOLIDAY_UPLOAD_ERR_PARAM; // the first chunk is missing
+    }
+    memcpy(&m_holiday.upload.bitmap[offset], data, len);
+    if (offset + len < HOLIDAY_BITMAP_SIZE) return HOLIDAY_UPLOAD_OK;
+
+    NRF_LOG_INFO("holidays of %d uploaded\n", year);
+    m_holiday.busy = true;
+    if (!epd_config_record_write(holiday_key(year), &m_holiday.upload, sizeof(holiday_record_t))) {
+        m_holiday.busy = false;
+        return HOLIDAY_UPLOAD_ERR_FLASH;
+    }
+    if (m_holiday.lookup == year) m_holiday.cache = m_holiday.upload;
+    return HOLIDAY_UPLOAD_OK;
+}
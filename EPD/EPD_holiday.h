@@ -0,0 +1,26 @@
+#ifndef __EPD_HOLIDAY_H
+#define __EPD_HOLIDAY_H
+
+#include <stdint.h>
+#include "GUI.h"
+
+// Years kept in flash, year % HOLIDAY_SLOTS picks the record, a new year replaces the one
+// HOLIDAY_SLOTS years older
+#define HOLIDAY_SLOTS     4
+#define HOLIDAY_REC_KEY   0x0100 // + slot, config file (EPD_config.h)
+
+typedef enum {
+    HOLIDAY_UPLOAD_OK = 0,
+    HOLIDAY_UPLOAD_ERR_PARAM = 1,  // year or offset out of range
+    HOLIDAY_UPLOAD_ERR_BUSY = 2,   // the last year is still being written, retry
+    HOLIDAY_UPLOAD_ERR_FLASH = 3,
+} holiday_upload_t;
+
+void epd_holiday_init(void);
+// Bitmap of a year (HOLIDAY_BITMAP_SIZE bytes, GUI.h), NULL if none was uploaded
+const uint8_t *epd_holiday_get(uint16_t year);
+// Part of the bitmap of a year at offset, the record is written once the last byte arrives;
+// no data at offset 0 deletes the year
+holiday_upload_t epd_holiday_upload(uint16_t year, uint8_t offset, uint8_t const *data, uint8_t len);
+
+#endif
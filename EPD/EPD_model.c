@@ -0,0 +1,124 @@
+#include <string.h>
+#include "fds.h"
+#include "EPD_model.h"
+#include "EPD_config.h"
+#include "EPD_driver.h"
+#include "nrf_log.h"
+
+#define MODEL_SIZE_MAX 2048
+#define MODEL_SLOT_NONE 0xFF
+
+static struct {
+    epd_model_record_t active;  // record of the registered model, its init sequence runs from here
+    epd_driver_t drv;           // built-in driver with the uploaded init sequence
+    epd_model_t epd;
+    uint8_t active_slot;        // MODEL_SLOT_NONE if no model is registered
+    epd_model_record_t upload;  // filled by the BLE chunks, kept until FDS is done with it
+    uint8_t slot;               // of the upload
+    bool busy;                  // record write in progress
+} m_model;
+
+static void fds_evt_handler(fds_evt_t const * const p_fds_evt)
+{
+    if ((p_fds_evt->id == FDS_EVT_WRITE || p_fds_evt->id == FDS_EVT_UPDATE) &&
+        p_fds_evt->write.record_key == MODEL_REC_KEY + m_model.slot)
+        m_model.busy = false;
+}
+
+static bool model_valid(epd_model_record_t const *rec)
+{
+    return epd_driver((epd_driver_ic_t)rec->ic) != NULL &&
+           rec->color >= BW && rec->color <= BWRY &&
+           rec->width > 0 && rec->width <= MODEL_SIZE_MAX &&
+           rec->height > 0 && rec->height <= MODEL_SIZE_MAX &&
+           rec->len <= MODEL_SEQ_SIZE && epd_sequence_check(rec->seq, rec->len);
+}
+
+// Registers the model of m_model.active
+static void model_activate(uint8_t slot)
+{
+    epd_model_record_t const *rec = &m_model.active;
+
+    m_model.drv = *epd_driver((epd_driver_ic_t)rec->ic);
+    m_model.drv.init_seq = rec->seq;
+    m_model.epd.id = (epd_model_id_t)rec->id;
+    m_model.epd.color = (epd_color_t)rec->color;
+    m_model.epd.drv = &m_model.drv;
+    m_model.epd.width = rec->width;
+    m_model.epd.height = rec->height;
+    m_model.active_slot = slot;
+    epd_model_register(&m_model.epd);
+}
+
+static void model_deactivate(void)
+{
+    epd_model_register(NULL); // before m_model.active changes, its sequence may be queued
+    m_model.active_slot = MODEL_SLOT_NONE;
+}
+
+void epd_model_init(void)
+{
+    memset(&m_model, 0, sizeof(m_model));
+    m_model.active_slot = MODEL_SLOT_NONE;
+    if (fds_register(fds_evt_handler) != NRF_SUCCESS)
+        NRF_LOG_ERROR("epd_model_init: fds_register failed\n");
+}
+
+void epd_model_select(uint8_t id)
+{
+    model_deactivate();
+    for (uint8_t slot = 0; slot < MODEL_SLOTS; slot++) {
+        if (epd_config_record_read(MODEL_REC_KEY + slot, &m_model.active, sizeof(epd_model_record_t)) &&
+            m_model.active.id == id && model_valid(&m_model.active)) {
+            NRF_LOG_INFO("uploaded model %d in slot %d\n", id, slot);
+            model_activate(slot);
+            return;
+        }
+    }
+}
+
+model_upload_t epd_model_upload(uint8_t slot, uint8_t offset, uint8_t const *data, uint8_t len, uint8_t id)
+{
+    if (slot >= MODEL_SLOTS || offset + len > sizeof(epd_model_record_t))
+        return MODEL_UPLOAD_ERR_PARAM;
+    if (m_model.busy) return MODEL_UPLOAD_ERR_BUSY;
+
+    if (len == 0 && offset == 0) {
+        if (epd_config_record_read(MODEL_REC_KEY + slot, &m_model.upload, sizeof(epd_model_record_t)) &&
+            !epd_config_record_delete(MODEL_REC_KEY + slot))
+            return MODEL_UPLOAD_ERR_FLASH;
+        memset(&m_model.upload, 0, sizeof(epd_model_record_t));
+        if (m_model.active_slot == slot) model_deactivate();
+        return MODEL_UPLOAD_OK;
+    }
+
+    if (offset == 0) {
+        if (len < MODEL_HEADER_SIZE) return MODEL_UPLOAD_ERR_PARAM;
+        memset(&m_model.upload, 0, sizeof(epd_model_record_t));
+        m_model.slot = slot;
+    } else if (m_model.slot != slot || m_model.upload.width == 0) {
+        return MODEL_UPLOAD_ERR_PARAM; // the first chunk is missing
+    }
+    memcpy((uint8_t *)&m_model.upload + offset, data, len);
+    if (m_model.upload.len <= MODEL_SEQ_SIZE && offset + len < MODEL_HEADER_SIZE + m_model.upload.len)
+        return MODEL_UPLOAD_OK;
+
+    if (!model_valid(&m_model.upload)) {
+        memset(&m_model.upload, 0, sizeof(epd_model_record_t));
+        return MODEL_UPLOAD_ERR_MODEL;
+    }
+    NRF_LOG_INFO("model %d uploaded to slot %d\n", m_model.upload.id, slot);
+    m_model.busy = true;
+    if (!epd_config_record_write(MODEL_REC_KEY + slot, &m_model.upload, sizeof(epd_model_record_t))) {
+        m_model.busy = false;
+        return MODEL_UPLOAD_ERR_FLASH;
+    }
+    if (m_model.upload.id == id) { // the record in flash is not updated yet
+        model_deactivate();
+        m_model.active = m_model.upload;
+        model_activate(slot);
+    } else if (m_model.active_slot == slot) {
+        model_deactivate();
+    }
+    return MODEL_UPLOAD_OK;
+}
@@ -0,0 +1,42 @@
+#ifndef __EPD_MODEL_H
+#define __EPD_MODEL_H
+
+#include <stdint.h>
+
+// Models uploaded over BLE: a built-in driver (image format, refresh) with its own color,
+// resolution and init sequence (EPD_sequence.h), so new panels need no firmware update.
+// An uploaded model with the id of a built-in one replaces it.
+#define MODEL_SLOTS       2
+#define MODEL_REC_KEY     0x0200 // + slot, config file (EPD_config.h)
+#define MODEL_SEQ_SIZE    120
+
+// Record, also the upload format (little endian)
+typedef struct {
+    uint8_t id;                   // epd_model_id_t
+    uint8_t ic;                   // epd_driver_ic_t of a built-in model
+    uint8_t color;                // epd_color_t
+    uint8_t len;                  // bytes of seq
+    uint16_t width;
+    uint16_t height;
+    uint8_t seq[MODEL_SEQ_SIZE];  // init sequence, reset included
+} epd_model_record_t;
+
+#define MODEL_HEADER_SIZE 8 // record without seq
+
+typedef enum {
+    MODEL_UPLOAD_OK = 0,
+    MODEL_UPLOAD_ERR_PARAM = 1,   // slot or offset out of range
+    MODEL_UPLOAD_ERR_BUSY = 2,    // the last record is still being written, retry
+    MODEL_UPLOAD_ERR_FLASH = 3,
+    MODEL_UPLOAD_ERR_MODEL = 4,   // unknown driver or color, bad size or sequence
+} model_upload_t;
+
+void epd_model_init(void);
+// Registers the uploaded model with this id with the driver (epd_model_register), if any
+void epd_model_select(uint8_t id);
+// Part of the record of a slot at offset, written once the last byte of its sequence arrives;
+// no data at offset 0 deletes the slot. id is the configured model, registered at once if the
+// upload is for it.
+model_upload_t epd_model_upload(uint8_t slot, uint8_t offset, uint8_t const *data, uint8_t len, uint8_t id);
+
+#endif
@@ -0,0 +1,239 @@
+#include <string.h>
+#include "EPD_sequence.h"
+#include "EPD_driver.h"
+#include "EPD_capture.h"
+#include "EPD_energy.h"
+#include "app_util_platform.h"
+#include "nrf_log.h"
+
+#define SEQUENCE_POLL_MS 5 // BUSY polling interval while the MCU sleeps
+
+static struct {
+    struct {
+        struct epd_model *epd;
+        const uint8_t *seq;
+        epd_sequence_done_t done;
+    } queue[EPD_SEQUENCE_QUEUE];
+    uint8_t head;
+    uint8_t count;
+    const uint8_t *pc;       // next instruction of the head sequence
+    uint16_t waited;         // ms spent on the current BUSY instruction
+    uint16_t wait_ms;        // length of the running timer
+    uint32_t wait_ticks;     // EPD_Ticks() at its start
+    bool timer;              // waiting for the timer
+    bool running;            // in seq_run(), sequences queued by a done handler wait for it
+} m_seq;
+
+static void seq_wait(uint16_t ms)
+{
+    m_seq.wait_ms = ms;
+    m_seq.wait_ticks = EPD_Ticks();
+    m_seq.timer = true;
+    EPD_SeqTimerStart(ms);
+}
+
+static uint8_t seq_len(const uint8_t *pc)
+{
+    uint8_t arg = *pc & EPD_OP_ARG;
+
+    switch (*pc & EPD_OP_MASK) {
+        case EPD_OP_CMD:
+            return 2 + arg;
+        case EPD_OP_DATA:
+            return 1 + arg;
+        case EPD_OP_DELAY:
+            return 2;
+        case EPD_OP_BUSY:
+            return 3;
+        default:
+            return 1;
+    }
+}
+
+// Skips the instructions of other model colors
+static const uint8_t *seq_skip(epd_model_t *epd, const uint8_t *pc)
+{
+    while ((*pc & EPD_OP_MASK) == EPD_OP_COLOR) {
+        bool match = epd != NULL && (*pc & (1 << (epd->color - 1)));
+        pc++;
+        if (!match && *pc != EPD_OP_END) pc += seq_len(pc);
+    }
+    return pc;
+}
+
+// The data goes through RAM, SPI with EasyDMA can not read flash
+static void seq_data(const uint8_t *data, uint8_t len)
+{
+    uint8_t buf[EPD_OP_ARG];
+
+    if (len == 0) return;
+    memcpy(buf, data, len);
+    EPD_WriteData(buf, len);
+}
+
+// Runs one instruction, returns the ms to wait before it is done (0 when blocking)
+static uint16_t seq_exec(epd_model_t *epd, const uint8_t *pc, uint16_t waited, bool blocking)
+{
+    uint8_t arg = *pc & EPD_OP_ARG;
+    uint16_t ms;
+
+    switch (*pc & EPD_OP_MASK) {
+        case EPD_OP_CMD:
+            EPD_WriteCmd(pc[1]);
+            seq_data(&pc[2], arg);
+            break;
+        case EPD_OP_DATA:
+            seq_data(&pc[1], arg);
+            break;
+        case EPD_OP_RST:
+            EPD_ResetPin(arg);
+            break;
+        case EPD_OP_DELAY:
+            ms = (arg << 8) | pc[1];
+            if (!blocking) return ms;
+            delay(ms);
+            break;
+        case EPD_OP_BUSY:
+            ms = (pc[1] << 8) | pc[2];
+            if (blocking) {
+                if (waited < ms)
+                    EPD_WaitBusy(arg, ms - waited);
+                break;
+            }
+            if (EPD_BusyPin() == arg && waited < ms)
+                return SEQUENCE_POLL_MS;
+            if (waited >= ms) NRF_LOG_DEBUG("[EPD]: busy timeout!\n");
+            EPD_Capture_Busy(waited);
+            break;
+        case EPD_OP_SIZE:
+            if (epd != NULL) {
+                uint8_t size[] = { epd->width >> 8, epd->width & 0xFF, epd->height >> 8, epd->height & 0xFF };
+                EPD_WriteData(size, sizeof(size));
+            }
+            break;
+        default:
+            break;
+    }
+    return 0;
+}
+
+// Runs the queue until an instruction waits for the timer or the queue is empty
+static void seq_run(bool blocking)
+{
+    if (m_seq.running) return;
+    m_seq.running = true;
+    while (m_seq.count > 0) {
+        epd_model_t *epd = m_seq.queue[m_seq.head].epd;
+        const uint8_t *pc = seq_skip(epd, m_seq.pc);
+
+        if (*pc == EPD_OP_END) {
+            epd_sequence_done_t done = m_seq.queue[m_seq.head].done;
+            CRITICAL_REGION_ENTER();
+            m_seq.head = (m_seq.head + 1) % EPD_SEQUENCE_QUEUE;
+            m_seq.count--;
+            m_seq.pc = m_seq.queue[m_seq.head].seq;
+            m_seq.waited = 0;
+            CRITICAL_REGION_EXIT();
+            if (done != NULL) done();
+            continue;
+        }
+
+        uint16_t wait = seq_exec(epd, pc, m_seq.waited, blocking);
+        if (wait == 0) {
+            m_seq.pc = pc + seq_len(pc);
+            m_seq.waited = 0;
+            continue;
+        }
+        // the state is updated first, the host timer expires at once
+        if ((*pc & EPD_OP_MASK) == EPD_OP_BUSY) {
+            m_seq.pc = pc;
+            m_seq.waited += wait;
+        } else {
+            m_seq.pc = pc + seq_len(pc);
+        }
+        m_seq.running = false;
+        seq_wait(wait);
+        return;
+    }
+    m_seq.running = false;
+}
+
+void epd_sequence_start(epd_model_t *epd, const uint8_t *seq, epd_sequence_done_t done)
+{
+    bool idle;
+
+    if (m_seq.count == EPD_SEQUENCE_QUEUE) epd_sequence_flush();
+    CRITICAL_REGION_ENTER();
+    uint8_t tail = (m_seq.head + m_seq.count) % EPD_SEQUENCE_QUEUE;
+    m_seq.queue[tail].epd = epd;
+    m_seq.queue[tail].seq = seq;
+    m_seq.queue[tail].done = done;
+    idle = m_seq.count++ == 0;
+    if (idle) {
+        m_seq.pc = seq;
+        m_seq.waited = 0;
+    }
+    CRITICAL_REGION_EXIT();
+    if (idle) seq_run(false);
+}
+
+void epd_sequence_run(epd_model_t *epd, const uint8_t *seq)
+{
+    epd_sequence_flush();
+    for (seq = seq_skip(epd, seq); *seq != EPD_OP_END; seq = seq_skip(epd, seq + seq_len(seq)))
+        seq_exec(epd, seq, 0, true);
+}
+
+bool epd_sequence_check(const uint8_t *seq, uint16_t len)
+{
+    bool cond = false; // the last instruction was EPD_OP_COLOR
+
+    for (uint16_t i = 0; i < len; i += seq_len(&seq[i])) {
+        uint8_t op = seq[i] & EPD_OP_MASK;
+        uint8_t arg = seq[i] & EPD_OP_ARG;
+
+        if (seq[i] == EPD_OP_END) return !cond;
+        if (op == EPD_OP_END) return false; // reserved
+        if ((op == EPD_OP_RST || op == EPD_OP_BUSY) && arg > 1) return false;
+        if (op == EPD_OP_SIZE && arg != 0) return false;
+        if (op == EPD_OP_COLOR && cond) return false;
+        cond = op == EPD_OP_COLOR;
+    }
+    return false; // not terminated
+}
+
+void epd_sequence_flush(void)
+{
+    bool waiting;
+
+    CRITICAL_REGION_ENTER();
+    waiting = m_seq.timer;
+    m_seq.timer = false;
+    CRITICAL_REGION_EXIT();
+    if (!waiting) return; // idle, or running the steps right now
+
+    EPD_SeqTimerStop();
+    uint32_t elapsed = (uint32_t)(((EPD_Ticks() - m_seq.wait_ticks) & 0xFFFFFF) * 1000 / 32768);
+    if (elapsed < m_seq.wait_ms) delay(m_seq.wait_ms - elapsed);
+    epd_energy_wait(m_seq.wait_ms < elapsed ? m_seq.wait_ms : elapsed);
+    seq_run(true);
+}
+
+bool epd_sequence_pending(void)
+{
+    return m_seq.count > 0;
+}
+
+void epd_sequence_timeout(void)
+{
+    bool waiting;
+
+    CRITICAL_REGION_ENTER();
+    waiting = m_seq.timer;
+    m_seq.timer = false;
+    CRITICAL_REGION_EXIT();
+    if (!waiting) return; // flushed meanwhile
+
+    epd_energy_wait(m_seq.wait_ms);
+    seq_run(false);
+}
@@ -0,0 +1,62 @@
+#ifndef __EPD_SEQUENCE_H
+#define __EPD_SEQUENCE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Sequence bytecode: commands and pin changes run at once, delays and BUSY waits from a
+// timer (EPD_SeqTimerStart) so the MCU sleeps and the BLE stack stays responsive meanwhile.
+// The opcode is in the top 3 bits of the first byte, its argument in the low 5 bits.
+enum {
+    EPD_OP_END   = 0x00,  // end of the sequence
+    EPD_OP_CMD   = 0x20,  // | n: command byte and n data bytes
+    EPD_OP_DATA  = 0x40,  // | n: n more data bytes
+    EPD_OP_DELAY = 0x60,  // | ms >> 8, ms & 0xFF: wait ms (< 8192)
+    EPD_OP_BUSY  = 0x80,  // | level, ms >> 8, ms & 0xFF: wait up to ms while the BUSY pin is at level
+    EPD_OP_RST   = 0xA0,  // | level: RST pin level
+    EPD_OP_COLOR = 0xC0,  // | colors: the next instruction runs only for these model colors
+    EPD_OP_SIZE  = 0xE0,  // | 0: width and height of the model as data bytes (big endian)
+};
+
+#define EPD_OP_MASK  0xE0
+#define EPD_OP_ARG   0x1F
+
+// Color bits of EPD_OP_COLOR (epd_color_t)
+#define EPD_SEQ_BW   0x01
+#define EPD_SEQ_BWR  0x02
+#define EPD_SEQ_BWRY 0x04
+
+#define EPD_SEQ_CMD(cmd, n)         (EPD_OP_CMD | (n)), (cmd)
+#define EPD_SEQ_DATA(n)             (EPD_OP_DATA | (n))
+#define EPD_SEQ_DELAY(ms)           (EPD_OP_DELAY | ((ms) >> 8)), ((ms) & 0xFF)
+#define EPD_SEQ_BUSY(level, ms)     (EPD_OP_BUSY | (level)), ((ms) >> 8), ((ms) & 0xFF)
+#define EPD_SEQ_RST(level)          (EPD_OP_RST | (level))
+#define EPD_SEQ_COLOR(colors)       (EPD_OP_COLOR | (colors))
+#define EPD_SEQ_SIZE                (EPD_OP_SIZE | 0)
+#define EPD_SEQ_END                 EPD_OP_END
+// Hardware reset: high, low, high, ms each
+#define EPD_SEQ_RESET(ms) \
+    EPD_SEQ_RST(1), EPD_SEQ_DELAY(ms), EPD_SEQ_RST(0), EPD_SEQ_DELAY(ms), EPD_SEQ_RST(1), EPD_SEQ_DELAY(ms)
+
+#define EPD_SEQUENCE_QUEUE 4  // sequences waiting behind the running one
+
+struct epd_model;
+
+typedef void (*epd_sequence_done_t)(void);
+
+// Queue a sequence (EPD_OP_END terminated) for the model (colors and size, may be NULL),
+// done runs after its last instruction (may be NULL). Called from a timer interrupt when
+// the sequence had to wait.
+void epd_sequence_start(struct epd_model *epd, const uint8_t *seq, epd_sequence_done_t done);
+// Run a sequence now with blocking waits, after the queued ones
+void epd_sequence_run(struct epd_model *epd, const uint8_t *seq);
+// Finish the queued sequences now with blocking waits, before the panel is used otherwise
+void epd_sequence_flush(void);
+bool epd_sequence_pending(void);
+// True if seq is a sequence of at most len bytes (uploaded, not trusted)
+bool epd_sequence_check(const uint8_t *seq, uint16_t len);
+
+// Timer expiry, called by the HAL
+void epd_sequence_timeout(void);
+
+#endif
@@ -10,6 +10,7 @@
  *
  */
 
+#include <stddef.h>
 #include <string.h>
 #include "sdk_macros.h"
 #include "ble_srv_common.h"
@@ -18,6 +19,13 @@
 #include "nrf_pwr_mgmt.h"
 #include "app_scheduler.h"
 #include "EPD_service.h"
+#include "EPD_capture.h"
+#include "EPD_battery.h"
+#include "EPD_energy.h"
+#include "EPD_holiday.h"
+#include "EPD_model.h"
+#include "EPD_temp.h"
+#include "Lunar.h"
 #include "main.h"
 #include "nrf_log.h"
 
@@ -29,22 +37,115 @@
 // #define EPD_CFG_DEFAULT {0x05, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x01, 0x07}
 #endif
 
+#define CLOCK_SYNC_MIN_INTERVAL 43200  // seconds between the syncs of a drift measurement, the synced time has a 1 s resolution
+#define CLOCK_DRIFT_MAX         5000   // 0.1 ppm, larger errors are time or timezone changes, not drift
+
+#define CLOCK_UPDATE_INTERVAL             60   // seconds
+#define CLOCK_UPDATE_INTERVAL_LOW_BATTERY 300  // seconds, BATTERY_POLICY_SLOW_CLOCK
+
+// Deep sleep entry before the pins are released on disconnect
+static const uint8_t m_sleep_settle[] = { EPD_SEQ_DELAY(200), EPD_SEQ_END };
+
+// Display mode after the battery policies, the configured one is kept
+static display_mode_t epd_display_mode(ble_epd_t * p_epd)
+{
+    if (p_epd->config.display_mode == MODE_CLOCK && epd_battery_policy(BATTERY_POLICY_NO_CLOCK))
+        return MODE_CALENDAR;
+    return (display_mode_t)p_epd->config.display_mode;
+}
+
+static uint32_t epd_clock_interval(void)
+{
+    return epd_battery_policy(BATTERY_POLICY_SLOW_CLOCK) ? CLOCK_UPDATE_INTERVAL_LOW_BATTERY : CLOCK_UPDATE_INTERVAL;
+}
+
+// GUI_OVERLAY_* bits drawn over pictures
+static uint8_t epd_overlay(ble_epd_t * p_epd)
+{
+    return p_epd->config.overlay != EPD_OVERLAY_UNSET ? p_epd->config.overlay : 0;
+}
+
+// Display mode that sets the update times: picture overlays update like the clock, battery only like the calendar
+static display_mode_t epd_update_mode(ble_epd_t * p_epd)
+{
+    display_mode_t mode = epd_display_mode(p_epd);
+    if (mode == MODE_PICTURE && epd_overlay(p_epd) != 0)
+        return (epd_overlay(p_epd) & GUI_OVERLAY_CLOCK) ? MODE_CLOCK : MODE_CALENDAR;
+    return mode;
+}
+
+// Display update in progress, split at the panel reset that runs on the timer
+static struct {
+    epd_gui_update_event_t event;
+    epd_model_t *epd;
+    float voltage;
+    bool busy;
+} m_update;
+
+static void epd_gui_draw(void * p_event_data, uint16_t event_size);
+
+// Timer interrupt (cold start) or epd_gui_update (warm), the drawing continues in the main loop
+static void epd_gui_ready(epd_model_t *epd)
+{
+    m_update.epd = epd;
+    APP_ERROR_CHECK(app_sched_event_put(NULL, 0, epd_gui_draw));
+}
+
 static void epd_gui_update(void * p_event_data, uint16_t event_size)
 {
     epd_gui_update_event_t *event = (epd_gui_update_event_t *)p_event_data;
-    ble_epd_t *p_epd = event->p_epd;
 
+    if (m_update.busy) {
+        NRF_LOG_INFO("[EPD]: update in progress, skipped\n");
+        return;
+    }
+
+    float voltage = EPD_ReadVoltage(); // measured after the last update, with the panel off
+    if (epd_battery_update(voltage, event->timestamp))
+        clock_reschedule(); // the update interval or mode may have changed
+    if (epd_battery_policy(BATTERY_POLICY_SKIP_REFRESH)) {
+        NRF_LOG_INFO("[EPD]: battery empty, update skipped\n");
+        app_feed_wdt();
+        return;
+    }
+    if (epd_display_mode(event->p_epd) == MODE_PICTURE && epd_overlay(event->p_epd) != 0 &&
+        EPD_State() == EPD_STATE_OFF) {
+        NRF_LOG_INFO("[EPD]: picture lost with the controller RAM, overlay skipped\n");
+        app_feed_wdt();
+        return;
+    }
+
+    m_update.event = *event;
+    m_update.voltage = voltage;
+    m_update.busy = true;
+    epd_energy_update_begin();
     EPD_GPIO_Init();
-    epd_model_t *epd = epd_init((epd_model_id_t)p_epd->config.model_id);
+    epd_resume((epd_model_id_t)event->p_epd->config.model_id, epd_gui_ready);
+}
+
+static void epd_gui_draw(void * p_event_data, uint16_t event_size)
+{
+    epd_gui_update_event_t *event = &m_update.event;
+    ble_epd_t *p_epd = event->p_epd;
+    epd_model_t *epd = m_update.epd;
+    float voltage = m_update.voltage;
+
+    int8_t temperature = epd_temp_update_begin(epd, event->timestamp);
+    uint16_t year;
+    uint8_t month, day;
+    civil_from_days(event->timestamp / SEC_PER_DY, &year, &month, &day);
     gui_data_t data = {
-        .mode            = (display_mode_t)p_epd->config.display_mode,
+        .mode            = epd_display_mode(p_epd),
         .color           = epd->color,
         .width           = epd->width,
         .height          = epd->height,
         .timestamp       = event->timestamp,
         .week_start      = p_epd->config.week_start,
-        .temperature     = epd->drv->read_temp(epd),
-        .voltage         = EPD_ReadVoltage(),
+        .temperature     = temperature,
+        .voltage         = voltage,
+        .battery         = EPD_VoltageLevel(voltage),
+        .holidays        = epd_holiday_get(year),
+        .overlay         = epd_overlay(p_epd),
     };
 
     uint16_t dev_name_len = sizeof(data.ssid);
@@ -52,9 +153,38 @@ static void epd_gui_update(void * p_event_data, uint16_t event_size)
     if (err_code == NRF_SUCCESS && dev_name_len > 0)
         data.ssid[dev_name_len] = '\0';
 
-    DrawGUI(&data, (buffer_callback)epd->drv->write_image, epd);
-    epd->drv->refresh(epd);
+    gui_rect_t rect;
+    int16_t pages = 0;
+    bool full = true;
+    buffer_callback write = (buffer_callback)(epd->drv->write_partial ? epd->drv->write_partial : epd->drv->write_image);
+    if (data.mode == MODE_PICTURE && data.overlay != 0) {
+        // the picture is only in the controller RAM, drawn over there or left alone
+        full = false;
+        GetGUIOverlayRect(&data, &rect);
+        if (epd->drv->read_image != NULL && rect.w > 0 && rect.h > 0) {
+            pages = DrawGUIOverlay(&data, &rect, (buffer_callback)epd->drv->read_image, write, epd);
+            if (epd->drv->partial_refresh == NULL || !epd->drv->partial_refresh(epd, rect.x, rect.y, rect.w, rect.h))
+                epd->drv->refresh(epd);
+        }
+    } else if (epd->drv->partial_refresh != NULL && GetGUIDirtyRect(&p_epd->last_gui, &data, &rect)) {
+        NRF_LOG_DEBUG("[EPD]: dirty rect: %d,%d %dx%d\n", rect.x, rect.y, rect.w, rect.h);
+        full = false;
+        if (rect.w > 0 && rect.h > 0) {
+            pages = DrawGUIPartial(&data, &rect, write, epd);
+            full = !epd->drv->partial_refresh(epd, rect.x, rect.y, rect.w, rect.h); // RAM lost, redraw
+        }
+    }
+    if (full) {
+        pages = DrawGUI(&data, (buffer_callback)epd->drv->write_image, epd);
+        epd->drv->refresh(epd);
+    }
+    NRF_LOG_DEBUG("[EPD]: GUI pages: %d (1: full frame)\n", pages);
+    UNUSED_VARIABLE(pages); // the log is compiled out in release builds
+    epd_temp_update_end(epd, event->timestamp);
+    p_epd->last_gui = data;
     EPD_GPIO_Uninit();
+    epd_energy_update_end(event->timestamp);
+    m_update.busy = false;
 
     app_feed_wdt();
 }
@@ -79,8 +209,16 @@ static void on_disconnect(ble_epd_t * p_epd, ble_evt_t * p_ble_evt)
 {
     UNUSED_PARAMETER(p_ble_evt);
     p_epd->conn_handle = BLE_CONN_HANDLE_INVALID;
-    p_epd->epd->drv->sleep(p_epd->epd);
-    nrf_delay_ms(200); // for sleep
+    if (p_epd->epd != NULL) { // not initialized by the peer (EPD_CMD_INIT)
+        if (epd_display_mode(p_epd) == MODE_PICTURE && epd_overlay(p_epd) != 0 &&
+            p_epd->epd->drv->read_image != NULL) {
+            EPD_GPIO_Uninit(); // left in standby, the overlay is drawn over the picture in its RAM
+            return;
+        }
+        p_epd->epd->drv->sleep(p_epd->epd);
+        epd_sequence_start(NULL, m_sleep_settle, EPD_GPIO_Uninit);
+        return;
+    }
     EPD_GPIO_Uninit();
 }
 
@@ -89,6 +227,7 @@ static void epd_update_display_mode(ble_epd_t * p_epd, display_mode_t mode)
     if (p_epd->config.display_mode != mode) {
         p_epd->config.display_mode = mode;
         epd_config_write(&p_epd->config);
+        clock_reschedule();
     }
 }
 
@@ -99,6 +238,74 @@ static void epd_send_time(ble_epd_t * p_epd)
     ble_epd_string_send(p_epd, (uint8_t *)buf, strlen(buf));
 }
 
+static void epd_send_drift(ble_epd_t * p_epd)
+{
+    char buf[20] = {0};
+    snprintf(buf, sizeof(buf), "drift=%d", epd_config_clock_drift(&p_epd->config));
+    ble_epd_string_send(p_epd, (uint8_t *)buf, strlen(buf));
+}
+
+// Measure the clock drift from the error corrected by a time sync. The error
+// of every sync is added up until the syncs are far enough apart for the 1 s
+// resolution of the synced time, then the drift left after the current
+// correction is added to it.
+static void epd_calibrate_clock(ble_epd_t * p_epd, uint32_t synced)
+{
+    int32_t error = (int32_t)(timestamp() - synced);
+
+    if (p_epd->sync_timestamp == 0 || synced <= p_epd->sync_timestamp) {
+        p_epd->sync_timestamp = synced;
+        p_epd->sync_error = 0;
+        return;
+    }
+
+    p_epd->sync_error += error;
+    uint32_t interval = synced - p_epd->sync_timestamp;
+    if (interval < CLOCK_SYNC_MIN_INTERVAL) return;
+
+    int32_t drift = (int32_t)((int64_t)p_epd->sync_error * 10000000 / interval);
+    NRF_LOG_DEBUG("clock error %d s in %u s\n", p_epd->sync_error, interval);
+    p_epd->sync_timestamp = synced;
+    p_epd->sync_error = 0;
+    if (drift < -CLOCK_DRIFT_MAX || drift > CLOCK_DRIFT_MAX) return;
+
+    drift += epd_config_clock_drift(&p_epd->config);
+    if (drift < -CLOCK_DRIFT_MAX) drift = -CLOCK_DRIFT_MAX;
+    if (drift > CLOCK_DRIFT_MAX) drift = CLOCK_DRIFT_MAX;
+    if (drift != epd_config_clock_drift(&p_epd->config)) {
+        epd_config_set_clock_drift(&p_epd->config, drift);
+        epd_config_write(&p_epd->config);
+    }
+}
+
+// Reply: 0x50, battery status (EPD_battery.h)
+static void epd_send_battery_status(ble_epd_t * p_epd)
+{
+    uint8_t buf[1 + BATTERY_STATUS_SIZE];
+    buf[0] = EPD_CMD_BATTERY_STATUS;
+    epd_battery_status(&buf[1]);
+    ble_epd_string_send(p_epd, buf, sizeof(buf));
+}
+
+// Reply: 0x51, hourly and daily voltage history, truncated to the MTU
+static void epd_send_battery_history(ble_epd_t * p_epd)
+{
+    uint8_t buf[1 + BATTERY_HISTORY_SIZE];
+    buf[0] = EPD_CMD_BATTERY_HISTORY;
+    epd_battery_history(&buf[1]);
+    ble_epd_string_send(p_epd, buf, MIN(sizeof(buf), p_epd->max_data_len));
+}
+
+// Reply: 0x53, day, energy report (EPD_energy.h), truncated to the MTU
+static void epd_send_energy(ble_epd_t * p_epd, uint8_t day)
+{
+    uint8_t buf[2 + ENERGY_REPORT_SIZE];
+    buf[0] = EPD_CMD_ENERGY;
+    buf[1] = day;
+    epd_energy_report_encode(day, timestamp(), &buf[2]);
+    ble_epd_string_send(p_epd, buf, MIN(sizeof(buf), p_epd->max_data_len));
+}
+
 static void epd_send_mtu(ble_epd_t * p_epd)
 {
     char buf[10] = {0};
@@ -106,6 +313,107 @@ static void epd_send_mtu(ble_epd_t * p_epd)
     ble_epd_string_send(p_epd, (uint8_t *)buf, strlen(buf));
 }
 
+// Reply: 0x42, offset (2 bytes, big endian), capture data; no data at the end of the stream
+static void epd_send_capture(ble_epd_t * p_epd, uint16_t offset)
+{
+    uint8_t buf[BLE_EPD_MAX_DATA_LEN];
+    buf[0] = EPD_CMD_CAPTURE_READ;
+    buf[1] = offset >> 8;
+    buf[2] = offset & 0xFF;
+    uint16_t len = EPD_Capture_Read(offset, &buf[3], p_epd->max_data_len - 3);
+    ble_epd_string_send(p_epd, buf, len + 3);
+}
+
+// Reply: 0x93, key/length/value entries that fit in the MTU
+static void epd_send_config(ble_epd_t * p_epd, uint8_t const * keys, uint8_t count)
+{
+    uint8_t buf[BLE_EPD_MAX_DATA_LEN];
+    buf[0] = EPD_CMD_CFG_READ;
+    uint8_t len = epd_config_get(&p_epd->config, keys, count, &buf[1], p_epd->max_data_len - 1);
+    ble_epd_string_send(p_epd, buf, len + 1);
+}
+
+// Find the attached controller, a configured model of another driver is replaced by the first
+// model of the answering one. Nothing is saved if no controller answered (probed again on boot).
+static void epd_probe_panel(ble_epd_t * p_epd, epd_probe_t * probe)
+{
+    EPD_GPIO_Init();
+    bool found = epd_probe((epd_model_id_t)p_epd->config.model_id, probe);
+    EPD_GPIO_Uninit();
+    if (!found) return;
+
+    p_epd->config.panel_family = probe->family;
+    if (probe->model != p_epd->config.model_id) {
+        NRF_LOG_INFO("model %d replaced by %d\n", p_epd->config.model_id, probe->model);
+        p_epd->config.model_id = probe->model;
+        epd_model_select(p_epd->config.model_id);
+    }
+    epd_config_write(&p_epd->config);
+}
+
+// Reply: 0x08, controller family (0: none), model id, ID bytes read by the probe
+static void epd_send_probe(ble_epd_t * p_epd)
+{
+    epd_probe_t probe;
+    uint8_t buf[3 + EPD_PROBE_ID_SIZE];
+
+    epd_probe_panel(p_epd, &probe);
+    p_epd->epd = NULL; // registers are reset, EPD_CMD_INIT again
+    buf[0] = EPD_CMD_PROBE;
+    buf[1] = probe.family;
+    buf[2] = probe.model;
+    memcpy(&buf[3], probe.id, probe.len);
+    ble_epd_string_send(p_epd, buf, 3 + probe.len);
+}
+
+// Screen or controller RAM may be changed by the peer, do a full redraw on next update
+static void epd_invalidate_gui(ble_epd_t * p_epd)
+{
+    p_epd->last_gui.mode = MODE_PICTURE;
+}
+
+// Apply key/length/value config entries, all or none of them
+static epd_config_status_t epd_apply_config(ble_epd_t * p_epd, uint8_t const * tlv, uint16_t len)
+{
+    epd_config_t config = p_epd->config;
+    epd_config_status_t status = epd_config_set(&config, tlv, len);
+
+    if (status == EPD_CFG_OK && memcmp(&config, &p_epd->config, sizeof(epd_config_t)) != 0) {
+        // mosi_pin .. bs_pin, en_pin
+        bool pins = memcmp(&config, &p_epd->config, offsetof(epd_config_t, model_id)) != 0 ||
+                    config.en_pin != p_epd->config.en_pin;
+        bool model = config.model_id != p_epd->config.model_id;
+        p_epd->config = config;
+        epd_config_write(&p_epd->config);
+        if (model || pins) epd_invalidate_gui(p_epd);
+        if (model) epd_model_select(p_epd->config.model_id);
+        if (pins) {
+            EPD_GPIO_Uninit();
+            EPD_GPIO_Load(&p_epd->config);
+            EPD_GPIO_Init();
+        }
+        clock_reschedule();
+    }
+    return status;
+}
+
+// Reply: 0x94, status (epd_config_status_t)
+static void epd_write_config(ble_epd_t * p_epd, uint8_t const * tlv, uint16_t len)
+{
+    uint8_t reply[2] = { EPD_CMD_CFG_WRITE, epd_apply_config(p_epd, tlv, len) };
+    ble_epd_string_send(p_epd, reply, sizeof(reply));
+}
+
+// Called once the pending config change is in flash
+static void system_reset(void)
+{
+#if defined(S112)
+    nrf_pwr_mgmt_shutdown(NRF_PWR_MGMT_SHUTDOWN_RESET);
+#else
+    NVIC_SystemReset();
+#endif
+}
+
 static void epd_service_on_write(ble_epd_t * p_epd, uint8_t * p_data, uint16_t length)
 {
     NRF_LOG_DEBUG("[EPD]: on_write LEN=%d\n", length);
@@ -115,6 +423,7 @@ static void epd_service_on_write(ble_epd_t * p_epd, uint8_t * p_data, uint16_t l
     switch (p_data[0])
     {
       case EPD_CMD_SET_PINS:
+          epd_invalidate_gui(p_epd);
           if (length < 8) return;
 
           p_epd->config.mosi_pin = p_data[1];
@@ -134,6 +443,8 @@ static void epd_service_on_write(ble_epd_t * p_epd, uint8_t * p_data, uint16_t l
           break;
 
       case EPD_CMD_INIT:
+          epd_invalidate_gui(p_epd);
+          epd_model_select(length > 1 ? p_data[1] : p_epd->config.model_id);
           p_epd->epd = epd_init((epd_model_id_t)(length > 1 ? p_data[1] : p_epd->config.model_id));
           if (p_epd->epd->id != p_epd->config.model_id) {
               p_epd->config.model_id = p_epd->epd->id;
@@ -141,39 +452,64 @@ static void epd_service_on_write(ble_epd_t * p_epd, uint8_t * p_data, uint16_t l
           }
           epd_send_mtu(p_epd);
           epd_send_time(p_epd);
+          epd_send_drift(p_epd);
           break;
 
       case EPD_CMD_CLEAR:
+          epd_invalidate_gui(p_epd);
+          if (p_epd->epd == NULL) return;
           epd_update_display_mode(p_epd, MODE_PICTURE);
           p_epd->epd->drv->clear(p_epd->epd, length > 1 ? p_data[1] : true);
           break;
 
       case EPD_CMD_SEND_COMMAND:
+          epd_invalidate_gui(p_epd);
           if (length < 2) return;
           EPD_WriteCmd(p_data[1]);
           break;
 
       case EPD_CMD_SEND_DATA:
+          epd_invalidate_gui(p_epd);
           EPD_WriteData(&p_data[1], length - 1);
           break;
 
       case EPD_CMD_REFRESH:
+          epd_invalidate_gui(p_epd);
+          if (p_epd->epd == NULL) return;
           epd_update_display_mode(p_epd, MODE_PICTURE);
           p_epd->epd->drv->refresh(p_epd->epd);
           break;
 
       case EPD_CMD_SLEEP:
+          epd_invalidate_gui(p_epd);
+          if (p_epd->epd == NULL) return;
           p_epd->epd->drv->sleep(p_epd->epd);
           break;
 
+      case EPD_CMD_SET_MODEL: {
+          epd_invalidate_gui(p_epd);
+          if (length < 3) return;
+          uint8_t reply[2] = { EPD_CMD_SET_MODEL };
+          reply[1] = epd_model_upload(p_data[1], p_data[2], &p_data[3], length - 3, p_epd->config.model_id);
+          ble_epd_string_send(p_epd, reply, sizeof(reply));
+      } break;
+
+      case EPD_CMD_PROBE:
+          epd_invalidate_gui(p_epd);
+          epd_send_probe(p_epd);
+          break;
+
       case EPD_CMD_SET_TIME: {
           if (length < 5) return;
 
           NRF_LOG_DEBUG("time: %02x %02x %02x %02x\n", p_data[1], p_data[2], p_data[3], p_data[4]);
           if (length > 5) NRF_LOG_DEBUG("timezone: %d\n", (int8_t)p_data[5]);
 
-          uint32_t timestamp = (p_data[1] << 24) | (p_data[2] << 16) | (p_data[3] << 8) | p_data[4];
+          uint32_t now = timestamp();
+          uint32_t timestamp = ((uint32_t)p_data[1] << 24) | ((uint32_t)p_data[2] << 16) | (p_data[3] << 8) | p_data[4];
           timestamp += (length > 5 ? (int8_t)p_data[5] : 8) * 60 * 60; // timezone
+          epd_calibrate_clock(p_epd, timestamp);
+          epd_energy_set_time(now, timestamp);
           set_timestamp(timestamp);
           epd_update_display_mode(p_epd, length > 6 ? (display_mode_t)p_data[6] : MODE_CALENDAR);
           ble_epd_on_timer(p_epd, timestamp, true);
@@ -187,27 +523,78 @@ static void epd_service_on_write(ble_epd_t * p_epd, uint8_t * p_data, uint16_t l
           }
           break;
 
+      case EPD_CMD_SET_HOLIDAY: {
+          if (length < 4) return;
+          uint8_t reply[2] = { EPD_CMD_SET_HOLIDAY };
+          reply[1] = epd_holiday_upload((p_data[1] << 8) | p_data[2], p_data[3], &p_data[4], length - 4);
+          ble_epd_string_send(p_epd, reply, sizeof(reply));
+      } break;
+
+      case EPD_CMD_GET_CLOCK:
+          epd_send_time(p_epd);
+          epd_send_drift(p_epd);
+          break;
+
       case EPD_CMD_WRITE_IMAGE: // MSB=0000: ram begin, LSB=1111: black
-          if (length < 3) return;
+          epd_invalidate_gui(p_epd);
+          if (length < 3 || p_epd->epd == NULL) return;
           p_epd->epd->drv->write_ram(p_epd->epd, p_data[1], &p_data[2], length - 2);
           break;
 
-      case EPD_CMD_SET_CONFIG:
-          if (length < 2) return;
-          memcpy(&p_epd->config, &p_data[1], (length - 1 > EPD_CONFIG_SIZE) ? EPD_CONFIG_SIZE : length - 1);
+      case EPD_CMD_CAPTURE_START:
+          EPD_Capture_Start();
+          break;
+
+      case EPD_CMD_CAPTURE_STOP:
+          EPD_Capture_Stop();
+          break;
+
+      case EPD_CMD_CAPTURE_READ:
+          if (length < 3) return;
+          epd_send_capture(p_epd, (p_data[1] << 8) | p_data[2]);
+          break;
+
+      case EPD_CMD_BATTERY_STATUS:
+          epd_send_battery_status(p_epd);
+          break;
+
+      case EPD_CMD_BATTERY_HISTORY:
+          epd_send_battery_history(p_epd);
+          break;
+
+      case EPD_CMD_BATTERY_POLICY:
+          if (length < 5) return;
+          p_epd->config.battery_policy = p_data[1];
+          p_epd->config.battery_low = p_data[2];
+          p_epd->config.battery_critical = p_data[3];
+          p_epd->config.battery_empty = p_data[4];
           epd_config_write(&p_epd->config);
           break;
 
+      case EPD_CMD_ENERGY:
+          epd_send_energy(p_epd, length > 1 ? p_data[1] : 0);
+          break;
+
+      case EPD_CMD_SET_CONFIG: {
+          if (length < 2) return;
+          uint8_t tlv[3 * EPD_CONFIG_LEGACY_SIZE];
+          epd_apply_config(p_epd, tlv, epd_config_legacy_tlv(&p_data[1], length - 1, tlv));
+      } break;
+
+      case EPD_CMD_CFG_READ:
+          epd_send_config(p_epd, &p_data[1], length - 1);
+          break;
+
+      case EPD_CMD_CFG_WRITE:
+          epd_write_config(p_epd, &p_data[1], length - 1);
+          break;
+
       case EPD_CMD_SYS_SLEEP:
           sleep_mode_enter();
           break;
 
         case EPD_CMD_SYS_RESET:
-#if defined(S112)
-            nrf_pwr_mgmt_shutdown(NRF_PWR_MGMT_SHUTDOWN_RESET);
-#else
-            NVIC_SystemReset();
-#endif
+            epd_config_flush(system_reset);
         break;
 
       case EPD_CMD_CFG_ERASE:
@@ -240,11 +627,12 @@ static void on_write(ble_epd_t * p_epd, ble_evt_t * p_ble_evt)
         {
             NRF_LOG_DEBUG("notification enabled\n");
             p_epd->is_notification_enabled = true;
-            static uint16_t length = sizeof(epd_config_t);
+            uint8_t legacy[EPD_CONFIG_LEGACY_SIZE]; // newer fields are read with EPD_CMD_CFG_READ
+            epd_config_legacy_get(&p_epd->config, legacy);
             NRF_LOG_DEBUG("send epd config\n");
-            uint32_t err_code = ble_epd_string_send(p_epd, (uint8_t *)&p_epd->config, length);
-            if (err_code != NRF_ERROR_INVALID_STATE)
-                APP_ERROR_CHECK(err_code);
+            uint32_t err_code = ble_epd_string_send(p_epd, legacy, MIN(sizeof(legacy), p_epd->max_data_len));
+            if (err_code != NRF_SUCCESS && err_code != NRF_ERROR_INVALID_STATE)
+                NRF_LOG_ERROR("send epd config failed, code=%d\n", err_code);
         }
         else
         {
@@ -345,6 +733,8 @@ void ble_epd_sleep_prepare(ble_epd_t * p_epd)
 {
     // Turn off led
     EPD_LED_OFF();
+    // Do not keep the controller in standby through system off
+    EPD_GPIO_Release();
     // Prepare wakeup pin
     if (p_epd->config.wakeup_pin != 0xFF)
     {
@@ -362,6 +752,8 @@ uint32_t ble_epd_init(ble_epd_t * p_epd)
     p_epd->is_notification_enabled = false;
 
     epd_config_init(&p_epd->config);
+    epd_holiday_init();
+    epd_model_init();
     epd_config_read(&p_epd->config);
 
     // write default config
@@ -385,9 +777,20 @@ uint32_t ble_epd_init(ble_epd_t * p_epd)
             p_epd->config.week_start = 0;
         epd_config_write(&p_epd->config);
     }
+    if (epd_config_clock_drift(&p_epd->config) == EPD_CLOCK_DRIFT_UNSET)
+        epd_config_set_clock_drift(&p_epd->config, 0);
+    epd_battery_init(&p_epd->config);
+    epd_temp_init(&p_epd->config);
+    epd_model_select(p_epd->config.model_id);
+    EPD_VoltageInit();
+    epd_energy_init(ENERGY_CHIP_DEFAULT, timestamp());
 
     // load config
     EPD_GPIO_Load(&p_epd->config);
+    if (p_epd->config.panel_family == EPD_PANEL_FAMILY_UNSET) {
+        epd_probe_t probe;
+        epd_probe_panel(p_epd, &probe);
+    }
 
     // blink LED on start
     EPD_LED_BLINK();
@@ -417,11 +820,28 @@ uint32_t ble_epd_string_send(ble_epd_t * p_epd, uint8_t * p_string, uint16_t len
 
 void ble_epd_on_timer(ble_epd_t * p_epd, uint32_t timestamp, bool force_update)
 {
-    // Update calendar on 00:00:00, clock on every minute
+    display_mode_t mode = epd_update_mode(p_epd);
+
+    // Update calendar on 00:00:00, clock on every minute (5 minutes on low battery)
     if (force_update || 
-        (p_epd->config.display_mode == MODE_CALENDAR && timestamp % 86400 == 0) ||
-        (p_epd->config.display_mode == MODE_CLOCK && timestamp % 60 == 0)) {
+        (mode == MODE_CALENDAR && timestamp % 86400 == 0) ||
+        (mode == MODE_CLOCK && timestamp % epd_clock_interval() == 0)) {
         epd_gui_update_event_t event = { p_epd, timestamp };
         app_sched_event_put(&event, sizeof(epd_gui_update_event_t), epd_gui_update);
     }
 }
+
+uint32_t ble_epd_next_update(ble_epd_t * p_epd, uint32_t timestamp)
+{
+    uint32_t interval;
+
+    switch (epd_update_mode(p_epd)) {
+        case MODE_CALENDAR:
+            return timestamp - timestamp % 86400 + 86400;
+        case MODE_CLOCK:
+            interval = epd_clock_interval();
+            return timestamp - timestamp % interval + interval;
+        default:
+            return 0;
+    }
+}
@@ -69,15 +69,30 @@ enum EPD_CMDS
     EPD_CMD_SEND_DATA      = 0x04,                        /**< send data to EPD */
     EPD_CMD_REFRESH        = 0x05,                        /**< diaplay EPD ram on screen */
     EPD_CMD_SLEEP          = 0x06,                        /**< EPD enter sleep mode */
+    EPD_CMD_SET_MODEL      = 0x07,                        /**< upload a panel model: slot, offset, record part (EPD_model.h) */
+    EPD_CMD_PROBE          = 0x08,                        /**< detect the controller, reply: controller family, model id, ID bytes */
 
 	EPD_CMD_SET_TIME       = 0x20,                        /** < set time with unix timestamp */
     EPD_CMD_SET_WEEK_START = 0x21,                        /** < set week start day (0: Sunday, 1: Monday, ...) */
+    EPD_CMD_GET_CLOCK      = 0x22,                        /** < get time and measured clock drift */
+    EPD_CMD_SET_HOLIDAY    = 0x23,                        /** < set holidays of a year: year (2 bytes), offset, bitmap part (EPD_holiday.h) */
 
     EPD_CMD_WRITE_IMAGE    = 0x30,                        /** < write image data to EPD ram */
 
-    EPD_CMD_SET_CONFIG     = 0x90,                        /**< set full EPD config */
+    EPD_CMD_CAPTURE_START  = 0x40,                        /**< start capturing SPI transactions (clears the capture buffer) */
+    EPD_CMD_CAPTURE_STOP   = 0x41,                        /**< stop capturing SPI transactions */
+    EPD_CMD_CAPTURE_READ   = 0x42,                        /**< read the capture stream from offset (2 bytes, big endian) */
+
+    EPD_CMD_BATTERY_STATUS  = 0x50,                       /**< get battery state, capacity and days left (EPD_battery.h) */
+    EPD_CMD_BATTERY_HISTORY = 0x51,                       /**< get hourly and daily battery voltage history */
+    EPD_CMD_BATTERY_POLICY  = 0x52,                       /**< set battery policy and low/critical/empty thresholds (4 bytes) */
+    EPD_CMD_ENERGY          = 0x53,                       /**< get the energy report of a day (0: today, 1: yesterday, EPD_energy.h) */
+
+    EPD_CMD_SET_CONFIG     = 0x90,                        /**< set the legacy config fields, mosi_pin .. week_start (EPD_config.h) */
     EPD_CMD_SYS_RESET      = 0x91,                        /**< MCU reset */
     EPD_CMD_SYS_SLEEP      = 0x92,                        /**< MCU enter sleep mode */
+    EPD_CMD_CFG_READ       = 0x93,                        /**< read config entries by key (none: all), reply key/length/value entries */
+    EPD_CMD_CFG_WRITE      = 0x94,                        /**< write key/length/value config entries, all or none (EPD_config.h) */
     EPD_CMD_CFG_ERASE      = 0x99,                        /**< Erase config and reset */
 };
 
@@ -95,6 +110,9 @@ typedef struct
     bool                     is_notification_enabled; /**< Variable to indicate if the peer has enabled notification of the RX characteristic.*/
     epd_model_t              *epd;                    /**< current EPD model */
     epd_config_t             config;                  /**< EPD config */
+    gui_data_t               last_gui;                /**< GUI state of the frame on screen, used for partial updates */
+    uint32_t                 sync_timestamp;          /**< Time of the first sync of the drift measurement, 0 if none since boot */
+    int32_t                  sync_error;              /**< Clock error (seconds) corrected by the syncs since sync_timestamp */
 } ble_epd_t;
 
 typedef struct
@@ -149,6 +167,16 @@ uint32_t ble_epd_string_send(ble_epd_t * p_epd, uint8_t * p_string, uint16_t len
 
 void ble_epd_on_timer(ble_epd_t * p_epd, uint32_t timestamp, bool force_update);
 
+/**@brief Function for getting the time of the next display update.
+ *
+ * @param[in] p_epd       Pointer to the EPD Service structure.
+ * @param[in] timestamp   Current timestamp.
+ *
+ * @return    First timestamp after @p timestamp on which @ref ble_epd_on_timer updates the
+ *            display, 0 if the display mode has no periodic update.
+ */
+uint32_t ble_epd_next_update(ble_epd_t * p_epd, uint32_t timestamp);
+
 #endif // EPD_BLE_H__
 
 /** @} */
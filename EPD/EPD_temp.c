@@ -0,0 +1,48 @@
+#include "EPD_temp.h"
+#include "nrf_log.h"
+
+static struct {
+    epd_config_t *cfg;
+    bool valid;          // a panel reading was taken
+    int8_t panel;        // last panel reading
+    int8_t offset;       // panel minus MCU die temperature at that reading
+    uint32_t timestamp;  // of the panel reading
+} m_temp;
+
+static uint8_t temp_ttl(void)
+{
+    return m_temp.cfg->temp_ttl != TEMP_TTL_UNSET ? m_temp.cfg->temp_ttl : TEMP_TTL_DEFAULT;
+}
+
+static bool temp_fresh(uint32_t timestamp)
+{
+    return m_temp.valid && timestamp - m_temp.timestamp < (uint32_t)temp_ttl() * 60;
+}
+
+void epd_temp_init(epd_config_t *cfg)
+{
+    m_temp.cfg = cfg;
+    m_temp.valid = false;
+    m_temp.offset = 0;
+}
+
+int8_t epd_temp_update_begin(epd_model_t *epd, uint32_t timestamp)
+{
+    int8_t temp = temp_fresh(timestamp) ? m_temp.panel : EPD_ReadDieTemp() + m_temp.offset;
+
+    if (epd->drv->set_temp != NULL)
+        epd->drv->set_temp(epd, temp);
+    return temp;
+}
+
+void epd_temp_update_end(epd_model_t *epd, uint32_t timestamp)
+{
+    if (temp_ttl() == 0 || temp_fresh(timestamp)) return;
+
+    // the panel is idle after the refresh, the sensor wait does not delay the display
+    m_temp.panel = epd->drv->read_temp(epd);
+    m_temp.offset = m_temp.panel - EPD_ReadDieTemp();
+    m_temp.timestamp = timestamp;
+    m_temp.valid = true;
+    NRF_LOG_DEBUG("[EPD]: panel temperature %d, die offset %d\n", m_temp.panel, m_temp.offset);
+}
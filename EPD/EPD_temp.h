@@ -0,0 +1,20 @@
+#ifndef __EPD_TEMP_H
+#define __EPD_TEMP_H
+
+#include <stdint.h>
+#include "EPD_config.h"
+#include "EPD_driver.h"
+
+// Minutes a panel sensor reading is used while the config has none (0xFF), 0: MCU sensor only
+#define TEMP_TTL_DEFAULT 30
+#define TEMP_TTL_UNSET   0xFF
+
+// cfg holds the TTL (temp_ttl)
+void epd_temp_init(epd_config_t *cfg);
+// Temperature of an update, after epd_init(): the panel reading while it is fresh, else the MCU
+// die sensor with the offset seen at the last panel reading. Also selects the waveform (set_temp).
+int8_t epd_temp_update_begin(epd_model_t *epd, uint32_t timestamp);
+// After the refresh: reads the panel sensor again once the last reading is older than the TTL
+void epd_temp_update_end(epd_model_t *epd, uint32_t timestamp);
+
+#endif
@@ -1,6 +1,12 @@
 #include "EPD_driver.h"
 #include "nrf_log.h"
 
+static bool m_temp_written = false; // temperature register set by SSD16xx_Set_Temp since init
+static bool m_ram_image = false;    // RAM holds the image on the glass, also RAM2 on BW panels (display mode 2)
+static bool m_ram2_stale = false;   // BW: RAM1 uploaded without RAM2 (write_ram), copied by the next refresh
+
+#define SSD16xx_COPY_SIZE 128 // bytes of RAM copied at once (stack)
+
 static void SSD16xx_WaitBusy(uint16_t timeout)
 {
     EPD_WaitBusy(HIGH, timeout);
@@ -20,6 +26,13 @@ int8_t SSD16xx_Read_Temp(epd_model_t *epd)
     return (int8_t)EPD_ReadByte();
 }
 
+// Waveform temperature of the next refresh, replaces the sensor reading
+void SSD16xx_Set_Temp(epd_model_t *epd, int8_t temp)
+{
+    EPD_Write(SSD16xx_TSENSOR_WRITE, (uint8_t)temp, 0x00);
+    m_temp_written = true;
+}
+
 static void _setPartialRamArea(epd_model_t *epd, uint16_t x, uint16_t y, uint16_t w, uint16_t h)
 {
     EPD_Write(SSD16xx_ENTRY_MODE, 0x03); // set ram entry mode: x increase, y increase
@@ -44,6 +57,37 @@ static void _setPartialRamArea(epd_model_t *epd, uint16_t x, uint16_t y, uint16_
     EPD_Write(SSD16xx_RAM_YCOUNT, y % 256, y / 256);
 }
 
+// Read a byte aligned window of RAM1 (0x00) or RAM2 (0x01), rows of (w + 7) / 8 bytes
+static void _readRam(epd_model_t *epd, uint8_t ram, uint8_t *data, uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    uint32_t len = (uint32_t)((w + 7) / 8) * h;
+
+    _setPartialRamArea(epd, x, y, w, h);
+    EPD_Write(SSD16xx_RAM_READ_CTRL, ram);
+    EPD_WriteCmd(SSD16xx_READ_RAM);
+    EPD_ReadByte(); // dummy
+    for (uint32_t i = 0; i < len; i += 255)
+        EPD_ReadData(&data[i], len - i > 255 ? 255 : len - i);
+}
+
+// Copy a window of RAM1 to RAM2, the previous image of the next display mode 2 update
+static void _copyRam(epd_model_t *epd, uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    uint8_t buf[SSD16xx_COPY_SIZE];
+
+    for (uint16_t xs = 0; xs < w; xs += SSD16xx_COPY_SIZE * 8) {
+        uint16_t cw = w - xs > SSD16xx_COPY_SIZE * 8 ? SSD16xx_COPY_SIZE * 8 : w - xs;
+        uint16_t rows = SSD16xx_COPY_SIZE / ((cw + 7) / 8);
+        for (uint16_t ys = 0; ys < h; ys += rows) {
+            uint16_t ch = h - ys > rows ? rows : h - ys;
+            _readRam(epd, 0x00, buf, x + xs, y + ys, cw, ch);
+            _setPartialRamArea(epd, x + xs, y + ys, cw, ch);
+            EPD_WriteCmd(SSD16xx_WRITE_RAM2);
+            EPD_WriteData(buf, (cw + 7) / 8 * ch);
+        }
+    }
+}
+
 void SSD16xx_Dump_LUT(void)
 {
     uint8_t lut[128];
@@ -56,26 +100,35 @@ void SSD16xx_Dump_LUT(void)
     NRF_LOG_DEBUG("=== LUT END ===\n");
 }
 
+static const uint8_t ssd16xx_init[] = {
+    EPD_SEQ_RESET(10),
+    EPD_SEQ_CMD(SSD16xx_SW_RESET, 0),
+    EPD_SEQ_BUSY(HIGH, 200),
+    EPD_SEQ_CMD(SSD16xx_BORDER_CTRL, 1), 0x01,
+    EPD_SEQ_CMD(SSD16xx_TSENSOR_CTRL, 1), 0x80,
+    EPD_SEQ_END,
+};
+
+// RAM window of the model, after ssd16xx_init. The RAM survives the deep sleep and the resets,
+// not a power cut.
 void SSD16xx_Init(epd_model_t *epd)
 {
-    EPD_Reset(HIGH, 10);
-
-    EPD_WriteCmd(SSD16xx_SW_RESET);
-    SSD16xx_WaitBusy(200);
-
-    EPD_Write(SSD16xx_BORDER_CTRL, 0x01);
-    EPD_Write(SSD16xx_TSENSOR_CTRL, 0x80);
+    m_temp_written = false;
+    if (EPD_State() == EPD_STATE_OFF) m_ram_image = m_ram2_stale = false;
 
     _setPartialRamArea(epd, 0, 0, epd->width, epd->height);
 }
 
 static void SSD16xx_Refresh(epd_model_t *epd)
 {
+    if (m_ram2_stale) // RAM2 is bypassed (0x40), keep the image for display mode 2 there
+        _copyRam(epd, 0, 0, epd->width, epd->height);
+    m_ram2_stale = false;
+    m_ram_image = true;
     EPD_Write(SSD16xx_DISP_CTRL1, epd->color == BWR ? 0x80 : 0x40, 0x00);
 
     NRF_LOG_DEBUG("[EPD]: refresh begin\n");
-    NRF_LOG_DEBUG("[EPD]: temperature: %d\n", SSD16xx_Read_Temp(epd));
-    SSD16xx_Update(0xF7);
+    SSD16xx_Update(m_temp_written ? 0xD7 : 0xF7); // 0xD7: LUT for the written temperature
     SSD16xx_WaitBusy(30000);
     NRF_LOG_DEBUG("[EPD]: refresh end\n");
 
@@ -85,6 +138,29 @@ static void SSD16xx_Refresh(epd_model_t *epd)
     SSD16xx_Update(0x83);                              // power off
 }
 
+// The whole panel is refreshed from RAM: display mode 2 on BW panels drives only the pixels that
+// differ from the previous image in RAM2, without flashing, BWR panels get a full refresh. The
+// window written by SSD16xx_Write_Partial is copied to RAM2 afterwards.
+static bool SSD16xx_Partial_Refresh(epd_model_t *epd, uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    if (!m_ram_image || m_ram2_stale) return false; // power cut or upload since the last refresh
+    if (epd->color == BWR) {
+        SSD16xx_Refresh(epd);
+        return true;
+    }
+    EPD_Write(SSD16xx_DISP_CTRL1, 0x00, 0x00);
+
+    NRF_LOG_DEBUG("[EPD]: partial refresh begin\n");
+    SSD16xx_Update(m_temp_written ? 0xDF : 0xFF); // | 0x08: display mode 2
+    SSD16xx_WaitBusy(30000);
+    NRF_LOG_DEBUG("[EPD]: partial refresh end\n");
+
+    _copyRam(epd, x, y, w, h);
+    _setPartialRamArea(epd, 0, 0, epd->width, epd->height);
+    SSD16xx_Update(0x83);                              // power off
+    return true;
+}
+
 void SSD16xx_Clear(epd_model_t *epd, bool refresh)
 {
     uint32_t ram_bytes = ((epd->width + 7) / 8) * epd->height;
@@ -93,12 +169,17 @@ void SSD16xx_Clear(epd_model_t *epd, bool refresh)
 
     EPD_FillRAM(SSD16xx_WRITE_RAM1, 0xFF, ram_bytes);
     EPD_FillRAM(SSD16xx_WRITE_RAM2, 0xFF, ram_bytes);
+    m_ram_image = false;
+    m_ram2_stale = false;
 
     if (refresh)
         SSD16xx_Refresh(epd);
 }
 
-void SSD16xx_Write_Image(epd_model_t *epd, uint8_t *black, uint8_t *color, uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+// RAM1 gets black, RAM2 gets color on BWR panels. On BW panels RAM2 gets black too (it is bypassed
+// by the full refresh), unless keep is set: there it holds the previous image of display mode 2.
+static void _writeImage(epd_model_t *epd, uint8_t *black, uint8_t *color, uint16_t x, uint16_t y, uint16_t w, uint16_t h,
+                        bool keep)
 {
     uint16_t wb = (w + 7) / 8; // width bytes, bitmaps are padded
     x -= x % 8;                // byte boundary
@@ -113,6 +194,7 @@ void SSD16xx_Write_Image(epd_model_t *epd, uint8_t *black, uint8_t *color, uint1
         for (uint16_t j = 0; j < w / 8; j++)
             EPD_WriteByte(black ? black[j + i * wb] : 0xFF);
     }
+    if (epd->color != BWR && keep) return;
     EPD_WriteCmd(SSD16xx_WRITE_RAM2);
     for (uint16_t i = 0; i < h; i++)
     {
@@ -121,50 +203,121 @@ void SSD16xx_Write_Image(epd_model_t *epd, uint8_t *black, uint8_t *color, uint1
             if (epd->color == BWR)
                 EPD_WriteByte(color ? color[j + i * wb] : 0xFF);
             else
-                EPD_WriteByte(black[j + i * wb]);
+                EPD_WriteByte(black ? black[j + i * wb] : 0xFF);
         }
     }
 }
 
+void SSD16xx_Write_Image(epd_model_t *epd, uint8_t *black, uint8_t *color, uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    _writeImage(epd, black, color, x, y, w, h, false);
+}
+
+// Window of the next SSD16xx_Partial_Refresh, RAM2 keeps the image on the glass
+void SSD16xx_Write_Partial(epd_model_t *epd, uint8_t *black, uint8_t *color, uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    _writeImage(epd, black, color, x, y, w, h, true);
+}
+
+// Window written by SSD16xx_Write_Image, RAM1 to black and RAM2 to color (BWR)
+void SSD16xx_Read_Image(epd_model_t *epd, uint8_t *black, uint8_t *color, uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    uint16_t wb = (w + 7) / 8; // width bytes, bitmaps are padded
+    x -= x % 8;                // byte boundary
+    w = wb * 8;                // byte boundary
+    if (x + w > epd->width || y + h > epd->height)
+        return;
+
+    _readRam(epd, 0x00, black, x, y, w, h);
+    if (epd->color == BWR && color != NULL)
+        _readRam(epd, 0x01, color, x, y, w, h);
+}
+
 void SSD16xx_Write_Ram(epd_model_t *epd, uint8_t cfg, uint8_t *data, uint8_t len)
 {
     bool begin = (cfg >> 4) == 0x00;
     bool black = (cfg & 0x0F) == 0x0F;
     if (begin) {
-        if (epd->color == BWR)
+        if (epd->color == BWR) {
             EPD_WriteCmd(black ? SSD16xx_WRITE_RAM1 : SSD16xx_WRITE_RAM2);
-        else
+        } else {
             EPD_WriteCmd(SSD16xx_WRITE_RAM1);
+            m_ram2_stale = true;
+        }
     }
     EPD_WriteData(data, len);
 }
 
+// Registers and the RAM window are kept after the power off (0x83) of the refresh
+void SSD16xx_Wake(epd_model_t *epd)
+{
+}
+
+static const uint8_t ssd16xx_sleep[] = {
+    EPD_SEQ_CMD(SSD16xx_SLEEP_MODE, 1), 0x01,
+    EPD_SEQ_DELAY(100),
+    EPD_SEQ_END,
+};
+
 void SSD16xx_Sleep(epd_model_t *epd)
 {
-    EPD_Write(SSD16xx_SLEEP_MODE, 0x01);
-    delay(100);
+    epd_sequence_start(epd, ssd16xx_sleep, NULL);
+    EPD_SetState(EPD_STATE_DEEP_SLEEP);
+}
+
+// Idle SSD16xx keep BUSY low and drive it high during the software reset. Called after
+// UC81xx_Probe, so a UC81xx still busy from its reset does not get 0x12 (its refresh).
+uint8_t SSD16xx_Probe(uint8_t *id)
+{
+    if (EPD_BusyPin() != LOW) return 0;
+    EPD_WriteCmd(SSD16xx_SW_RESET);
+    if (EPD_BusyPin() != HIGH) return 0;
+    SSD16xx_WaitBusy(200);
+    if (EPD_BusyPin() != LOW) return 0;
+    EPD_WriteCmd(SSD16xx_READ_STATUS);
+    id[0] = EPD_ReadByte();
+    if (id[0] == 0xFF || (id[0] & 0x04)) return 0; // no answer, or the busy flag is still set
+    EPD_WriteCmd(SSD16xx_READ_USER_ID);
+    EPD_ReadData(&id[1], 10);
+    return 11;
 }
 
 static epd_driver_t epd_drv_ssd1619 = {
     .ic = EPD_DRIVER_IC_SSD1619,
+    .family = EPD_DRIVER_FAMILY_SSD16XX,
+    .init_seq = ssd16xx_init,
     .init = SSD16xx_Init,
     .clear = SSD16xx_Clear,
     .write_image = SSD16xx_Write_Image,
+    .write_partial = SSD16xx_Write_Partial,
     .write_ram = SSD16xx_Write_Ram,
+    .read_image = SSD16xx_Read_Image,
     .refresh = SSD16xx_Refresh,
+    .partial_refresh = SSD16xx_Partial_Refresh,
     .sleep = SSD16xx_Sleep,
     .read_temp = SSD16xx_Read_Temp,
+    .set_temp = SSD16xx_Set_Temp,
+    .wake = SSD16xx_Wake,
+    .probe = SSD16xx_Probe,
 };
 
 static epd_driver_t epd_drv_ssd1677 = {
     .ic = EPD_DRIVER_IC_SSD1677,
+    .family = EPD_DRIVER_FAMILY_SSD16XX,
+    .init_seq = ssd16xx_init,
     .init = SSD16xx_Init,
     .clear = SSD16xx_Clear,
     .write_image = SSD16xx_Write_Image,
+    .write_partial = SSD16xx_Write_Partial,
     .write_ram = SSD16xx_Write_Ram,
+    .read_image = SSD16xx_Read_Image,
     .refresh = SSD16xx_Refresh,
+    .partial_refresh = SSD16xx_Partial_Refresh,
     .sleep = SSD16xx_Sleep,
     .read_temp = SSD16xx_Read_Temp,
+    .set_temp = SSD16xx_Set_Temp,
+    .wake = SSD16xx_Wake,
+    .probe = SSD16xx_Probe,
 };
 
 // SSD1619 400x300 Black/White/Red
@@ -26,6 +26,13 @@ int8_t UC81xx_Read_Temp(epd_model_t *epd)
     return (int8_t)EPD_ReadByte();
 }
 
+// Force the waveform temperature (TSFIX), the internal sensor is not read on refresh
+void UC81xx_Set_Temp(epd_model_t *epd, int8_t temp)
+{
+    EPD_Write(UC81xx_CCSET, 0x02);
+    EPD_Write(UC81xx_TSSET, (uint8_t)temp);
+}
+
 static void _setPartialRamArea(epd_model_t *epd, uint16_t x, uint16_t y, uint16_t w, uint16_t h)
 {
     if (epd->drv->ic == EPD_DRIVER_IC_JD79668 || epd->drv->ic == EPD_DRIVER_IC_JD79665) {
@@ -63,6 +70,25 @@ void UC81xx_Refresh(epd_model_t *epd)
     NRF_LOG_DEBUG("[EPD]: refresh end\n");
 }
 
+// Only the window is refreshed, the rest of RAM does not matter
+bool UC81xx_Partial_Refresh(epd_model_t *epd, uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    NRF_LOG_DEBUG("[EPD]: partial refresh begin\n");
+    UC81xx_PowerOn();
+
+    EPD_WriteCmd(UC81xx_PTIN); // partial in
+    _setPartialRamArea(epd, x, y, w, h);
+
+    EPD_WriteCmd(UC81xx_DRF);
+    delay(100);
+    UC81xx_WaitBusy(30000);
+
+    EPD_WriteCmd(UC81xx_PTOUT); // partial out
+    UC81xx_PowerOff();
+    NRF_LOG_DEBUG("[EPD]: partial refresh end\n");
+    return true;
+}
+
 void JD79668_Refresh(epd_model_t *epd)
 {
     NRF_LOG_DEBUG("[EPD]: refresh begin\n");
@@ -93,57 +119,48 @@ void UC81xx_Dump_OTP(void)
     UC81xx_PowerOff();
 }
 
-void UC81xx_Init(epd_model_t *epd)
-{
-    EPD_Reset(HIGH, 10);
-    
-//    UC81xx_Dump_OTP();
-
-    EPD_Write(UC81xx_PSR, epd->color == BWR ? 0x0F : 0x1F);
-    EPD_Write(UC81xx_CDI, epd->color == BWR ? 0x77 : 0x97);
-}
-
-void UC8159_Init(epd_model_t *epd)
-{
-    EPD_Reset(HIGH, 10);
-
-    EPD_Write(UC81xx_PWR, 0x37, 0x00);
-    EPD_Write(UC81xx_PSR, 0xCF, 0x08);
-    EPD_Write(UC81xx_PLL, 0x3A);
-    EPD_Write(UC81xx_VDCS, 0x28);
-    EPD_Write(UC81xx_BTST, 0xc7, 0xcc, 0x15);
-    EPD_Write(UC81xx_CDI, 0x77);
-    EPD_Write(UC81xx_TCON, 0x22);
-    EPD_Write(0x65, 0x00); // FLASH CONTROL
-    EPD_Write(0xe5, 0x03); // FLASH MODE
-    EPD_Write(UC81xx_TRES,
-              epd->width >> 8,
-              epd->width & 0xff,
-              epd->height >> 8,
-              epd->height & 0xff);
-}
+static const uint8_t uc81xx_init[] = {
+    EPD_SEQ_RESET(10),
+    EPD_SEQ_COLOR(EPD_SEQ_BWR), EPD_SEQ_CMD(UC81xx_PSR, 1), 0x0F,
+    EPD_SEQ_COLOR(EPD_SEQ_BW | EPD_SEQ_BWRY), EPD_SEQ_CMD(UC81xx_PSR, 1), 0x1F,
+    EPD_SEQ_COLOR(EPD_SEQ_BWR), EPD_SEQ_CMD(UC81xx_CDI, 1), 0x77,
+    EPD_SEQ_COLOR(EPD_SEQ_BW | EPD_SEQ_BWRY), EPD_SEQ_CMD(UC81xx_CDI, 1), 0x97,
+    EPD_SEQ_END,
+};
 
-void JD79668_Init(epd_model_t *epd)
-{
-    EPD_Reset(HIGH, 50);
-
-    EPD_Write(0x4D, 0x78);
-    EPD_Write(UC81xx_PSR, 0x0F, 0x29);
-    EPD_Write(UC81xx_BTST, 0x0D, 0x12, 0x24, 0x25, 0x12, 0x29, 0x10);
-    EPD_Write(UC81xx_PLL, 0x08);
-    EPD_Write(UC81xx_CDI, 0x37);
-    EPD_Write(UC81xx_TRES,
-              epd->width / 256, epd->width % 256,
-              epd->height / 256, epd->height % 256);
-
-    EPD_Write(0xAE, 0xCF);
-    EPD_Write(0xB0, 0x13);
-    EPD_Write(0xBD, 0x07);
-    EPD_Write(0xBE, 0xFE);
-    EPD_Write(0xE9, 0x01);
+static const uint8_t uc8159_init[] = {
+    EPD_SEQ_RESET(10),
+    EPD_SEQ_CMD(UC81xx_PWR, 2), 0x37, 0x00,
+    EPD_SEQ_CMD(UC81xx_PSR, 2), 0xCF, 0x08,
+    EPD_SEQ_CMD(UC81xx_PLL, 1), 0x3A,
+    EPD_SEQ_CMD(UC81xx_VDCS, 1), 0x28,
+    EPD_SEQ_CMD(UC81xx_BTST, 3), 0xc7, 0xcc, 0x15,
+    EPD_SEQ_CMD(UC81xx_CDI, 1), 0x77,
+    EPD_SEQ_CMD(UC81xx_TCON, 1), 0x22,
+    EPD_SEQ_CMD(0x65, 1), 0x00, // FLASH CONTROL
+    EPD_SEQ_CMD(0xe5, 1), 0x03, // FLASH MODE
+    EPD_SEQ_CMD(UC81xx_TRES, 0), EPD_SEQ_SIZE,
+    EPD_SEQ_END,
+};
 
-    UC81xx_PowerOn();
-}
+// The booster is powered on at the end
+static const uint8_t jd79668_init[] = {
+    EPD_SEQ_RESET(50),
+    EPD_SEQ_CMD(0x4D, 1), 0x78,
+    EPD_SEQ_CMD(UC81xx_PSR, 2), 0x0F, 0x29,
+    EPD_SEQ_CMD(UC81xx_BTST, 7), 0x0D, 0x12, 0x24, 0x25, 0x12, 0x29, 0x10,
+    EPD_SEQ_CMD(UC81xx_PLL, 1), 0x08,
+    EPD_SEQ_CMD(UC81xx_CDI, 1), 0x37,
+    EPD_SEQ_CMD(UC81xx_TRES, 0), EPD_SEQ_SIZE,
+    EPD_SEQ_CMD(0xAE, 1), 0xCF,
+    EPD_SEQ_CMD(0xB0, 1), 0x13,
+    EPD_SEQ_CMD(0xBD, 1), 0x07,
+    EPD_SEQ_CMD(0xBE, 1), 0xFE,
+    EPD_SEQ_CMD(0xE9, 1), 0x01,
+    EPD_SEQ_CMD(UC81xx_PON, 0),
+    EPD_SEQ_BUSY(LOW, 200),
+    EPD_SEQ_END,
+};
 
 void UC81xx_Clear(epd_model_t *epd, bool refresh)
 {
@@ -299,67 +316,111 @@ void UC81xx_Write_Ram_Native(epd_model_t *epd, uint8_t cfg, uint8_t *data, uint8
     EPD_WriteData(data, len);
 }
 
+// Registers are kept after POF, the refresh powers on by itself. JD79668 has no wake:
+// its refresh leaves the booster on, so it is reset and initialized for every update.
+void UC81xx_Wake(epd_model_t *epd)
+{
+}
+
+static const uint8_t uc81xx_sleep[] = {
+    EPD_SEQ_CMD(UC81xx_POF, 0),
+    EPD_SEQ_BUSY(LOW, 200),
+    EPD_SEQ_DELAY(100),
+    EPD_SEQ_CMD(UC81xx_DSLP, 1), 0xA5,
+    EPD_SEQ_END,
+};
+
 void UC81xx_Sleep(epd_model_t *epd)
 {
-    UC81xx_PowerOff();
-    delay(100);
-    EPD_Write(UC81xx_DSLP, 0xA5);
+    epd_sequence_start(epd, uc81xx_sleep, NULL);
+    EPD_SetState(EPD_STATE_DEEP_SLEEP);
+}
+
+// UC81xx and JD79668 release BUSY_N (high) within the reset pulse, an idle SSD16xx keeps
+// BUSY low. Reads only.
+uint8_t UC81xx_Probe(uint8_t *id)
+{
+    if (EPD_BusyPin() != HIGH) return 0;
+    EPD_WriteCmd(UC81xx_FLG);
+    id[0] = EPD_ReadByte();
+    if (id[0] == 0xFF || (id[0] & 0x01) == 0) return 0; // no answer, or BUSY_N differs from the pin
+    EPD_WriteCmd(UC81xx_REV);
+    EPD_ReadData(&id[1], 4);
+    return 5;
 }
 
 // Declare driver and models
 static epd_driver_t epd_drv_uc8176 = {
     .ic = EPD_DRIVER_IC_UC8176,
-    .init = UC81xx_Init,
+    .family = EPD_DRIVER_FAMILY_UC81XX,
+    .init_seq = uc81xx_init,
     .clear = UC81xx_Clear,
     .write_image = UC81xx_Write_Image,
     .write_ram = UC81xx_Write_Ram,
     .refresh = UC81xx_Refresh,
+    .partial_refresh = UC81xx_Partial_Refresh,
     .sleep = UC81xx_Sleep,
     .read_temp = UC81xx_Read_Temp,
+    .set_temp = UC81xx_Set_Temp,
+    .wake = UC81xx_Wake,
+    .probe = UC81xx_Probe,
 };
 
 static epd_driver_t epd_drv_uc8159 = {
     .ic = EPD_DRIVER_IC_UC8159,
-    .init = UC8159_Init,
+    .family = EPD_DRIVER_FAMILY_UC81XX,
+    .init_seq = uc8159_init,
     .clear = UC8159_Clear,
     .write_image = UC8159_Write_Image,
     .write_ram = UC81xx_Write_Ram_Native,
     .refresh = UC81xx_Refresh,
+    .partial_refresh = UC81xx_Partial_Refresh,
     .sleep = UC81xx_Sleep,
     .read_temp = UC81xx_Read_Temp,
+    .wake = UC81xx_Wake,
+    .probe = UC81xx_Probe,
 };
 
 static epd_driver_t epd_drv_uc8179 = {
     .ic = EPD_DRIVER_IC_UC8179,
-    .init = UC81xx_Init,
+    .family = EPD_DRIVER_FAMILY_UC81XX,
+    .init_seq = uc81xx_init,
     .clear = UC81xx_Clear,
     .write_image = UC81xx_Write_Image,
     .write_ram = UC81xx_Write_Ram,
     .refresh = UC81xx_Refresh,
+    .partial_refresh = UC81xx_Partial_Refresh,
     .sleep = UC81xx_Sleep,
     .read_temp = UC81xx_Read_Temp,
+    .set_temp = UC81xx_Set_Temp,
+    .wake = UC81xx_Wake,
+    .probe = UC81xx_Probe,
 };
 
 static epd_driver_t epd_drv_jd79668 = {
     .ic = EPD_DRIVER_IC_JD79668,
-    .init = JD79668_Init,
+    .family = EPD_DRIVER_FAMILY_UC81XX,
+    .init_seq = jd79668_init,
     .clear = JD79668_Clear,
     .write_image = JD79668_Write_Image,
     .write_ram = UC81xx_Write_Ram_Native,
     .refresh = JD79668_Refresh,
     .sleep = UC81xx_Sleep,
     .read_temp = UC81xx_Read_Temp,
+    .probe = UC81xx_Probe,
 };
 
 static epd_driver_t epd_drv_jd79665 = {
     .ic = EPD_DRIVER_IC_JD79665,
-    .init = JD79668_Init,
+    .family = EPD_DRIVER_FAMILY_UC81XX,
+    .init_seq = jd79668_init,
     .clear = JD79668_Clear,
     .write_image = JD79668_Write_Image,
     .write_ram = UC81xx_Write_Ram_Native,
     .refresh = JD79668_Refresh,
     .sleep = UC81xx_Sleep,
     .read_temp = UC81xx_Read_Temp,
+    .probe = UC81xx_Probe,
 };
 
 // UC8176 400x300 Black/White
@@ -44,6 +44,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #ifndef MIN
 #define MIN(a, b) (((a) < (b)) ? (a) : (b))
 #endif
+#ifndef MAX
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+#endif
 #ifndef SWAP
 #define SWAP(a, b, T) do { T t = a; a = b; b = t; } while (0)
 #endif
@@ -71,24 +74,33 @@ static void GFX_u8g2_draw_hv_line(u8g2_font_t *u8g2, int16_t x, int16_t y,
   }
 }
 
+static uint8_t gfx_arena[GFX_ARENA_SIZE];
+
+static void GFX_init(Adafruit_GFX *gfx, int16_t w, int16_t h, int16_t buffer_height, uint8_t planes) {
+  memset(gfx, 0, sizeof(Adafruit_GFX));
+  memset(&gfx->u8g2, 0, sizeof(gfx->u8g2));
+  gfx->WIDTH = gfx->_width = w;
+  gfx->HEIGHT = gfx->_height = h;
+  gfx->u8g2.draw_hv_line = GFX_u8g2_draw_hv_line;
+  // use the whole frame if it fits in the arena, fall back to paging otherwise
+  int16_t max_height = MIN(GFX_ARENA_SIZE / ((gfx->WIDTH + 7) / 8), gfx->HEIGHT * planes);
+  if (buffer_height <= 0 || buffer_height > max_height)
+    buffer_height = max_height;
+  gfx->buffer = gfx_arena;
+  gfx->page_height = buffer_height / planes;
+  GFX_setWindow(gfx, 0, 0, gfx->WIDTH, gfx->HEIGHT);
+}
+
 /**************************************************************************/
 /*!
    @brief    Instatiate a GFX context for graphics
    @param    w   Display width, in pixels
    @param    h   Display height, in pixels
-   @param    buffer_height Page buffer height
+   @param    buffer_height Page buffer height, 0 to use as much of the arena as needed
 */
 /**************************************************************************/
 void GFX_begin(Adafruit_GFX *gfx, int16_t w, int16_t h, int16_t buffer_height) {
-  memset(gfx, 0, sizeof(Adafruit_GFX));
-  memset(&gfx->u8g2, 0, sizeof(gfx->u8g2));
-  gfx->WIDTH = gfx->_width = w;
-  gfx->HEIGHT = gfx->_height = h;
-  gfx->u8g2.draw_hv_line = GFX_u8g2_draw_hv_line;
-  gfx->buffer = malloc(((gfx->WIDTH + 7) / 8) * buffer_height);
-  gfx->page_height = buffer_height;
-  gfx->total_pages = (gfx->HEIGHT / gfx->page_height) + (gfx->HEIGHT % gfx->page_height > 0);
-  GFX_setWindow(gfx, 0, 0, gfx->WIDTH, gfx->HEIGHT);
+  GFX_init(gfx, w, h, buffer_height, 1);
 }
 
 /**************************************************************************/
@@ -96,14 +108,12 @@ void GFX_begin(Adafruit_GFX *gfx, int16_t w, int16_t h, int16_t buffer_height) {
    @brief    Instatiate a 3-color GFX context for graphics
    @param    w   Display width, in pixels
    @param    h   Display height, in pixels
-   @param    buffer_height Page buffer height, should be multiple of 2
+   @param    buffer_height Page buffer height, should be multiple of 2, 0 to use as much of the arena as needed
 */
 /**************************************************************************/
 void GFX_begin_3c(Adafruit_GFX *gfx, int16_t w, int16_t h, int16_t buffer_height) {
-  GFX_begin(gfx, w, h, buffer_height);
-  gfx->page_height /= 2;
+  GFX_init(gfx, w, h, buffer_height, 2);
   gfx->color = gfx->buffer + ((gfx->WIDTH + 7) / 8) * gfx->page_height;
-  gfx->total_pages = (gfx->HEIGHT / gfx->page_height) + (gfx->HEIGHT % gfx->page_height > 0);
 }
 
 /**************************************************************************/
@@ -111,18 +121,17 @@ void GFX_begin_3c(Adafruit_GFX *gfx, int16_t w, int16_t h, int16_t buffer_height
    @brief    Instatiate a 4-color GFX context for graphics
    @param    w   Display width, in pixels
    @param    h   Display height, in pixels
-   @param    buffer_height Page buffer height, should be multiple of 2
+   @param    buffer_height Page buffer height, should be multiple of 2, 0 to use as much of the arena as needed
 */
 /**************************************************************************/
 void GFX_begin_4c(Adafruit_GFX *gfx, int16_t w, int16_t h, int16_t buffer_height) {
-  GFX_begin(gfx, w, h, buffer_height);
-  gfx->page_height /= 2;
+  GFX_init(gfx, w, h, buffer_height, 2);
   gfx->color = gfx->buffer;
-  gfx->total_pages = (gfx->HEIGHT / gfx->page_height) + (gfx->HEIGHT % gfx->page_height > 0);
 }
 
 void GFX_end(Adafruit_GFX *gfx) {
-  if (gfx->buffer) free(gfx->buffer);
+  gfx->buffer = NULL;
+  gfx->color = NULL;
 }
 
 void GFX_firstPage(Adafruit_GFX *gfx) {
@@ -130,20 +139,29 @@ void GFX_firstPage(Adafruit_GFX *gfx) {
   gfx->current_page = 0;
 }
 
-bool GFX_nextPage(Adafruit_GFX *gfx, buffer_callback callback, void *user_data) {
-  if (callback) {
-    int16_t page_ys = gfx->current_page * gfx->page_height;
-    if (gfx->px != 0 || gfx->py != 0 || gfx->pw != gfx->_width || gfx->ph != gfx->_height) {
-      int16_t page_ye = gfx->current_page < gfx->total_pages - 1 ? page_ys + gfx->page_height : gfx->HEIGHT;
-      uint16_t dest_ys = gfx->py + page_ys; // transposed
-      uint16_t dest_ye = MIN(gfx->py + gfx->ph, gfx->py + page_ye);
-      if (dest_ye > dest_ys)
-        callback(user_data, gfx->buffer, gfx->color, gfx->px, dest_ys, gfx->pw, dest_ye - dest_ys);
-    } else {
-      int16_t height = MIN(gfx->page_height, gfx->HEIGHT - page_ys);
-      callback(user_data, gfx->buffer, gfx->color, 0, page_ys, gfx->WIDTH, height);
-    }
+// Pass the area of the current page to the callback
+static void GFX_page(Adafruit_GFX *gfx, buffer_callback callback, void *user_data) {
+  int16_t page_ys = gfx->current_page * gfx->page_height;
+  if (gfx->px != 0 || gfx->py != 0 || gfx->pw != gfx->_width || gfx->ph != gfx->_height) {
+    int16_t page_ye = gfx->current_page < gfx->total_pages - 1 ? page_ys + gfx->page_height : gfx->HEIGHT;
+    uint16_t dest_ys = gfx->py + page_ys; // transposed
+    uint16_t dest_ye = MIN(gfx->py + gfx->ph, gfx->py + page_ye);
+    if (dest_ye > dest_ys)
+      callback(user_data, gfx->buffer, gfx->color, gfx->px, dest_ys, gfx->pw, dest_ye - dest_ys);
+  } else {
+    int16_t height = MIN(gfx->page_height, gfx->HEIGHT - page_ys);
+    callback(user_data, gfx->buffer, gfx->color, 0, page_ys, gfx->WIDTH, height);
   }
+}
+
+// Fill the current page from the callback instead of white, to draw over an existing image
+void GFX_loadPage(Adafruit_GFX *gfx, buffer_callback callback, void *user_data) {
+  GFX_page(gfx, callback, user_data);
+}
+
+bool GFX_nextPage(Adafruit_GFX *gfx, buffer_callback callback, void *user_data) {
+  if (callback)
+    GFX_page(gfx, callback, user_data);
 
   gfx->current_page++;
   GFX_fillScreen(gfx, GFX_WHITE);
@@ -211,6 +229,9 @@ void GFX_setWindow(Adafruit_GFX *gfx, uint16_t x, uint16_t y, uint16_t w, uint16
   gfx->pw += gfx->px % 8;
   if (gfx->pw % 8 > 0) gfx->pw += 8 - (gfx->pw % 8);
   gfx->px -= gfx->px % 8;
+
+  // only the pages covering the window need to be drawn
+  gfx->total_pages = (gfx->ph / gfx->page_height) + (gfx->ph % gfx->page_height > 0);
 }
 
 static uint8_t color4(uint16_t color) {
@@ -477,7 +498,7 @@ void GFX_fillRect(Adafruit_GFX *gfx, int16_t x, int16_t y, int16_t w, int16_t h,
 */
 /**************************************************************************/
 void GFX_fillScreen(Adafruit_GFX *gfx, uint16_t color) {
-  uint32_t size = ((gfx->WIDTH + 7) / 8) * gfx->page_height;
+  uint32_t size = (gfx->pw / 8) * gfx->page_height; // only the (partial) window is used
   if (gfx->color == gfx->buffer) { // 4c
     uint8_t pv = color4(color) * 0x55; // 0b01010101
     memset(gfx->buffer, pv, size * 2);
@@ -857,6 +878,74 @@ void GFX_drawBitmap(Adafruit_GFX *gfx, int16_t x, int16_t y, const uint8_t bitma
   }
 }
 
+// 8 bitmap pixels starting at bit offset s (s >= -8), pixels outside the row are 0
+static uint8_t GFX_bitmapByte(const uint8_t *row, int16_t byteWidth, int16_t s) {
+  int16_t i = (s + 8) / 8 - 1;
+  uint8_t r = (s + 8) % 8;
+  uint8_t hi = (i >= 0 && i < byteWidth) ? row[i] : 0;
+  uint8_t lo = (i + 1 >= 0 && i + 1 < byteWidth) ? row[i + 1] : 0;
+  return (uint8_t)((((uint16_t)hi << 8) | lo) >> (8 - r));
+}
+
+/**************************************************************************/
+/*!
+   @brief      Draw a 1-bit bitmap, set bits in color, unset bits are
+   transparent. Writes whole bytes into the page buffer, the bitmap
+   needs not be aligned. Falls back to GFX_drawBitmap for rotated or
+   4-color contexts.
+    @param    x   Top left corner x coordinate
+    @param    y   Top left corner y coordinate
+    @param    bitmap  byte array with monochrome bitmap, padding bits must be 0
+    @param    w   Width of bitmap in pixels
+    @param    h   Height of bitmap in pixels
+    @param    color 16-bit 5-6-5 Color to draw with
+*/
+/**************************************************************************/
+void GFX_blitBitmap(Adafruit_GFX *gfx, int16_t x, int16_t y, const uint8_t bitmap[],
+                    int16_t w, int16_t h, uint16_t color) {
+  if (gfx->rotation != GFX_ROTATE_0 || gfx->color == gfx->buffer) {
+    GFX_drawBitmap(gfx, x, y, bitmap, w, h, color, false);
+    return;
+  }
+
+  int16_t byteWidth = (w + 7) / 8;
+  int16_t stride = gfx->pw / 8;
+  int16_t page_ys = gfx->current_page * gfx->page_height;
+  // bitmap position relative to the (partial) window
+  int16_t bx = x - gfx->px;
+  int16_t by = y - gfx->py;
+  // visible pixels in window coordinates
+  int16_t xs = MAX(bx, MAX(0, -gfx->px));
+  int16_t xe = MIN(bx + w, MIN(gfx->pw, gfx->_width - gfx->px));
+  int16_t ys = MAX(by, MAX(page_ys, -gfx->py));
+  int16_t ye = MIN(by + h, MIN(MIN(gfx->ph, page_ys + gfx->page_height), gfx->_height - gfx->py));
+  if (xs >= xe || ys >= ye) return;
+
+  for (int16_t j = ys; j < ye; j++) {
+    const uint8_t *row = &bitmap[(j - by) * byteWidth];
+    uint32_t i = (uint32_t)(j - page_ys) * stride;
+    for (int16_t k = xs / 8; k <= (xe - 1) / 8; k++) {
+      uint8_t m = GFX_bitmapByte(row, byteWidth, k * 8 - bx);
+      if (k == xs / 8) m &= 0xFF >> (xs % 8);
+      if (k == (xe - 1) / 8) m &= 0xFF << (7 - (xe - 1) % 8);
+      if (m == 0) continue;
+      if (gfx->color != NULL) { // 3c
+        gfx->buffer[i + k] |= m; // white
+        gfx->color[i + k] |= m;
+        if (color == GFX_BLACK)
+          gfx->buffer[i + k] &= ~m;
+        else if (color != GFX_WHITE)
+          gfx->color[i + k] &= ~m;
+      } else {
+        if (color == GFX_WHITE)
+          gfx->buffer[i + k] |= m;
+        else
+          gfx->buffer[i + k] &= ~m;
+      }
+    }
+  }
+}
+
 /*
 
   U8g2_for_Adafruit_GFX.cpp
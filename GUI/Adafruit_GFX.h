@@ -6,6 +6,11 @@
 #include <stdlib.h>
 #include "u8g2_font.h"
 
+// Size of the static page buffer, a full frame is drawn in one page if it fits
+#ifndef GFX_ARENA_SIZE
+#define GFX_ARENA_SIZE (__HEAP_SIZE - 512)
+#endif
+
 #define GFX_BLACK     0x0000
 #define GFX_WHITE     0xFFFF
 #define GFX_RED       0xF800 // 255,   0,   0
@@ -52,6 +57,7 @@ void GFX_setRotation(Adafruit_GFX *gfx, GFX_Rotate r);
 void GFX_setWindow(Adafruit_GFX *gfx, uint16_t x, uint16_t y, uint16_t w, uint16_t h);
 void GFX_firstPage(Adafruit_GFX *gfx);
 bool GFX_nextPage(Adafruit_GFX *gfx, buffer_callback callback, void *user_data);
+void GFX_loadPage(Adafruit_GFX *gfx, buffer_callback callback, void *user_data);
 void GFX_end(Adafruit_GFX *gfx);
 
 // DRAW API
@@ -80,6 +86,8 @@ void GFX_fillRoundRect(Adafruit_GFX *gfx, int16_t x0, int16_t y0, int16_t w, int
                        int16_t radius, uint16_t color);
 void GFX_drawBitmap(Adafruit_GFX *gfx, int16_t x, int16_t y, const uint8_t bitmap[], int16_t w,
                     int16_t h, uint16_t color, bool invert);
+void GFX_blitBitmap(Adafruit_GFX *gfx, int16_t x, int16_t y, const uint8_t bitmap[], int16_t w,
+                    int16_t h, uint16_t color);
 
 // U8G2 FONT API
 void GFX_setCursor(Adafruit_GFX *gfx, int16_t x, int16_t y);
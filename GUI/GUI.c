@@ -1,10 +1,15 @@
 #include "fonts.h"
 #include "Lunar.h"
 #include "GUI.h"
-#include <time.h>
 #include <stdio.h>
 
 #define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+#ifndef MIN
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+#endif
 #define GFX_printf_styled(gfx, fg, bg, font, ...) \
             GFX_setTextColor(gfx, fg, bg);        \
             GFX_setFont(gfx, font);               \
@@ -48,30 +53,29 @@ static const Festival festivals_lunar[] = {
     {12, 30, "除夕"  },
 };
 
-// 放假和调休数据，每年更新
+// 内置的放假和调休数据，其他年份可以通过蓝牙写入 (EPD_holiday.h)
 #define HOLIDAY_YEAR 2025
-static const uint16_t holidays[] = {
-    0x0101, 0x111A, 0x011C, 0x011D, 0x011E, 0x011F, 0x0201, 0x0202,
-    0x0202, 0x0203, 0x0204, 0x1208, 0x0404, 0x0405, 0x0406, 0x141B,
-    0x0501, 0x0502, 0x0503, 0x0504, 0x0505, 0x051F, 0x0601, 0x0602,
-    0x191C, 0x0A01, 0x0A02, 0x0A03, 0x0A04, 0x0A05, 0x0A06, 0x0A07,
-    0x0A08, 0x1A0B,
+static const uint8_t holidays[HOLIDAY_BITMAP_SIZE] = {
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x48, 0x55, 0x15, 0x20, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x54,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x55, 0x01, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x50, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x54, 0x55, 0x81, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 };
 
-static bool GetHoliday(uint8_t mon, uint8_t day, bool *work)
+static holiday_t GetHoliday(const uint8_t *bitmap, uint16_t yday)
 {
-    for (uint8_t i = 0; i < ARRAY_SIZE(holidays); i++) {
-        if (((holidays[i] >> 8) & 0xF) == mon && (holidays[i] & 0xFF) == day) {
-            *work = ((holidays[i] >> 12) & 0xF) > 0;
-            return true;
-        }
-    }
-    return false;
+    return (holiday_t)((bitmap[yday >> 2] >> ((yday & 3) << 1)) & 3);
 }
 
 static bool GetFestival(uint16_t year, uint8_t mon, uint8_t day, uint8_t week,
-                        struct Lunar_Date *Lunar, char *festival)
+                        const lunar_iter_t *iter, char *festival)
 {
+    const struct Lunar_Date *Lunar = &iter->date;
+
     // 农历节日
     for (uint8_t i = 0; i < ARRAY_SIZE(festivals_lunar); i++) {
         if (Lunar->Month == festivals_lunar[i].month && Lunar->Date == festivals_lunar[i].day) {
@@ -82,11 +86,9 @@ static bool GetFestival(uint16_t year, uint8_t mon, uint8_t day, uint8_t week,
 
     // 除夕：春节前一天（12/29 或 12/30），12/30 已在上面判断
     if (Lunar->Month == 12 && Lunar->Date == 29) {
-        struct Lunar_Date nextLunar;
-        struct devtm tm = {year, mon, day, 0, 0, 0, week};
-        transformTime(transformTimeStruct(&tm) + 86400, &tm);
-        LUNAR_SolarToLunar(&nextLunar, tm.tm_year + YEAR0, tm.tm_mon + 1, tm.tm_mday);
-        if (nextLunar.Month == 1 && nextLunar.Date == 1) {
+        lunar_iter_t next = *iter;
+        LUNAR_IterNext(&next);
+        if (next.date.Month == 1 && next.date.Date == 1) {
             strcpy(festival, "除夕");
             return true;
         }
@@ -153,10 +155,10 @@ static void DrawTimeSyncTip(Adafruit_GFX *gfx, gui_data_t *data)
     GFX_printf(gfx, url);
 }
 
-static void DrawBattery(Adafruit_GFX *gfx, int16_t x, int16_t y, uint8_t iw, float voltage)
+static void DrawBattery(Adafruit_GFX *gfx, int16_t x, int16_t y, uint8_t iw, float voltage, uint8_t level)
 {
     x -= iw;
-    uint8_t level = (uint8_t)(voltage * 100 / 3.6f);
+    if (level > 100) level = 100;
     GFX_setFont(gfx, u8g2_font_wqy9_t_lunar);
     GFX_setCursor(gfx, x - GFX_getUTF8Width(gfx, "3.2V") - 2, y + 9);
     GFX_printf(gfx, "%.1fV", voltage);
@@ -166,20 +168,6 @@ static void DrawBattery(Adafruit_GFX *gfx, int16_t x, int16_t y, uint8_t iw, flo
     GFX_fillRect(gfx, x + 2, y + 2, 16 * level / 100, 6, GFX_BLACK);
 }
 
-static uint8_t GetWeekOfYear(uint8_t year, uint8_t mon, uint8_t mday, uint8_t wday)
-{
-    struct tm tm = {0};
-    tm.tm_year = year;
-    tm.tm_mon = mon;
-    tm.tm_mday = mday;
-    tm.tm_wday = wday;
-    tm.tm_isdst = -1;
-    mktime(&tm);
-    char buffer[3] = {0};
-    strftime(buffer, 3, "%V", &tm);
-    return atoi(buffer);
-}
-
 static void DrawDateHeader(Adafruit_GFX *gfx, int16_t x, int16_t y, tm_t *tm, struct Lunar_Date *Lunar, gui_data_t *data)
 {
     GFX_setCursor(gfx, x, y - 2);
@@ -197,7 +185,7 @@ static void DrawDateHeader(Adafruit_GFX *gfx, int16_t x, int16_t y, tm_t *tm, st
     GFX_printf(gfx, "%s%s%s", Lunar_MonthLeapString[Lunar->IsLeap], Lunar_MonthString[Lunar->Month],
                      Lunar_DateString[Lunar->Date]);
     GFX_setTextColor(gfx, GFX_RED, GFX_WHITE);
-    GFX_printf(gfx, " [%d周]", GetWeekOfYear(tm->tm_year, tm->tm_mon, tm->tm_mday, tm->tm_wday));
+    GFX_printf(gfx, " [%d周]", week_of_year(tm->tm_year + YEAR0, tm->tm_mon + 1, tm->tm_mday));
  
     GFX_setCursor(gfx, tx, ty - 14);
     GFX_setTextColor(gfx, GFX_BLACK, GFX_WHITE);
@@ -206,7 +194,7 @@ static void DrawDateHeader(Adafruit_GFX *gfx, int16_t x, int16_t y, tm_t *tm, st
     GFX_printf(gfx, " [%s]", Lunar_ZodiacString[LUNAR_GetZodiac(Lunar)]);
 
     GFX_setTextColor(gfx, GFX_BLACK, GFX_WHITE);
-    DrawBattery(gfx, data->width - 10 - 2, data->height > 300 ? 16 : 6, 20, data->voltage);
+    DrawBattery(gfx, data->width - 10 - 2, data->height > 300 ? 16 : 6, 20, data->voltage, data->battery);
     GFX_setCursor(gfx, data->width - GFX_getUTF8Width(gfx, data->ssid) - 10, y);
     GFX_printf(gfx, "%s", data->ssid);
 }
@@ -247,7 +235,14 @@ static void DrawMonthDays(Adafruit_GFX *gfx, int16_t x, int16_t y, tm_t *tm, str
             GFX_drawDottedLine(gfx, x + i * bw, y, x + i * bw, y + monthDayRows * bh - 1, GFX_BLACK, 1, 5);
     }
 
-    for (uint8_t i = 0; i < monthMaxDays; i++) {
+    lunar_iter_t iter;
+    LUNAR_IterInit(&iter, tm->tm_year + YEAR0, tm->tm_mon + 1, 1);
+
+    const uint8_t *bitmap = data->holidays;
+    if (bitmap == NULL && tm->tm_year + YEAR0 == HOLIDAY_YEAR) bitmap = holidays;
+    uint16_t yday = days_from_civil(tm->tm_year + YEAR0, tm->tm_mon + 1, 1) - days_from_civil(tm->tm_year + YEAR0, 1, 1);
+
+    for (uint8_t i = 0; i < monthMaxDays; i++, LUNAR_IterNext(&iter)) {
         uint16_t year = tm->tm_year + YEAR0;
         uint8_t month = tm->tm_mon + 1;
         uint8_t day = i + 1;
@@ -256,7 +251,7 @@ static void DrawMonthDays(Adafruit_GFX *gfx, int16_t x, int16_t y, tm_t *tm, str
         int16_t displayWeek = (adjustedFirstDay + i) % 7;
         bool weekend = (actualWeek  == 0) || (actualWeek == 6);
 
-        LUNAR_SolarToLunar(Lunar, year, month, day);
+        *Lunar = iter.date;
 
         int16_t cr = large ? 13 : 10;
         int16_t bx = x + (bw - 2 * cr) / 2 + displayWeek * bw;
@@ -276,7 +271,7 @@ static void DrawMonthDays(Adafruit_GFX *gfx, int16_t x, int16_t y, tm_t *tm, str
         char festival[10] = {0};
         GFX_setFont(gfx, large ? u8g2_font_wqy12_t_lunar : u8g2_font_wqy9_t_lunar);
         GFX_setFontMode(gfx, 1); // transparent
-        if (GetFestival(year, month, day, actualWeek, Lunar, festival)) {
+        if (GetFestival(year, month, day, actualWeek, &iter, festival)) {
             if (day != tm->tm_mday) GFX_setTextColor(gfx, GFX_RED, GFX_WHITE);
         } else {
             if (Lunar->Date == 1)
@@ -287,8 +282,9 @@ static void DrawMonthDays(Adafruit_GFX *gfx, int16_t x, int16_t y, tm_t *tm, str
         GFX_setCursor(gfx, bx + (2 * cr - GFX_getUTF8Width(gfx, festival)) / 2, gfx->ty + GFX_getFontHeight(gfx) + 3);
         GFX_printf(gfx, "%s", festival);
 
-        bool work = false;
-        if (year == HOLIDAY_YEAR && GetHoliday(month, day, &work)) {
+        holiday_t holiday = bitmap ? GetHoliday(bitmap, yday + i) : HOLIDAY_NONE;
+        if (holiday == HOLIDAY_OFF || holiday == HOLIDAY_WORK) {
+            bool work = holiday == HOLIDAY_WORK;
             if (day == tm->tm_mday) {
                 uint16_t rx = bx + (large ? 36 : 27);
                 uint16_t ry = by - 2;
@@ -342,19 +338,115 @@ static void Draw7Number(Adafruit_GFX *gfx, int n, unsigned int xLoc, unsigned in
     }
 }
 
+/* 7-segment sprites for Draw7Number's segment shapes, rasterized once per segment size.
+   All horizontal segments (a, d, g) share one shape, and so do the vertical ones (b, c, e, f),
+   so the atlas only holds two sprites instead of ten digits:
+
+   horizontal: 7*cS x 2*cS, rows widen by 2 pixels for cS rows, then narrow again
+   vertical:   2*cS x 9*cS, columns grow by 2 pixels for cS columns, then shrink again
+*/
+#define SEGMENT_ATLAS_SIZE 520 // enough for cS <= 11 (528 pixels high panels)
+static uint8_t segment_atlas[SEGMENT_ATLAS_SIZE];
+static uint16_t segment_atlas_cS = 0;
+
+static void SetSpritePixels(uint8_t *sprite, uint16_t wb, uint16_t x, uint16_t y, uint16_t w)
+{
+    for (uint16_t i = x; i < x + w; i++)
+        sprite[y * wb + i / 8] |= 0x80 >> (i & 7);
+}
+
+static bool LoadSegmentAtlas(uint16_t cS, uint8_t **hseg, uint8_t **vseg)
+{
+    uint16_t hwb = (7 * cS + 7) / 8;
+    uint16_t vwb = (2 * cS + 7) / 8;
+    if (cS == 0 || hwb * 2 * cS + vwb * 9 * cS > SEGMENT_ATLAS_SIZE)
+        return false;
+
+    *hseg = segment_atlas;
+    *vseg = segment_atlas + hwb * 2 * cS;
+    if (segment_atlas_cS == cS)
+        return true;
+
+    memset(segment_atlas, 0, sizeof(segment_atlas));
+    for (uint16_t r = 0; r < 2 * cS; r++) {
+        if (r < cS)
+            SetSpritePixels(*hseg, hwb, cS - r, r, 5 * cS + 2 * r);
+        else
+            SetSpritePixels(*hseg, hwb, r - cS, r, 7 * cS - 2 * (r - cS));
+    }
+    for (uint16_t c = 0; c < 2 * cS; c++) {
+        uint16_t y = c < cS ? cS - c : c - cS;
+        uint16_t h = c < cS ? 7 * cS + 2 * c : 9 * cS - 2 * (c - cS);
+        for (uint16_t r = y; r < y + h; r++)
+            SetSpritePixels(*vseg, vwb, c, r, 1);
+    }
+    segment_atlas_cS = cS;
+
+    return true;
+}
+
+// Same output as Draw7Number for non-negative numbers, blitted from the segment atlas
+static void Draw7NumberFast(Adafruit_GFX *gfx, int n, int16_t xLoc, int16_t yLoc, uint16_t cS, uint16_t fC, uint16_t bC, uint16_t nD)
+{
+    static const uint8_t nums[10] = {0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07, 0x7F, 0x6F};
+    uint8_t *hseg, *vseg;
+
+    if (n < 0 || !LoadSegmentAtlas(cS, &hseg, &vseg)) {
+        Draw7Number(gfx, n, xLoc, yLoc, cS, fC, bC, nD);
+        return;
+    }
+
+    int16_t x1 = cS + 1, x2 = 7 * cS + 1, y1 = yLoc + x1, y3 = yLoc + 9 * cS + 1;
+    const int16_t seg[7][3] = {{x1, yLoc, 1}, {x2, y1, 0}, {x2, y3 + x1, 0}, {x1, (2 * y3) - yLoc, 1},
+                               {0, y3 + x1, 0}, {0, y1, 0}, {x1, y3, 1}};
+    for (int16_t d = nD - 1; d >= 0; d--, n /= 10) {
+        int16_t x = xLoc + d * (11 * cS + 2);
+        uint8_t i = n % 10;
+        for (uint8_t j = 0; j < 7; j++) {
+            uint16_t col = (nums[i] & (1 << j)) ? fC : bC;
+            if (seg[j][2])
+                GFX_blitBitmap(gfx, x + seg[j][0], seg[j][1], hseg, 7 * cS, 2 * cS, col);
+            else
+                GFX_blitBitmap(gfx, x + seg[j][0], seg[j][1], vseg, 2 * cS, 9 * cS, col);
+        }
+    }
+}
+
 static void DrawTime(Adafruit_GFX *gfx, tm_t *tm, int16_t x, int16_t y, uint16_t cS, uint16_t nD)
 {
-    Draw7Number(gfx, tm->tm_hour, x, y, cS, GFX_BLACK, GFX_WHITE, nD);
+    Draw7NumberFast(gfx, tm->tm_hour, x, y, cS, GFX_BLACK, GFX_WHITE, nD);
     x += (nD*(11*cS+2)-2*cS) + 2*cS;
     GFX_fillRect(gfx, x, y + 4.5*cS+1, 2*cS, 2*cS, GFX_BLACK);
     GFX_fillRect(gfx, x, y + 13.5*cS+3, 2*cS, 2*cS, GFX_BLACK);
     x += 4*cS;
-    Draw7Number(gfx, tm->tm_min, x, y, cS, GFX_BLACK, GFX_WHITE, nD);
+    Draw7NumberFast(gfx, tm->tm_min, x, y, cS, GFX_BLACK, GFX_WHITE, nD);
+}
+
+typedef struct {
+    uint8_t padding;
+    uint16_t cS;     // 7-segment size
+    uint16_t nD;     // digits per number
+    int16_t time_x;
+    int16_t time_y;
+} clock_layout_t;
+
+static void GetClockLayout(gui_data_t *data, clock_layout_t *layout)
+{
+    layout->padding = data->height > 300 ? 100 : 40;
+    layout->cS = data->height / 45;
+    layout->nD = 2;
+    uint16_t time_width = 2 * (layout->nD * (11 * layout->cS + 2) - 2 * layout->cS) + 4 * layout->cS;
+    uint16_t time_height = 20 * layout->cS + 4;
+    layout->time_x = (data->width - time_width) / 2;
+    layout->time_y = (68 + (data->height - 68)) / 2 - time_height / 2;
 }
 
 static void DrawClock(Adafruit_GFX *gfx, tm_t *tm, struct Lunar_Date *Lunar, gui_data_t *data)
 {
-    uint8_t padding = data->height > 300 ? 100 : 40;
+    clock_layout_t layout;
+    GetClockLayout(data, &layout);
+
+    uint8_t padding = layout.padding;
     GFX_setCursor(gfx, padding, 36);
     GFX_printf_styled(gfx, GFX_RED, GFX_WHITE, u8g2_font_helvB18_tn, "%d", tm->tm_year + YEAR0);
     GFX_printf_styled(gfx, GFX_BLACK, GFX_WHITE, u8g2_font_wqy12_t_lunar, "年");
@@ -370,7 +462,7 @@ static void DrawClock(Adafruit_GFX *gfx, tm_t *tm, struct Lunar_Date *Lunar, gui
     GFX_printf(gfx, "%s%s%s", Lunar_MonthLeapString[Lunar->IsLeap], Lunar_MonthString[Lunar->Month],
         Lunar_DateString[Lunar->Date]);
 
-    DrawBattery(gfx, data->width - padding, 25, 20, data->voltage);
+    DrawBattery(gfx, data->width - padding, 25, 20, data->voltage, data->battery);
 
     char ssid[5] = {0};
     int16_t ssid_len = strlen(data->ssid);
@@ -382,13 +474,7 @@ static void DrawClock(Adafruit_GFX *gfx, tm_t *tm, struct Lunar_Date *Lunar, gui
 
     GFX_drawFastHLine(gfx, padding - 10, 68, data->width - 2 * (padding - 10), GFX_BLACK);
     
-    uint16_t cS = data->height / 45;
-    uint16_t nD = 2;
-    uint16_t time_width = 2 * (nD * (11 * cS + 2) - 2 * cS) + 4 * cS;
-    uint16_t time_height = 20 * cS + 4;
-    int16_t time_x = (data->width - time_width) / 2;
-    int16_t time_y = (68 + (data->height - 68)) / 2 - time_height / 2;
-    DrawTime(gfx, tm, time_x, time_y, cS, nD);
+    DrawTime(gfx, tm, layout.time_x, layout.time_y, layout.cS, layout.nD);
     
     GFX_drawFastHLine(gfx, padding - 10, data->height - 68, data->width - 2 * (padding - 10), GFX_BLACK);
 
@@ -401,7 +487,7 @@ static void DrawClock(Adafruit_GFX *gfx, tm_t *tm, struct Lunar_Date *Lunar, gui
     GFX_printf(gfx, "年");
 
     GFX_setCursor(gfx, padding, data->height - 68 + 30 + 20);
-    GFX_printf(gfx, " %d周", GetWeekOfYear(tm->tm_year, tm->tm_mon, tm->tm_mday, tm->tm_wday));
+    GFX_printf(gfx, " %d周", week_of_year(tm->tm_year + YEAR0, tm->tm_mon + 1, tm->tm_mday));
 
     uint8_t day = 0;
     uint8_t JQday = GetJieQiStr(tm->tm_year + YEAR0, tm->tm_mon + 1, tm->tm_mday, &day);
@@ -411,7 +497,7 @@ static void DrawClock(Adafruit_GFX *gfx, tm_t *tm, struct Lunar_Date *Lunar, gui
         GFX_printf(gfx, "%s", JieQiStr[JQday % 24]);
     } else {
         GFX_setCursor(gfx, data->width - GFX_getUTF8Width(gfx, "离小暑") - padding, data->height - 68 + 30);
-        GFX_printf(gfx, "离%");
+        GFX_printf(gfx, "离");
         GFX_setTextColor(gfx, GFX_RED, GFX_WHITE);
         GFX_printf(gfx, "%s", JieQiStr[JQday % 24]);
         GFX_setTextColor(gfx, GFX_BLACK, GFX_WHITE);
@@ -422,24 +508,200 @@ static void DrawClock(Adafruit_GFX *gfx, tm_t *tm, struct Lunar_Date *Lunar, gui
     }
 }
 
-void DrawGUI(gui_data_t *data, buffer_callback callback, void *callback_data)
+// Position of the i-th time digit (0..nD-1: hour, nD..2*nD-1: minute), see DrawTime
+static int16_t GetClockDigitX(clock_layout_t *layout, uint8_t i)
 {
-    if (data->week_start > 6) data->week_start = 0;
+    int16_t x = layout->time_x + i * (11 * layout->cS + 2);
+    if (i >= layout->nD) x += 4 * layout->cS;
+    return x;
+}
 
-    tm_t tm = {0};
-    struct Lunar_Date Lunar;
+// Area covered by the battery, voltage and temperature texts in clock mode
+static void GetClockStatusRect(gui_data_t *data, clock_layout_t *layout, gui_rect_t *rect)
+{
+    Adafruit_GFX gfx;
+    char buf[20] = {0};
+
+    memset(&gfx, 0, sizeof(Adafruit_GFX));
+    GFX_setFont(&gfx, u8g2_font_wqy9_t_lunar);
+
+    int16_t right = data->width - layout->padding + 2;
+    int16_t x = data->width - layout->padding - 20 - GFX_getUTF8Width(&gfx, "3.2V") - 2;
+    snprintf(buf, sizeof(buf), "%.1fV", data->voltage);
+    right = MAX(right, x + GFX_getUTF8Width(&gfx, buf));
+
+    int16_t tx = data->width - layout->padding - GFX_getUTF8Width(&gfx, "25℃[1234]") - 2;
+    snprintf(buf, sizeof(buf), "%d℃[%s]", data->temperature, &data->ssid[MAX((int)strlen(data->ssid) - 4, 0)]);
+    right = MAX(right, tx + GFX_getUTF8Width(&gfx, buf));
+
+    rect->x = MAX(MIN(x, tx), 0);
+    rect->y = 34 - GFX_getFontAscent(&gfx);
+    rect->w = MIN(right, data->width) - rect->x;
+    rect->h = 58 - GFX_getFontDescent(&gfx) + 1 - rect->y;
+}
+
+static void UnionRect(gui_rect_t *rect, gui_rect_t *other)
+{
+    if (other->w == 0 || other->h == 0) return;
+    if (rect->w == 0 || rect->h == 0) {
+        *rect = *other;
+        return;
+    }
+    uint16_t xe = MAX(rect->x + rect->w, other->x + other->w);
+    uint16_t ye = MAX(rect->y + rect->h, other->y + other->h);
+    rect->x = MIN(rect->x, other->x);
+    rect->y = MIN(rect->y, other->y);
+    rect->w = xe - rect->x;
+    rect->h = ye - rect->y;
+}
+
+bool GetGUIDirtyRect(gui_data_t *prev, gui_data_t *data, gui_rect_t *rect)
+{
+    memset(rect, 0, sizeof(gui_rect_t));
+
+    // Only the clock face supports partial updates, the date line changes at midnight
+    if (prev->mode != MODE_CLOCK || data->mode != MODE_CLOCK ||
+        prev->color != data->color || prev->width != data->width || prev->height != data->height ||
+        prev->timestamp / SEC_PER_DY != data->timestamp / SEC_PER_DY)
+        return false;
+
+    clock_layout_t layout;
+    GetClockLayout(data, &layout);
 
+    // Time digits
+    tm_t prev_tm, tm;
+    transformTime(prev->timestamp, &prev_tm);
     transformTime(data->timestamp, &tm);
+    uint8_t prev_digits[4] = { prev_tm.tm_hour / 10, prev_tm.tm_hour % 10, prev_tm.tm_min / 10, prev_tm.tm_min % 10 };
+    uint8_t digits[4] = { tm.tm_hour / 10, tm.tm_hour % 10, tm.tm_min / 10, tm.tm_min % 10 };
+    for (uint8_t i = 0; i < 4; i++) {
+        if (prev_digits[i] == digits[i]) continue;
+        gui_rect_t digit = {
+            .x = GetClockDigitX(&layout, i),
+            .y = layout.time_y,
+            .w = 9 * layout.cS + 2,
+            .h = 20 * layout.cS + 4,
+        };
+        UnionRect(rect, &digit);
+    }
+
+    // Battery and temperature
+    char prev_voltage[8], voltage[8];
+    snprintf(prev_voltage, sizeof(prev_voltage), "%.1f", prev->voltage);
+    snprintf(voltage, sizeof(voltage), "%.1f", data->voltage);
+    if (prev->battery != data->battery || strcmp(prev_voltage, voltage) != 0 ||
+        prev->temperature != data->temperature || strcmp(prev->ssid, data->ssid) != 0) {
+        gui_rect_t status;
+        GetClockStatusRect(prev, &layout, &status);
+        UnionRect(rect, &status);
+        GetClockStatusRect(data, &layout, &status);
+        UnionRect(rect, &status);
+    }
+
+    if (rect->w > 0) {
+        rect->w += rect->x % 8;
+        rect->x -= rect->x % 8;
+        if (rect->w % 8 > 0) rect->w += 8 - (rect->w % 8);
+        rect->w = MIN(rect->w, data->width - rect->x);
+        rect->h = MIN(rect->h, data->height - rect->y);
+    }
+
+    return true;
+}
 
+#define OVERLAY_MARGIN  8
+#define OVERLAY_PADDING 4
+
+typedef struct {
+    gui_rect_t box;    // badge, not byte aligned
+    int16_t clock_w;   // 0 if not shown
+    int16_t battery_w; // 0 if not shown
+} overlay_layout_t;
+
+static bool GetOverlayLayout(gui_data_t *data, overlay_layout_t *layout)
+{
     Adafruit_GFX gfx;
-    int16_t ph = (__HEAP_SIZE - 512) / (data->width / 8);
+    int16_t h = 0;
+
+    memset(layout, 0, sizeof(overlay_layout_t));
+    memset(&gfx, 0, sizeof(Adafruit_GFX));
+    if (data->overlay & GUI_OVERLAY_CLOCK) {
+        GFX_setFont(&gfx, u8g2_font_helvB18_tn);
+        layout->clock_w = GFX_getUTF8Width(&gfx, "00:00"); // digits have the same width
+        h = GFX_getFontAscent(&gfx);
+    }
+    if (data->overlay & GUI_OVERLAY_BATTERY) {
+        GFX_setFont(&gfx, u8g2_font_wqy9_t_lunar);
+        layout->battery_w = GFX_getUTF8Width(&gfx, "3.2V") + 2 + 20 + 2; // see DrawBattery
+        h = MAX(h, 10);
+    }
+    if (h == 0) return false;
+
+    layout->box.w = 2 * OVERLAY_PADDING + layout->clock_w + layout->battery_w;
+    if (layout->clock_w > 0 && layout->battery_w > 0) layout->box.w += 2 * OVERLAY_PADDING;
+    layout->box.h = 2 * OVERLAY_PADDING + h;
+    if (layout->box.w + OVERLAY_MARGIN > data->width || layout->box.h + OVERLAY_MARGIN > data->height)
+        return false;
+    layout->box.x = data->width - OVERLAY_MARGIN - layout->box.w;
+    layout->box.y = data->height - OVERLAY_MARGIN - layout->box.h;
+    return true;
+}
 
+// White badge with rounded corners, the picture shows around it
+static void DrawOverlay(Adafruit_GFX *gfx, tm_t *tm, gui_data_t *data, overlay_layout_t *layout)
+{
+    gui_rect_t *box = &layout->box;
+
+    GFX_fillRoundRect(gfx, box->x, box->y, box->w, box->h, 3, GFX_WHITE);
+    GFX_drawRoundRect(gfx, box->x, box->y, box->w, box->h, 3, GFX_BLACK);
+    GFX_setTextColor(gfx, GFX_BLACK, GFX_WHITE);
+    if (layout->clock_w > 0) {
+        GFX_setFont(gfx, u8g2_font_helvB18_tn);
+        GFX_setCursor(gfx, box->x + OVERLAY_PADDING, box->y + (box->h + GFX_getFontAscent(gfx)) / 2);
+        GFX_printf(gfx, "%02d:%02d", tm->tm_hour, tm->tm_min);
+    }
+    if (layout->battery_w > 0)
+        DrawBattery(gfx, box->x + box->w - OVERLAY_PADDING - 2, box->y + (box->h - 10) / 2, 20, data->voltage, data->battery);
+}
+
+void GetGUIOverlayRect(gui_data_t *data, gui_rect_t *rect)
+{
+    overlay_layout_t layout;
+
+    memset(rect, 0, sizeof(gui_rect_t));
+    if (!GetOverlayLayout(data, &layout)) return;
+    *rect = layout.box;
+    rect->w += rect->x % 8;
+    rect->x -= rect->x % 8;
+    if (rect->w % 8 > 0) rect->w += 8 - (rect->w % 8);
+    rect->w = MIN(rect->w, data->width - rect->x);
+}
+
+// Page buffer for the colors of the panel, the full frame if it fits in the GFX arena
+static void BeginGFX(Adafruit_GFX *gfx, gui_data_t *data)
+{
     if (data->color == 2)
-      GFX_begin_3c(&gfx, data->width, data->height, ph);
+      GFX_begin_3c(gfx, data->width, data->height, 0);
     else if (data->color == 3)
-      GFX_begin_4c(&gfx, data->width, data->height, ph);
+      GFX_begin_4c(gfx, data->width, data->height, 0);
     else
-      GFX_begin(&gfx, data->width, data->height, ph);
+      GFX_begin(gfx, data->width, data->height, 0);
+}
+
+static int16_t DrawGUIWindow(gui_data_t *data, gui_rect_t *rect, buffer_callback callback, void *callback_data)
+{
+    if (data->week_start > 6) data->week_start = 0;
+
+    tm_t tm = {0};
+    struct Lunar_Date Lunar;
+
+    transformTime(data->timestamp, &tm);
+
+    Adafruit_GFX gfx;
+
+    BeginGFX(&gfx, data);
+    if (rect != NULL)
+      GFX_setWindow(&gfx, rect->x, rect->y, rect->w, rect->h);
 
     GFX_firstPage(&gfx);
     do {
@@ -464,4 +726,39 @@ void DrawGUI(gui_data_t *data, buffer_callback callback, void *callback_data)
     } while(GFX_nextPage(&gfx, callback, callback_data));
 
     GFX_end(&gfx);
+
+    return gfx.total_pages;
+}
+
+int16_t DrawGUI(gui_data_t *data, buffer_callback callback, void *callback_data)
+{
+    return DrawGUIWindow(data, NULL, callback, callback_data);
+}
+
+int16_t DrawGUIPartial(gui_data_t *data, gui_rect_t *rect, buffer_callback callback, void *callback_data)
+{
+    if (rect->w == 0 || rect->h == 0) return 0;
+    return DrawGUIWindow(data, rect, callback, callback_data);
+}
+
+int16_t DrawGUIOverlay(gui_data_t *data, gui_rect_t *rect, buffer_callback read, buffer_callback write, void *callback_data)
+{
+    overlay_layout_t layout;
+    tm_t tm = {0};
+    Adafruit_GFX gfx;
+
+    if (rect->w == 0 || rect->h == 0 || !GetOverlayLayout(data, &layout)) return 0;
+    transformTime(data->timestamp, &tm);
+
+    BeginGFX(&gfx, data);
+    GFX_setWindow(&gfx, rect->x, rect->y, rect->w, rect->h);
+    GFX_firstPage(&gfx);
+    do {
+        GFX_loadPage(&gfx, read, callback_data);
+        DrawOverlay(&gfx, &tm, data, &layout);
+    } while (GFX_nextPage(&gfx, write, callback_data));
+
+    GFX_end(&gfx);
+
+    return gfx.total_pages;
 }
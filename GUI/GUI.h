@@ -9,6 +9,19 @@ typedef enum {
     MODE_CLOCK = 2,
 } display_mode_t;
 
+// Holidays of a year: 2 bits per day (HOLIDAY_*), day n of the year in bits 2 * (n % 4) of byte n / 4
+#define HOLIDAY_BITMAP_SIZE 92
+
+typedef enum {
+    HOLIDAY_NONE = 0,
+    HOLIDAY_OFF = 1,   // 休
+    HOLIDAY_WORK = 2,  // 班, a weekend day worked
+} holiday_t;
+
+// Badges drawn over the picture in MODE_PICTURE (gui_data_t.overlay)
+#define GUI_OVERLAY_CLOCK   0x01
+#define GUI_OVERLAY_BATTERY 0x02
+
 typedef struct {
     display_mode_t mode;
     uint16_t color;
@@ -18,9 +31,33 @@ typedef struct {
     uint8_t week_start; // 0: Sunday, 1: Monday
     int8_t temperature;
     float voltage;
+    uint8_t battery;          // battery icon fill 0..100, EPD_VoltageLevel() on the device
     char ssid[20];
+    const uint8_t *holidays; // bitmap of the year of timestamp, NULL: built-in data
+    uint8_t overlay;         // GUI_OVERLAY_* bits, MODE_PICTURE only
 } gui_data_t;
 
-void DrawGUI(gui_data_t *data, buffer_callback callback, void *callback_data);
+typedef struct {
+    uint16_t x;
+    uint16_t y;
+    uint16_t w;
+    uint16_t h;
+} gui_rect_t;
+
+// Returns the number of pages rendered, 1 means the whole frame was drawn in a single pass.
+int16_t DrawGUI(gui_data_t *data, buffer_callback callback, void *callback_data);
+
+// Get the area that changed between two frames (x and w are byte aligned, w == 0 if nothing changed).
+// Returns false if the new frame needs a full redraw.
+bool GetGUIDirtyRect(gui_data_t *prev, gui_data_t *data, gui_rect_t *rect);
+// Draw only the pixels inside rect, the callback is invoked with the window area.
+int16_t DrawGUIPartial(gui_data_t *data, gui_rect_t *rect, buffer_callback callback, void *callback_data);
+
+// Area of the overlay at the bottom right (x and w are byte aligned, w == 0 if there is none),
+// the same for every value so that an update covers the previous badge.
+void GetGUIOverlayRect(gui_data_t *data, gui_rect_t *rect);
+// Draw the overlay over the image on the display: every page of rect is loaded with read,
+// drawn on and passed to write.
+int16_t DrawGUIOverlay(gui_data_t *data, gui_rect_t *rect, buffer_callback read, buffer_callback write, void *callback_data);
 
 #endif
@@ -28,139 +28,195 @@ const char Lunar_StemStrig[10][4] = {
 const char Lunar_BranchStrig[12][4] = {
     "申", "酉", "戌", "亥", "子", "丑", "寅", "卯", "辰", "巳", "午", "未"};
 
-/* 2000 ~ 2199  */
-const uint32_t lunar_month_days[] = {
-    1997,
-    0x0000B26D, 0x0000125C, 0x0000192C, 0x00009A95, 0x00001A94, 0x00001B4A, 0x00004B55, 0x00000AD4, 0x0000F55B,
-    0x000004BA, 0x0000125A, 0x0000B92B, 0x0000152A, 0x00001694, 0x000096AA, 0x000015AA, 0x00012AB5, 0x00000974,
-    0x000014B6, 0x0000CA57, 0x00000A56, 0x00001526, 0x00008E95, 0x00000D54, 0x000015AA, 0x000049B5, 0x0000096C,
-    0x0000D4AE, 0x0000149C, 0x00001A4C, 0x0000BD26, 0x00001AA6, 0x00000B54, 0x00006D6A, 0x000012DA, 0x0001695D,
-    0x0000095A, 0x0000149A, 0x0000DA4B, 0x00001A4A, 0x00001AA4, 0x0000BB54, 0x000016B4, 0x00000ADA, 0x0000495B,
-    0x00000936, 0x0000F497, 0x00001496, 0x0000154A, 0x0000B6A5, 0x00000DA4, 0x000015B4, 0x00006AB6, 0x0000126E,
-    /*0x0001092F, 0x0000092E, 0x00000C96, 0x0000CD4A, 0x00001D4A, 0x00000D64, 0x0000956C, 0x0000155C, 0x0000125C,
-    0x0000792E, 0x0000192C, 0x0000FA95, 0x00001A94, 0x00001B4A, 0x0000AB55, 0x00000AD4, 0x000014DA, 0x00008A5D,
-    0x00000A5A, 0x0001152B, 0x0000152A, 0x00001694, 0x0000D6AA, 0x000015AA, 0x00000AB4, 0x000094BA, 0x000014B6,
-    0x00000A56, 0x00007527, 0x00000D26, 0x0000EE53, 0x00000D54, 0x000015AA, 0x0000A9B5, 0x0000096C, 0x000014AE,
-    0x00008A4E, 0x00001A4C, 0x00011D26, 0x00001AA4, 0x00001B54, 0x0000CD6A, 0x00000ADA, 0x0000095C, 0x0000949D,
-    0x0000149A, 0x00001A2A, 0x00005B25, 0x00001AA4, 0x0000FB52, 0x000016B4, 0x00000ABA, 0x0000A95B, 0x00000936,
-    0x00001496, 0x00009A4B, 0x0000154A, 0x000136A5, 0x00000DA4, 0x000015AC, 0x0000CAB6, 0x0000126E, 0x0000092E,
-    0x00008C97, 0x00000A96, 0x00000D4A, 0x00006DA5, 0x00000D54, 0x0000F56A, 0x0000155A, 0x00000A5C, 0x0000B92E,
-    0x0000152C, 0x00001A94, 0x00009D4A, 0x00001B2A, 0x00016B55, 0x00000AD4, 0x000014DA, 0x0000CA5D, 0x00000A5A,
-    0x0000151A, 0x0000BA95, 0x00001654, 0x000016AA, 0x00004AD5, 0x00000AB4, 0x0000F4BA, 0x000014B6, 0x00000A56,
-    0x0000B517, 0x00000D16, 0x00000E52, 0x000096AA, 0x00000D6A, 0x000165B5, 0x0000096C, 0x000014AE, 0x0000CA2E,
-    0x00001A2C, 0x00001D16, 0x0000AD52, 0x00001B52, 0x00000B6A, 0x0000656D, 0x0000055C, 0x0000F45D, 0x0000145A,
-    0x00001A2A, 0x0000DA95, 0x000016A4, 0x00001AD2, 0x00008B5A, 0x00000AB6, 0x0001455B, 0x000008B6, 0x00001456,
-    0x0000D52B, 0x0000152A, 0x00001694, 0x0000B6AA, 0x000015AA, 0x00000AB6, 0x000064B7, 0x000008AE, 0x0000EC57,
-    0x00000A56, 0x00000D2A, 0x0000CD95, 0x00000B54, 0x0000156A, 0x00008A6D, 0x0000095C, 0x000014AE, 0x00004A56,
-    0x00001A54, 0x0000DD2A, 0x00001AAA, 0x00000B54, 0x0000B56A, 0x000014DA, 0x0000095C, 0x000074AB, 0x0000149A,
-    0x0000FA4B, 0x00001652, 0x000016AA, 0x0000CAD5, 0x000005B4*/};
-
-/* 2000 ~ 2199  */
-const uint32_t solar_1_1[] = {
-    1997,
-    0x000F9C3C, 0x000F9E50, 0x000FA045, 0x000FA238, 0x000FA44C, 0x000FA641, 0x000FA836, 0x000FAA49, 0x000FAC3D,
-    0x000FAE52, 0x000FB047, 0x000FB23A, 0x000FB44E, 0x000FB643, 0x000FB837, 0x000FBA4A, 0x000FBC3F, 0x000FBE53,
-    0x000FC048, 0x000FC23C, 0x000FC450, 0x000FC645, 0x000FC839, 0x000FCA4C, 0x000FCC41, 0x000FCE36, 0x000FD04A,
-    0x000FD23D, 0x000FD451, 0x000FD646, 0x000FD83A, 0x000FDA4D, 0x000FDC43, 0x000FDE37, 0x000FE04B, 0x000FE23F,
-    0x000FE453, 0x000FE648, 0x000FE83C, 0x000FEA4F, 0x000FEC44, 0x000FEE38, 0x000FF04C, 0x000FF241, 0x000FF436,
-    0x000FF64A, 0x000FF83E, 0x000FFA51, 0x000FFC46, 0x000FFE3A, 0x0010004E, 0x00100242, 0x00100437, 0x0010064B,
-    /*0x00100841, 0x00100A53, 0x00100C48, 0x00100E3C, 0x0010104F, 0x00101244, 0x00101438, 0x0010164C, 0x00101842,
-    0x00101A35, 0x00101C49, 0x00101E3D, 0x00102051, 0x00102245, 0x0010243A, 0x0010264E, 0x00102843, 0x00102A37,
-    0x00102C4B, 0x00102E3F, 0x00103053, 0x00103247, 0x0010343B, 0x0010364F, 0x00103845, 0x00103A38, 0x00103C4C,
-    0x00103E42, 0x00104036, 0x00104249, 0x0010443D, 0x00104651, 0x00104846, 0x00104A3A, 0x00104C4E, 0x00104E43,
-    0x00105038, 0x0010524A, 0x0010543E, 0x00105652, 0x00105847, 0x00105A3B, 0x00105C4F, 0x00105E45, 0x00106039,
-    0x0010624C, 0x00106441, 0x00106635, 0x00106849, 0x00106A3D, 0x00106C51, 0x00106E47, 0x0010703C, 0x0010724F,
-    0x00107444, 0x00107638, 0x0010784C, 0x00107A3F, 0x00107C53, 0x00107E48, 0x0010803D, 0x00108250, 0x00108446,
-    0x0010863A, 0x0010884E, 0x00108A42, 0x00108C36, 0x00108E4A, 0x0010903E, 0x00109251, 0x00109447, 0x0010963B,
-    0x0010984F, 0x00109A43, 0x00109C37, 0x00109E4B, 0x0010A041, 0x0010A253, 0x0010A448, 0x0010A63D, 0x0010A851,
-    0x0010AA45, 0x0010AC39, 0x0010AE4D, 0x0010B042, 0x0010B236, 0x0010B44A, 0x0010B63E, 0x0010B852, 0x0010BA47,
-    0x0010BC3B, 0x0010BE4F, 0x0010C044, 0x0010C237, 0x0010C44B, 0x0010C641, 0x0010C854, 0x0010CA48, 0x0010CC3D,
-    0x0010CE50, 0x0010D045, 0x0010D239, 0x0010D44C, 0x0010D642, 0x0010D837, 0x0010DA4A, 0x0010DC3E, 0x0010DE52,
-    0x0010E047, 0x0010E23A, 0x0010E44E, 0x0010E643, 0x0010E838, 0x0010EA4B, 0x0010EC41, 0x0010EE54, 0x0010F049,
-    0x0010F23C, 0x0010F450, 0x0010F645, 0x0010F839, 0x0010FA4C, 0x0010FC42, 0x0010FE37, 0x0011004B, 0x0011023E,
-    0x00110452, 0x00110647, 0x0011083B, 0x00110A4E, 0x00110C43, 0x00110E38, 0x0011104C, 0x0011123F, 0x00111435,
-    0x00111648, 0x0011183C, 0x00111A4F, 0x00111C45, 0x00111E39, 0x0011204D, 0x00112242, 0x00112436, 0x0011264A,
-    0x0011283E, 0x00112A51, 0x00112C46, 0x00112E3B, 0x0011304F*/};
+/* 1999 ~ 2199
+ * 每个农历年 17 位, 高位在前, 逐年紧密排列: 高 4 位为闰月月份 (0: 无闰月),
+ * 其余 13 位依次为各月大小 (1: 30 天), 即 bit 16~13 为闰月, bit (12 - i) 为第 i 个月.
+ * 正月初一不再单独存储, 由 1999 年正月初一逐年累加各月天数得到.
+ */
+static const uint8_t lunar_year_data[428] = {
+    0x09, 0x2E, 0x06, 0x4B, 0x13, 0x52, 0xA1, 0xA9, 0x40, 0xDA, 0x51, 0x2D, 0x54, 0x15, 0xA8, 0xF5, 0x5B, // 1999 ~ 2006
+    0x02, 0x5D, 0x04, 0x96, 0x97, 0x25, 0x61, 0x52, 0xA0, 0xB4, 0xA2, 0x5A, 0xA8, 0x2B, 0x55, 0x2A, 0xB5, // 2007 ~ 2014
+    0x04, 0xBA, 0x05, 0x2D, 0x99, 0x4A, 0xE0, 0xA5, 0x60, 0xA9, 0x32, 0x3A, 0x54, 0x1A, 0xA8, 0x15, 0xAA, // 2015 ~ 2022
+    0x24, 0xDA, 0x82, 0x5B, 0x1A, 0x95, 0xC1, 0x49, 0xC0, 0xD2, 0x62, 0xF4, 0x98, 0x35, 0x4C, 0x0B, 0x54, // 2023 ~ 2030
+    0x36, 0xB5, 0x04, 0xB6, 0xAD, 0x2B, 0xA0, 0x95, 0xA0, 0xA4, 0xD3, 0x69, 0x2C, 0x34, 0x94, 0x1A, 0xA4, // 2031 ~ 2038
+    0x5D, 0xAA, 0x05, 0xAD, 0x01, 0x5B, 0x44, 0x95, 0xB0, 0x49, 0xB3, 0xD2, 0x5C, 0x29, 0x2C, 0x15, 0x4A, // 2039 ~ 2046
+    0x5B, 0x52, 0x83, 0x69, 0x02, 0xB6, 0x86, 0xAB, 0x60, 0x93, 0x74, 0x24, 0xBC, 0x12, 0x5C, 0x0C, 0x96, // 2047 ~ 2054
+    0x66, 0xA5, 0x07, 0x52, 0x81, 0xAC, 0x89, 0x56, 0xC0, 0xAA, 0xE0, 0x49, 0x70, 0xF2, 0x5C, 0x19, 0x2C, // 2055 ~ 2062
+    0x7D, 0x4A, 0x86, 0xA5, 0x03, 0x69, 0x4A, 0xB5, 0x50, 0x56, 0xA0, 0x53, 0x69, 0x14, 0xBA, 0x0A, 0x5A, // 2063 ~ 2070
+    0x8A, 0x95, 0x85, 0x4A, 0x82, 0xD2, 0x8D, 0x6A, 0xA0, 0xAD, 0x50, 0x2A, 0xD1, 0x29, 0x74, 0x14, 0xB6, // 2071 ~ 2078
+    0x05, 0x2B, 0x1D, 0x49, 0xC1, 0xA4, 0xCE, 0xE5, 0x30, 0x6A, 0xA0, 0x56, 0xA9, 0x53, 0x6A, 0x09, 0x6C, // 2079 ~ 2086
+    0x0A, 0x57, 0x22, 0x93, 0x83, 0x49, 0x91, 0xD2, 0x60, 0xD5, 0x20, 0x6D, 0x51, 0x9A, 0xD4, 0x0A, 0xDA, // 2087 ~ 2094
+    0x04, 0xAE, 0x25, 0x27, 0x42, 0x93, 0x41, 0xA2, 0xA2, 0xD9, 0x28, 0x6A, 0x91, 0xF6, 0xA4, 0x16, 0xB4, // 2095 ~ 2102
+    0x05, 0x5D, 0x2A, 0x56, 0xC1, 0x26, 0xC1, 0x49, 0x64, 0xD2, 0x58, 0x55, 0x2A, 0x6D, 0x4A, 0x0D, 0xA4, // 2103 ~ 2110
+    0x0A, 0xD6, 0x32, 0xAD, 0x82, 0x4D, 0xC0, 0x92, 0xE4, 0x64, 0xB8, 0x2A, 0x58, 0x1A, 0x94, 0x6D, 0xA5, // 2111 ~ 2118
+    0x06, 0xAA, 0x3D, 0x5A, 0x82, 0xAB, 0x40, 0xA5, 0xC5, 0xC9, 0x70, 0x54, 0xB0, 0x35, 0x28, 0x9D, 0x4A, // 2119 ~ 2126
+    0x0D, 0x95, 0x5A, 0xD5, 0x41, 0x5A, 0x81, 0x4D, 0xA6, 0x52, 0xE8, 0x29, 0x68, 0x2A, 0x34, 0xBA, 0x95, // 2127 ~ 2134
+    0x0B, 0x2A, 0x05, 0xAA, 0x89, 0x5A, 0xA0, 0xAB, 0x47, 0xA5, 0xD0, 0x52, 0xD8, 0x14, 0xAC, 0xB5, 0x17, // 2135 ~ 2142
+    0x06, 0x8B, 0x03, 0x94, 0x92, 0xD5, 0x40, 0xD6, 0xAB, 0x2D, 0xA8, 0x25, 0xB0, 0x29, 0x5C, 0xCA, 0x2E, // 2143 ~ 2150
+    0x0D, 0x16, 0x07, 0x45, 0x95, 0xAA, 0x41, 0xB5, 0x20, 0x5B, 0x51, 0x95, 0xB4, 0x0A, 0xB8, 0xF4, 0x5D, // 2151 ~ 2158
+    0x0A, 0x2D, 0x06, 0x8A, 0x9B, 0x52, 0xA1, 0x6A, 0x40, 0xD6, 0x92, 0x2D, 0x68, 0x15, 0x6D, 0x45, 0x5B, // 2159 ~ 2166
+    0x04, 0x5B, 0x05, 0x15, 0x9A, 0xA5, 0x61, 0x52, 0xA0, 0xB4, 0xA2, 0xDA, 0xA8, 0x2B, 0x54, 0x0A, 0xB6, // 2167 ~ 2174
+    0x32, 0x5B, 0x82, 0x2B, 0x9D, 0x8A, 0xE0, 0xA5, 0x60, 0x69, 0x53, 0x36, 0x54, 0x16, 0xA8, 0x15, 0x6A, // 2175 ~ 2182
+    0x45, 0x36, 0x82, 0x57, 0x02, 0x95, 0xC4, 0xA5, 0x60, 0xD2, 0xA3, 0x74, 0xA8, 0x35, 0x54, 0x0B, 0x54, // 2183 ~ 2190
+    0x5A, 0xB5, 0x05, 0x36, 0x81, 0x2B, 0x87, 0x4A, 0xB0, 0xA4, 0xD3, 0xE9, 0x2C, 0x2C, 0xA4, 0x16, 0xAA, // 2191 ~ 2198
+    0x65, 0x6A, 0x80, // 2199
+};
+
+#define LUNAR_BASE_YEAR 1999
+#define LUNAR_YEARS 201
+#define LUNAR_YEAR_BITS 17
+#define LUNAR_BASE_NEW_YEAR 10638 // 1999-02-16, days_from_civil()
+
+// 最近一次推算的正月初一
+static struct
+{
+    uint16_t index;
+    uint32_t new_year;
+} m_lunar_new_year = {0, LUNAR_BASE_NEW_YEAR};
 
 static uint32_t GetBitInt(uint32_t data, uint8_t length, uint8_t shift)
 {
     return (data & (((1 << length) - 1) << shift)) >> shift;
 }
 
-// WARNING: Dates before Oct. 1582 are inaccurate
-static uint16_t SolarToInt(uint16_t y, uint8_t m, uint8_t d)
+static uint8_t LunarMonthDays(uint32_t days, uint8_t index)
 {
-    m = (m + 9) % 12;
-    y = y - m / 10;
-    return 365 * y + y / 4 - y / 100 + y / 400 + (m * 306 + 5) / 10 + (d - 1);
+    return GetBitInt(days, 1, 12 - index) == 1 ? 30 : 29;
 }
 
-void LUNAR_SolarToLunar(struct Lunar_Date *lunar, uint16_t solar_year, uint8_t solar_month, uint8_t solar_date)
+static uint8_t LunarMonthCount(uint32_t days)
+{
+    return GetBitInt(days, 4, 13) != 0 ? 13 : 12;
+}
+
+// 17 位最多跨 3 个字节
+static uint32_t LunarYearData(uint16_t index)
 {
-    uint8_t i, lunarM, m, d, leap, dm;
-    uint16_t year_index, lunarY, y, offset;
-    uint32_t solar_data, solar11, days;
+    uint32_t bit = (uint32_t)index * LUNAR_YEAR_BITS;
+    const uint8_t *p = &lunar_year_data[bit >> 3];
+    uint32_t data = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
 
-    if (solar_month < 1 || solar_month > 12 || solar_date < 1 || solar_date > 31 ||
-        (solar_year - solar_1_1[0] < 3) || ((solar_year - solar_1_1[0]) > (sizeof(solar_1_1) / sizeof(uint32_t) - 2)))
-    {
-        lunar->Year = 0;
-        lunar->Month = 0;
-        lunar->Date = 0;
-        lunar->IsLeap = 0;
-        return;
-    }
+    return (data >> (7 - (bit & 7))) & ((1 << LUNAR_YEAR_BITS) - 1);
+}
 
-    year_index = solar_year - solar_1_1[0];
-    solar_data = ((uint32_t)solar_year << 9) | ((uint32_t)solar_month << 5) | ((uint32_t)solar_date);
-    if (solar_1_1[year_index] > solar_data)
+// 每个大月多一天, 无闰月的年份第 13 个月的位为 0
+static uint16_t LunarYearDays(uint32_t days)
+{
+    uint16_t total = 29 * LunarMonthCount(days);
+
+    for (days &= 0x1FFF; days != 0; days >>= 1)
+        total += days & 1;
+    return total;
+}
+
+// 正月初一 (days_from_civil), 从缓存的年份向后累加各年天数, 往前查时从 1999 年重新推算
+static uint32_t LunarNewYear(uint16_t index)
+{
+    if (m_lunar_new_year.index > index)
     {
-        year_index -= 1;
+        m_lunar_new_year.index = 0;
+        m_lunar_new_year.new_year = LUNAR_BASE_NEW_YEAR;
     }
-    solar11 = solar_1_1[year_index];
-    y = GetBitInt(solar11, 12, 9);
-    m = GetBitInt(solar11, 4, 5);
-    d = GetBitInt(solar11, 5, 0);
-    offset = SolarToInt(solar_year, solar_month, solar_date) - SolarToInt(y, m, d);
-
-    days = lunar_month_days[year_index];
-    leap = GetBitInt(days, 4, 13);
-
-    lunarY = year_index + solar_1_1[0];
-    lunarM = 1;
-    offset += 1;
-    for (i = 0; i < 13; i++)
+    for (; m_lunar_new_year.index < index; m_lunar_new_year.index++)
+        m_lunar_new_year.new_year += LunarYearDays(LunarYearData(m_lunar_new_year.index));
+    return m_lunar_new_year.new_year;
+}
+
+static void LunarIterInvalidate(lunar_iter_t *iter)
+{
+    iter->date.Year = 0;
+    iter->date.Month = 0;
+    iter->date.Date = 0;
+    iter->date.IsLeap = 0;
+}
+
+// 根据年索引和月序号更新农历年、月及闰月标志
+static void LunarIterUpdate(lunar_iter_t *iter, uint32_t data)
+{
+    uint8_t leap = GetBitInt(data, 4, 13);
+    uint8_t lunarM = iter->month_index + 1;
+
+    iter->date.IsLeap = 0;
+    if (leap != 0 && lunarM > leap)
     {
-        if (GetBitInt(days, 1, 12 - i) == 1)
-        {
-            dm = 30;
-        }
-        else
-        {
-            dm = 29;
-        }
-        if (offset > dm)
-        {
-            lunarM += 1;
-            offset -= dm;
-        }
-        else
+        if (lunarM == leap + 1)
         {
-            break;
+            iter->date.IsLeap = 1;
         }
+        lunarM -= 1;
     }
-    lunar->IsLeap = 0;
-    if (leap != 0 && lunarM > leap)
+    iter->date.Month = lunarM;
+    iter->date.Year = iter->year_index + LUNAR_BASE_YEAR;
+}
+
+void LUNAR_IterInit(lunar_iter_t *iter, uint16_t solar_year, uint8_t solar_month, uint8_t solar_date)
+{
+    if (solar_month < 1 || solar_month > 12 || solar_date < 1 || solar_date > 31 ||
+        solar_year <= LUNAR_BASE_YEAR || solar_year >= LUNAR_BASE_YEAR + LUNAR_YEARS)
     {
-        if (lunarM == leap + 1)
+        LunarIterInvalidate(iter);
+        return;
+    }
+
+    // 从上一个农历年的正月初一逐月前进到公历日期
+    iter->year_index = solar_year - LUNAR_BASE_YEAR - 1;
+    iter->month_index = 0;
+    iter->date.Year = solar_year - 1;
+    iter->date.Date = 1;
+    LUNAR_IterAdvance(iter, days_from_civil(solar_year, solar_month, solar_date) - LunarNewYear(iter->year_index));
+}
+
+// 前进一天，只有跨月时才需要重新计算月份
+void LUNAR_IterNext(lunar_iter_t *iter)
+{
+    if (iter->date.Year == 0)
+        return;
+
+    if (iter->date.Date < LunarMonthDays(LunarYearData(iter->year_index), iter->month_index))
+        iter->date.Date++;
+    else
+        LUNAR_IterAdvance(iter, 1);
+}
+
+// 前进 N 天，逐月跳过，不再从每年正月初一重新推算
+void LUNAR_IterAdvance(lunar_iter_t *iter, uint16_t days)
+{
+    uint32_t data;
+    uint32_t offset;
+    uint8_t dm;
+
+    if (iter->date.Year == 0)
+        return;
+
+    data = LunarYearData(iter->year_index);
+    offset = (uint32_t)iter->date.Date + days;
+    for (;;)
+    {
+        dm = LunarMonthDays(data, iter->month_index);
+        if (offset <= dm)
+            break;
+        offset -= dm;
+        if (++iter->month_index >= LunarMonthCount(data))
         {
-            lunar->IsLeap = 1;
+            iter->month_index = 0;
+            if (++iter->year_index >= LUNAR_YEARS)
+            {
+                LunarIterInvalidate(iter);
+                return;
+            }
+            data = LunarYearData(iter->year_index);
         }
-        lunarM -= 1;
     }
-    lunar->Month = lunarM;
-    lunar->Date = offset;
-    lunar->Year = lunarY;
+    iter->date.Date = offset;
+    LunarIterUpdate(iter, data);
+}
+
+void LUNAR_SolarToLunar(struct Lunar_Date *lunar, uint16_t solar_year, uint8_t solar_month, uint8_t solar_date)
+{
+    lunar_iter_t iter;
+
+    LUNAR_IterInit(&iter, solar_year, solar_month, solar_date);
+    *lunar = iter.date;
 }
 
 uint8_t LUNAR_GetZodiac(const struct Lunar_Date *lunar)
@@ -184,75 +240,32 @@ uint8_t LUNAR_GetBranch(const struct Lunar_Date *lunar)
  ********************************************************************************************************/
 
 /*
- 每年24节气标志表
- 有兴趣的朋友可按照上面给的原理添加其它年份的表格
- 不是很清楚的朋友可给我发EMAIL
+ 2000 ~ 2199 年24节气日期表
+ 节气时刻按年线性近似: 2000-01-01 起的第 15 * JQ + (offset + n * 1496032 + slope * n / 25) / 4096 天,
+ n 为距 2000 年的年数, 1496032 / 4096 即一个回归年 365.2422 天; offset 单位 1/4096 天, slope 单位 1/1024 天每百年.
+ 近似与天文计算结果 (北京时间) 相比只有 jieqi_late 中列出的节气 (n * 24 + JQ) 晚一天.
  */
-static const uint8_t YearMonthBit[160] =
-    {
-        0x4E, 0xA6, 0x99, // 2000
-        0x9C, 0xA2, 0x98, // 2001
-        0x80, 0x00, 0x18, // 2002
-        0x00, 0x10, 0x24, // 2003
-        0x4E, 0xA6, 0x99, // 2004
-        0x9C, 0xA2, 0x98, // 2005
-        0x80, 0x82, 0x18, // 2006
-        0x00, 0x10, 0x24, // 2007
-        0x4E, 0xA6, 0xD9, // 2008
-        0x9E, 0xA2, 0x98, // 2009
-
-        0x80, 0x82, 0x18, // 2010
-        0x00, 0x10, 0x04, // 2011
-        0x4E, 0xE6, 0xD9, // 2012
-        0x9E, 0xA6, 0xA8, // 2013
-        0x80, 0x82, 0x18, // 2014
-        0x00, 0x10, 0x00, // 2015
-        0x0F, 0xE6, 0xD9, // 2016
-        0xBE, 0xA6, 0x98, // 2017
-        0x88, 0x82, 0x18, // 2018
-        0x80, 0x00, 0x00, // 2019
-
-        0x0F, 0xEF, 0xD9, // 2020
-        0xBE, 0xA6, 0x99, // 2021
-        0x8C, 0x82, 0x98, // 2022
-        0x80, 0x00, 0x00, // 2023
-        0x0F, 0xEF, 0xDB, // 2024
-        0xBE, 0xA6, 0x99, // 2025
-        0x9C, 0xA2, 0x98, // 2026
-        0x80, 0x00, 0x18, // 2027
-        0x0F, 0xEF, 0xDB, // 2028
-        0xBE, 0xA6, 0x99, // 2029
-
-        0x9C, 0xA2, 0x98, // 2030
-        0x80, 0x00, 0x18, // 2031
-        0x0F, 0xEF, 0xDB, // 2032
-        0xBE, 0xA2, 0x99, // 2033
-        0x8C, 0xA0, 0x98, // 2034
-        0x80, 0x82, 0x18, // 2035
-        0x0B, 0xEF, 0xDB, // 2036
-        0xBE, 0xA6, 0x99, // 2037
-        0x8C, 0xA2, 0x98, // 2038
-        0x80, 0x82, 0x18, // 2039
-
-        0x0F, 0xEF, 0xDB, // 2040
-        0xBE, 0xE6, 0xD9, // 2041
-        0x9E, 0xA2, 0x98, // 2042
-        0x80, 0x82, 0x18, // 2043
-        0x0F, 0xEF, 0xFB, // 2044
-        0xBF, 0xE6, 0xD9, // 2045
-        0x9E, 0xA6, 0x98, // 2046
-        0x80, 0x82, 0x18, // 2047
-        0x0F, 0xFF, 0xFF, // 2048
-        0xFC, 0xEF, 0xD9, // 2049
-        0xBE, 0xA6, 0x18, // 2050
+static const uint16_t jieqi_offset[24] = {
+    21987, 20881, 19864, 19200, 18864, 18997,
+    19647, 20891, 22618, 24845, 27445, 30299,
+    33320, 36265, 39082, 41579, 43638, 45250,
+    46348, 46852, 46811, 46417, 45660, 44624,
 };
-static const uint8_t days[24] =
-    {
-        6, 20, 4, 19, 6, 21, // 一月到三月  的节气基本日期
-        5, 20, 6, 21, 6, 21, // 四月到六月  的节气基本日期
-        7, 23, 8, 23, 8, 23, // 七月到九月  的节气基本日期
-        8, 24, 8, 22, 7, 22, // 十月到十二月的节气基本日期
+static const int8_t jieqi_slope[24] = {
+    55, 54, 50, 41, 30, 16,
+    1, -14, -29, -43, -54, -61,
+    -64, -63, -58, -49, -37, -23,
+    -8, 8, 22, 35, 45, 52,
+};
+// 实际比近似晚一天的节气
+static const uint16_t jieqi_late[] = {
+    1710, 2336, 2813, 3605, 4043,
 };
+
+#define JIEQI_BASE_YEAR 2000
+#define JIEQI_YEARS 200
+#define JIEQI_BASE_DAYS 10957 // 2000-01-01, days_from_civil()
+
 /*立春、雨水、惊蛰、春分、清明、谷雨、立夏、小满、芒种、夏至、小暑、大暑、立秋、处暑、白露、秋分、寒露、霜降、立冬、小雪、大雪、冬至、小寒、大寒
  *
  */
@@ -316,9 +329,11 @@ const uint8_t MonthDayMax[12] = {
  ********************************************************************************************************/
 uint8_t GetJieQi(uint16_t myear, uint8_t mmonth, uint8_t mday, uint8_t *JQdate)
 {
-    uint8_t bak1, value, JQ;
+    int32_t n = myear - JIEQI_BASE_YEAR;
+    uint32_t days;
+    uint8_t i, JQ;
 
-    if ((myear < 2000) || (myear > 2050))
+    if ((n < 0) || (n >= JIEQI_YEARS))
         return 0;
     if ((mmonth == 0) || (mmonth > 12))
         return 0;
@@ -326,18 +341,14 @@ uint8_t GetJieQi(uint16_t myear, uint8_t mmonth, uint8_t mday, uint8_t *JQdate)
     if (mday >= 15)
         JQ++; // 判断是否是上半月
 
-    bak1 = YearMonthBit[(myear - 2000) * 3 + JQ / 8]; // 获得节气日期相对值所在字节
-    value = ((bak1 << (JQ % 8)) & 0x80);              // 获得节气日期相对值状态
-
-    *JQdate = days[JQ];
-    if (value != 0)
+    days = JIEQI_BASE_DAYS + 15 * JQ +
+           (uint32_t)(jieqi_offset[JQ] + n * 1496032 + jieqi_slope[JQ] * n / 25) / 4096;
+    for (i = 0; i < sizeof(jieqi_late) / sizeof(jieqi_late[0]); i++)
     {
-        // 判断年份,以决定节气相对值1代表1,还是－1。
-        if ((JQ == 1 || JQ == 11 || JQ == 18 || JQ == 21) && myear < 2044)
-            (*JQdate)++;
-        else
-            (*JQdate)--;
+        if (jieqi_late[i] == n * 24 + JQ)
+            days++;
     }
+    *JQdate = days - days_from_civil(myear, mmonth, 1) + 1;
     return 1;
 }
 
@@ -393,12 +404,7 @@ uint8_t GetJieQiStr(uint16_t myear, uint8_t mmonth, uint8_t mday, uint8_t *day)
         }
         else // 翻月
         {
-            MaxDay = MonthDayMax[mmonth - 1];
-            if (mmonth == 2) // 润月问题
-            {
-                if ((myear % 4 == 0) && ((myear % 100 != 0) || (myear % 400 == 0)))
-                    MaxDay++;
-            }
+            MaxDay = thisMonthMaxDays(myear, mmonth);
             if (++mmonth == 13)
                 mmonth = 1;
             GetJieQi(myear, mmonth, 1, &JQdate);
@@ -409,15 +415,6 @@ uint8_t GetJieQiStr(uint16_t myear, uint8_t mmonth, uint8_t mday, uint8_t *day)
     return JQ;
 }
 
-uint32_t SEC_PER_YR[2] = {31536000, 31622400}; // 闰年和非闰年的秒数
-uint32_t SEC_PER_MT[2][12] = {
-    {2678400, 2419200, 2678400, 2592000, 2678400, 2592000,
-     2678400, 2678400, 2592000, 2678400, 2592000, 2678400},
-    {2678400, 2505600, 2678400, 2592000, 2678400, 2592000,
-     2678400, 2678400, 2592000, 2678400, 2592000, 2678400},
-};
-#define SECOND_OF_DAY 86400 // 一天多少秒
-
 /**
  * @Name       : static int is_leap(int yr)
  * @Description: 判断是否为闰年
@@ -452,37 +449,63 @@ unsigned char day_of_week_get(unsigned char month, unsigned char day,
     return (year + year / 4 - year / 100 + year / 400 + t[month - 1] + day) % 7;
 }
 
-void transformTime(uint32_t unix_time, struct devtm *result)
+/*********************************************************************************************************
+ ** 公历日期与天数互换 (相对 1970-01-01)，整数运算，不依赖 libc 的 mktime/gmtime
+ ** 算法: http://howardhinnant.github.io/date_algorithms.html
+ ** 3 月作为一年的第一个月，闰日落在年末，400 年 (146097 天) 为一个周期
+ ********************************************************************************************************/
+uint32_t days_from_civil(uint16_t year, uint8_t month, uint8_t day)
 {
-    int leapyr = 0;
-    uint32_t ltime = unix_time;
+    uint32_t y = year - (month <= 2);
+    uint32_t era = y / 400;
+    uint32_t yoe = y - era * 400;                                     // [0, 399]
+    uint32_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1; // [0, 365]
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;             // [0, 146096]
+    return era * 146097 + doe - 719468;
+}
 
-    memset(result, 0, sizeof(struct devtm));
-    result->tm_year = EPOCH_YR;
+void civil_from_days(uint32_t days, uint16_t *year, uint8_t *month, uint8_t *day)
+{
+    uint32_t z = days + 719468;
+    uint32_t era = z / 146097;
+    uint32_t doe = z - era * 146097;                                  // [0, 146096]
+    uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365; // [0, 399]
+    uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);           // [0, 365]
+    uint32_t mp = (5 * doy + 2) / 153;                                // [0, 11]
+    uint8_t m = mp < 10 ? mp + 3 : mp - 9;
+
+    *day = doy - (153 * mp + 2) / 5 + 1;
+    *month = m;
+    *year = yoe + era * 400 + (m <= 2);
+}
 
-    while (1)
-    {
-        if (ltime < SEC_PER_YR[is_leap(result->tm_year)])
-        {
-            break;
-        }
-        ltime -= SEC_PER_YR[is_leap(result->tm_year)];
-        ++(result->tm_year);
-    }
+// 1970-01-01 是星期四
+uint8_t weekday_from_days(uint32_t days)
+{
+    return (days + 4) % 7;
+}
 
-    leapyr = is_leap(result->tm_year);
+// ISO 8601 周数: 每周从星期一开始，包含当年第一个星期四的那一周为第 1 周
+uint8_t week_of_year(uint16_t year, uint8_t month, uint8_t day)
+{
+    uint32_t days = days_from_civil(year, month, day);
+    uint8_t iso_wday = (weekday_from_days(days) + 6) % 7; // 0: Monday
+    uint32_t thursday = days - iso_wday + 3;
+    uint16_t thursday_year;
+    uint8_t m, d;
+
+    civil_from_days(thursday, &thursday_year, &m, &d);
+    return (thursday - days_from_civil(thursday_year, 1, 1)) / 7 + 1;
+}
 
-    while (1)
-    {
-        if (ltime < SEC_PER_MT[leapyr][result->tm_mon])
-            break;
-        ltime -= SEC_PER_MT[leapyr][result->tm_mon];
-        ++(result->tm_mon);
-    }
+void transformTime(uint32_t unix_time, struct devtm *result)
+{
+    uint32_t days = unix_time / SEC_PER_DY;
+    uint32_t ltime = unix_time % SEC_PER_DY;
+    uint16_t year;
 
-    result->tm_mday = ltime / SEC_PER_DY;
-    ++(result->tm_mday);
-    ltime = ltime % SEC_PER_DY;
+    memset(result, 0, sizeof(struct devtm));
+    civil_from_days(days, &year, &result->tm_mon, &result->tm_mday);
 
     result->tm_hour = ltime / SEC_PER_HR;
     ltime = ltime % SEC_PER_HR;
@@ -490,28 +513,21 @@ void transformTime(uint32_t unix_time, struct devtm *result)
     result->tm_min = ltime / 60;
     result->tm_sec = ltime % 60;
 
-    result->tm_wday =
-        day_of_week_get(result->tm_mon + 1, result->tm_mday,
-                        result->tm_year);
+    result->tm_wday = weekday_from_days(days);
 
     /*
-     * The number of years since YEAR0"
+     * The number of years since YEAR0, month 0-11
      */
-    result->tm_year -= YEAR0;
+    result->tm_year = year - YEAR0;
+    result->tm_mon -= 1;
 }
 
-uint8_t map[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
-
 /*
-获取一个月最后一天值
+获取一个月最后一天值 (month 为 0-11)
 */
 uint8_t get_last_day(uint16_t year, uint8_t month)
 {
-    if (month % 12 == 1)
-    {
-        return map[month % 12] + is_leap(year);
-    }
-    return map[month % 12];
+    return thisMonthMaxDays(year, month % 12 + 1);
 }
 
 /*
@@ -522,28 +538,17 @@ uint8_t get_first_day_week(uint16_t year, uint8_t month)
     return day_of_week_get(month, 1, year);
 }
 
-// 时间结构体转时间戳
+// 时间结构体转时间戳 (tm_year 为公历年份，tm_mon 为 1-12)
 uint32_t transformTimeStruct(struct devtm *result)
 {
-    uint32_t Cyear = 0;
-    for (uint16_t i = 1970; i < result->tm_year; i++)
-    {
-        if (is_leap(i) == 1)
-            Cyear++;
-    }
-
-    uint32_t CountDay = Cyear * (uint32_t)366 + (uint32_t)(result->tm_year - 1970 - Cyear) * (uint32_t)365 + result->tm_mday - 1;
-    for (uint8_t i = 0; i < result->tm_mon - 1; i++)
-    {
-        CountDay += get_last_day(result->tm_year, i);
-    }
+    uint32_t CountDay = days_from_civil(result->tm_year, result->tm_mon, result->tm_mday);
 
-    return (CountDay * SECOND_OF_DAY + (uint32_t)result->tm_sec + (uint32_t)result->tm_min * 60 + (uint32_t)result->tm_hour * 3600);
+    return (CountDay * SEC_PER_DY + (uint32_t)result->tm_sec + (uint32_t)result->tm_min * 60 + (uint32_t)result->tm_hour * SEC_PER_HR);
 }
 
-uint8_t thisMonthMaxDays(uint8_t year, uint8_t month)
+uint8_t thisMonthMaxDays(uint16_t year, uint8_t month)
 {
-    if (year % 4 == 0 && month == 2)
+    if (month == 2 && is_leap(year))
         return MonthDayMax[month - 1] + 1;
     else
         return MonthDayMax[month - 1];
@@ -27,6 +27,13 @@ struct Lunar_Date
     uint16_t Year;
 };
 
+typedef struct
+{
+    struct Lunar_Date date; // current lunar date, Year == 0 if out of table range
+    uint16_t year_index;    // index of the lunar year, relative to the first year of the table
+    uint8_t month_index;    // month position within the lunar year (0..12, leap month included)
+} lunar_iter_t;
+
 extern const char Lunar_MonthString[13][7];
 extern const char Lunar_MonthLeapString[2][4];
 extern const char Lunar_DateString[31][7];
@@ -37,6 +44,9 @@ extern const char Lunar_BranchStrig[12][4];
 extern const char JieQiStr[24][7];
 
 void LUNAR_SolarToLunar(struct Lunar_Date *lunar, uint16_t solar_year, uint8_t solar_month, uint8_t solar_date);
+void LUNAR_IterInit(lunar_iter_t *iter, uint16_t solar_year, uint8_t solar_month, uint8_t solar_date);
+void LUNAR_IterNext(lunar_iter_t *iter);
+void LUNAR_IterAdvance(lunar_iter_t *iter, uint16_t days);
 uint8_t LUNAR_GetZodiac(const struct Lunar_Date *lunar);
 uint8_t LUNAR_GetStem(const struct Lunar_Date *lunar);
 uint8_t LUNAR_GetBranch(const struct Lunar_Date *lunar);
@@ -48,6 +58,11 @@ uint32_t transformTimeStruct(struct devtm *result);
 uint8_t get_first_day_week(uint16_t year, uint8_t month);
 uint8_t get_last_day(uint16_t year, uint8_t month);
 unsigned char day_of_week_get(unsigned char month, unsigned char day, unsigned short year);
-uint8_t thisMonthMaxDays(uint8_t year, uint8_t month);
+uint8_t thisMonthMaxDays(uint16_t year, uint8_t month);
+
+uint32_t days_from_civil(uint16_t year, uint8_t month, uint8_t day);
+void civil_from_days(uint32_t days, uint16_t *year, uint8_t *month, uint8_t *day);
+uint8_t weekday_from_days(uint32_t days);
+uint8_t week_of_year(uint16_t year, uint8_t month, uint8_t day);
 
 #endif
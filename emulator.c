@@ -236,6 +236,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
                 .week_start      = g_week_start,
                 .temperature     = 25,
                 .voltage         = 3.2f,
+                .battery         = 100,
                 .ssid            = "NRF_EPD_84AC",
             };
             
@@ -0,0 +1,589 @@
+// Headless GUI emulator for Linux (and other POSIX systems)
+// Renders the calendar / clock pages of any panel model into PBM/PPM images,
+// benchmarks the GUI rendering over a sweep of dates, or checks the output of
+// every model against golden bitplanes rendered from a known-good build.
+#define _POSIX_C_SOURCE 200809L
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include "GUI.h"
+#include "Lunar.h"
+
+// Same IDs and geometries as epd_models[] in EPD/EPD_driver.c
+typedef struct {
+    uint8_t id;
+    const char *name;
+    uint16_t width;
+    uint16_t height;
+    uint8_t color; // 1: BW, 2: BWR, 3: BWRY
+} emu_model_t;
+
+static const emu_model_t emu_models[] = {
+    { 1, "UC8176_420_BW",    400, 300, 1},
+    { 2, "SSD1619_420_BWR",  400, 300, 2},
+    { 3, "UC8176_420_BWR",   400, 300, 2},
+    { 4, "SSD1619_420_BW",   400, 300, 1},
+    { 5, "JD79668_420_BWRY", 400, 300, 3},
+    { 6, "UC8179_750_BW",    800, 480, 1},
+    { 7, "UC8179_750_BWR",   800, 480, 2},
+    { 8, "UC8159_750_BW",    640, 384, 1},
+    { 9, "UC8159_750_BWR",   640, 384, 2},
+    {10, "SSD1677_750_BW",   880, 528, 1},
+    {11, "SSD1677_750_BWR",  880, 528, 2},
+    {12, "JD79668_750_BWRY", 800, 480, 3},
+};
+
+#define EMU_MODEL_COUNT (sizeof(emu_models) / sizeof(emu_models[0]))
+
+enum { PIXEL_WHITE = 0, PIXEL_BLACK, PIXEL_RED, PIXEL_YELLOW };
+
+// Frame buffer, one byte per pixel
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint8_t color;
+    uint8_t *pixels;
+    uint32_t pages;  // callback invocations
+    uint32_t bytes;  // bytes that would be sent to the panel
+    double callback_us; // time spent in DrawBitmap, excluded from the benchmark
+} emu_frame_t;
+
+static double NowUs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void DrawBitmap(void *user_data, uint8_t *black, uint8_t *color, uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    emu_frame_t *frame = (emu_frame_t *)user_data;
+    uint16_t wb = (w + 7) / 8;
+    double start = NowUs();
+
+    frame->pages++;
+    frame->bytes += (frame->color == 3 ? w / 4 : wb) * h * (frame->color == 2 ? 2 : 1);
+
+    for (uint16_t row = 0; row < h && y + row < frame->height; row++) {
+        for (uint16_t col = 0; col < w && x + col < frame->width; col++) {
+            uint8_t pixel;
+            if (frame->color == 3) { // 2 bits per pixel: 0 black, 1 white, 2 yellow, 3 red
+                uint8_t v = (black[row * (w / 4) + col / 4] >> (6 - 2 * (col % 4))) & 0x03;
+                static const uint8_t map[4] = { PIXEL_BLACK, PIXEL_WHITE, PIXEL_YELLOW, PIXEL_RED };
+                pixel = map[v];
+            } else {
+                uint32_t pos = row * wb + col / 8;
+                uint8_t bit = 0x80 >> (col % 8);
+                if (color && !(color[pos] & bit))
+                    pixel = PIXEL_RED;
+                else
+                    pixel = (black[pos] & bit) ? PIXEL_WHITE : PIXEL_BLACK;
+            }
+            frame->pixels[(y + row) * frame->width + x + col] = pixel;
+        }
+    }
+
+    frame->callback_us += NowUs() - start;
+}
+
+// PBM (P4) for BW panels, PPM (P6) for color panels
+static int WriteImage(emu_frame_t *frame, const char *path)
+{
+    FILE *fp = strcmp(path, "-") == 0 ? stdout : fopen(path, "wb");
+    if (fp == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    if (frame->color == 1) {
+        uint16_t wb = (frame->width + 7) / 8;
+        fprintf(fp, "P4\n%d %d\n", frame->width, frame->height);
+        for (uint16_t y = 0; y < frame->height; y++) {
+            for (uint16_t i = 0; i < wb; i++) {
+                uint8_t byte = 0;
+                for (uint8_t b = 0; b < 8 && i * 8 + b < frame->width; b++)
+                    if (frame->pixels[y * frame->width + i * 8 + b] != PIXEL_WHITE)
+                        byte |= 0x80 >> b;
+                fputc(byte, fp);
+            }
+        }
+    } else {
+        static const uint8_t rgb[4][3] = { {255, 255, 255}, {0, 0, 0}, {255, 0, 0}, {255, 255, 0} };
+        fprintf(fp, "P6\n%d %d\n255\n", frame->width, frame->height);
+        for (uint32_t i = 0; i < (uint32_t)frame->width * frame->height; i++)
+            fwrite(rgb[frame->pixels[i]], 1, 3, fp);
+    }
+
+    if (fp != stdout) fclose(fp);
+    return 0;
+}
+
+static const emu_model_t *FindModel(int id)
+{
+    for (uint8_t i = 0; i < EMU_MODEL_COUNT; i++)
+        if (emu_models[i].id == id) return &emu_models[i];
+    return NULL;
+}
+
+// Pack the frame the way the panel RAM holds it: black plane (+ color plane) for
+// BW/BWR, 2 bits per pixel for BWRY. Independent of how the GUI paged the frame.
+static uint32_t PackFrame(emu_frame_t *frame, uint8_t *buf)
+{
+    uint16_t wb = (frame->width + 7) / 8;
+    uint32_t plane = (uint32_t)wb * frame->height;
+    uint32_t size;
+
+    if (frame->color == 3) {
+        static const uint8_t code[4] = { 1, 0, 3, 2 }; // white, black, red, yellow
+        uint16_t wq = (frame->width + 3) / 4;
+        size = (uint32_t)wq * frame->height;
+        memset(buf, 0, size);
+        for (uint16_t y = 0; y < frame->height; y++)
+            for (uint16_t x = 0; x < frame->width; x++)
+                buf[y * wq + x / 4] |= code[frame->pixels[y * frame->width + x]] << (6 - 2 * (x % 4));
+        return size;
+    }
+
+    size = frame->color == 2 ? plane * 2 : plane;
+    memset(buf, 0xFF, size);
+    for (uint16_t y = 0; y < frame->height; y++) {
+        for (uint16_t x = 0; x < frame->width; x++) {
+            uint8_t pixel = frame->pixels[y * frame->width + x];
+            uint8_t bit = 0x80 >> (x % 8);
+            if (pixel == PIXEL_BLACK)
+                buf[y * wb + x / 8] &= ~bit;
+            else if (pixel == PIXEL_RED)
+                buf[plane + y * wb + x / 8] &= ~bit;
+        }
+    }
+    return size;
+}
+
+// Accepts a unix timestamp (local time, as kept by the device) or "YYYY-MM-DD[ HH:MM[:SS]]"
+static int ParseTime(const char *str, uint32_t *timestamp)
+{
+    struct devtm tm = {0};
+    unsigned int year, mon, mday, hour = 0, min = 0, sec = 0;
+
+    if (sscanf(str, "%u-%u-%u%*c%u:%u:%u", &year, &mon, &mday, &hour, &min, &sec) >= 3) {
+        if (year < 1970 || year > 2105 || mon < 1 || mon > 12 || mday < 1 || mday > thisMonthMaxDays(year, mon))
+            return -1;
+        tm.tm_year = year;
+        tm.tm_mon = mon;
+        tm.tm_mday = mday;
+        tm.tm_hour = hour;
+        tm.tm_min = min;
+        tm.tm_sec = sec;
+        *timestamp = transformTimeStruct(&tm);
+        return 0;
+    }
+
+    char *end;
+    unsigned long value = strtoul(str, &end, 0);
+    if (*end != '\0') return -1;
+    *timestamp = (uint32_t)value;
+    return 0;
+}
+
+static void Render(gui_data_t *data, emu_frame_t *frame)
+{
+    memset(frame->pixels, PIXEL_WHITE, (uint32_t)frame->width * frame->height);
+    frame->pages = 0;
+    frame->bytes = 0;
+    frame->callback_us = 0;
+    DrawGUI(data, DrawBitmap, frame);
+}
+
+// Render every model/mode over a sweep of dates and print timing statistics,
+// times are GUI rendering only (without converting the pages to pixels)
+static void Benchmark(gui_data_t *base, const emu_model_t *models, uint8_t count, uint32_t days, uint32_t step)
+{
+    printf("%-18s %-9s %-4s %-6s %6s %5s %9s %9s %9s %9s %8s\n",
+           "model", "size", "clr", "mode", "frames", "pages", "avg(us)", "min(us)", "max(us)", "page(us)", "bytes");
+
+    for (uint8_t i = 0; i < count; i++) {
+        const emu_model_t *model = &models[i];
+
+        emu_frame_t frame = { model->width, model->height, model->color };
+        frame.pixels = malloc((uint32_t)model->width * model->height);
+        if (frame.pixels == NULL) return;
+
+        for (display_mode_t mode = MODE_CALENDAR; mode <= MODE_CLOCK; mode++) {
+            gui_data_t data = *base;
+            data.mode = mode;
+            data.color = model->color;
+            data.width = model->width;
+            data.height = model->height;
+
+            double total = 0, min = 1e12, max = 0;
+            uint32_t pages = 0, bytes = 0;
+            for (uint32_t n = 0; n < days; n++) {
+                data.timestamp = base->timestamp + n * step;
+                double start = NowUs();
+                Render(&data, &frame);
+                double elapsed = NowUs() - start - frame.callback_us;
+                total += elapsed;
+                if (elapsed < min) min = elapsed;
+                if (elapsed > max) max = elapsed;
+                pages = frame.pages;
+                bytes = frame.bytes;
+            }
+
+            char size[12];
+            snprintf(size, sizeof(size), "%dx%d", model->width, model->height);
+            printf("%-18s %-9s %-4s %-6s %6u %5u %9.1f %9.1f %9.1f %9.1f %8u\n",
+                   model->name, size, model->color == 1 ? "BW" : (model->color == 2 ? "BWR" : "BWRY"),
+                   mode == MODE_CLOCK ? "clock" : "cal", days, pages,
+                   total / days, min, max, total / days / (pages ? pages : 1), bytes);
+        }
+
+        free(frame.pixels);
+    }
+}
+
+// Dates chosen to cover the tricky parts of the calendar: leap months, 除夕,
+// public holidays and 调休 work days, leap days, six-row months, year boundaries
+// and both week starts. The rest of gui_data_t is fixed so the output only
+// depends on the rendering code.
+typedef struct {
+    const char *time;
+    uint8_t week_start;
+} golden_case_t;
+
+static const golden_case_t golden_cases[] = {
+    {"2024-02-09 23:59", 0}, // 除夕, Spring Festival holidays
+    {"2024-02-29 12:00", 1}, // leap day
+    {"2025-01-26 08:00", 0}, // 调休 work day before Spring Festival
+    {"2025-01-28 00:00", 1}, // 除夕
+    {"2025-03-31 18:30", 0}, // six-row month
+    {"2025-07-25 09:05", 0}, // first day of 闰六月
+    {"2025-08-22 10:10", 1}, // last day of 闰六月
+    {"2025-10-01 07:00", 0}, // National Day + Mid-Autumn
+    {"2025-12-31 23:59", 1}, // year boundary
+    {"2026-02-16 20:00", 0}, // 除夕
+    {"2026-06-19 06:45", 6}, // Dragon Boat Festival, week starting Saturday
+    {"2023-03-22 11:11", 0}, // first day of 闰二月
+};
+
+#define GOLDEN_CASE_COUNT (sizeof(golden_cases) / sizeof(golden_cases[0]))
+
+// FNV-1a, 64 bit
+static uint64_t HashFrame(const uint8_t *buf, uint32_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (uint32_t i = 0; i < size; i++)
+        hash = (hash ^ buf[i]) * 0x100000001b3ULL;
+    return hash;
+}
+
+// Hash of the frame name in the hash list (lines of "<name> <hash>"), false if not listed
+static bool FindHash(const char *list, const char *name, uint64_t *hash)
+{
+    size_t len = strlen(name);
+    for (const char *line = list; line != NULL; line = strchr(line, '\n')) {
+        if (*line == '\n') line++;
+        if (strncmp(line, name, len) == 0 && line[len] == ' ')
+            return sscanf(line + len + 1, "%16" SCNx64, hash) == 1;
+    }
+    return false;
+}
+
+static char *ReadText(const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        perror(path);
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char *text = malloc(size + 1);
+    if (text != NULL) {
+        text[fread(text, 1, size, fp)] = '\0';
+    }
+    fclose(fp);
+    return text;
+}
+
+// Write (update = true) or compare the golden frames of every model/mode/case, returns the
+// number of mismatching frames. The golden set is either the bitplanes in a directory, and
+// mismatches are saved next to the golden as <name>.fail.pbm/ppm for inspection, or a list
+// of frame hashes (hashes = true, host/golden.txt, checked by make check), and mismatches
+// are saved next to the list.
+static int Golden(const char *path, const emu_model_t *models, uint8_t count, bool update, bool hashes)
+{
+    int failed = 0, total = 0;
+    FILE *list = NULL;
+    char *text = NULL;
+
+    if (hashes && update) {
+        list = fopen(path, "w");
+        if (list == NULL) {
+            perror(path);
+            return -1;
+        }
+    } else if (hashes) {
+        text = ReadText(path);
+        if (text == NULL) return -1;
+    } else if (update && mkdir(path, 0755) != 0 && errno != EEXIST) {
+        perror(path);
+        return -1;
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        const emu_model_t *model = &models[i];
+        uint32_t pixels = (uint32_t)model->width * model->height;
+
+        emu_frame_t frame = { model->width, model->height, model->color };
+        frame.pixels = malloc(pixels);
+        uint8_t *packed = malloc(pixels / 2 + model->height * 2);
+        uint8_t *golden = malloc(pixels / 2 + model->height * 2 + 1);
+        if (frame.pixels == NULL || packed == NULL || golden == NULL) {
+            free(frame.pixels); free(packed); free(golden);
+            failed = -1;
+            break;
+        }
+
+        for (display_mode_t mode = MODE_CALENDAR; mode <= MODE_CLOCK; mode++) {
+            for (uint8_t n = 0; n < GOLDEN_CASE_COUNT; n++) {
+                gui_data_t data = {
+                    .mode        = mode,
+                    .color       = model->color,
+                    .width       = model->width,
+                    .height      = model->height,
+                    .week_start  = golden_cases[n].week_start,
+                    .temperature = 25,
+                    .voltage     = 3.2f,
+                    .battery     = 100,
+                    .ssid        = "NRF_EPD_84AC",
+                };
+                ParseTime(golden_cases[n].time, &data.timestamp);
+                Render(&data, &frame);
+                uint32_t size = PackFrame(&frame, packed);
+
+                char name[128];
+                snprintf(name, sizeof(name), "%s_%s_%.10s_%u", model->name,
+                         mode == MODE_CLOCK ? "clock" : "cal", golden_cases[n].time, data.timestamp);
+                total++;
+
+                char file[512];
+                const char *ext = model->color == 1 ? "pbm" : "ppm";
+                if (hashes) {
+                    uint64_t hash = HashFrame(packed, size), expected;
+                    if (update) {
+                        fprintf(list, "%s %016" PRIx64 "\n", name, hash);
+                        continue;
+                    }
+                    bool found = FindHash(text, name, &expected);
+                    if (found && hash == expected)
+                        continue;
+
+                    // the frame is saved next to the hash list
+                    const char *slash = strrchr(path, '/');
+                    snprintf(file, sizeof(file), "%.*s%s.fail.%s", slash ? (int)(slash - path + 1) : 0, path, name, ext);
+                    if (found)
+                        printf("FAIL %s: hash %016" PRIx64 ", expected %016" PRIx64 ", see %s\n", name, hash, expected, file);
+                    else
+                        printf("FAIL %s: not in %s, see %s\n", name, path, file);
+                    WriteImage(&frame, file);
+                    failed++;
+                    continue;
+                }
+
+                int len = snprintf(file, sizeof(file), "%s/%s.bin", path, name);
+
+                FILE *fp = fopen(file, update ? "wb" : "rb");
+                if (fp == NULL) {
+                    perror(file);
+                    failed++;
+                    continue;
+                }
+                if (update) {
+                    fwrite(packed, 1, size, fp);
+                    fclose(fp);
+                    continue;
+                }
+
+                uint32_t read = fread(golden, 1, size + 1, fp);
+                fclose(fp);
+                if (read == size && memcmp(golden, packed, size) == 0)
+                    continue;
+
+                uint32_t diff = 0, first = size;
+                for (uint32_t k = 0; k < size && k < read; k++) {
+                    if (golden[k] != packed[k]) {
+                        if (first == size) first = k;
+                        diff++;
+                    }
+                }
+                if (read != size)
+                    printf("FAIL %s: size %u, expected %u\n", file, size, read);
+                else
+                    printf("FAIL %s: %u bytes differ, first at offset %u\n", file, diff, first);
+
+                snprintf(file + len - 4, sizeof(file) - len + 4, ".fail.%s", ext);
+                WriteImage(&frame, file);
+                failed++;
+            }
+        }
+
+        free(frame.pixels);
+        free(packed);
+        free(golden);
+    }
+
+    if (list != NULL) fclose(list);
+    free(text);
+    if (failed < 0)
+        return failed;
+    if (update)
+        printf("%d golden frames written to %s\n", total - failed, path);
+    else
+        printf("%d/%d frames match\n", total - failed, total);
+    return failed;
+}
+
+static void Usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -i <id>       panel model id (default 1), see -l\n"
+        "  -W <width>    custom panel width\n"
+        "  -H <height>   custom panel height\n"
+        "  -c <color>    custom panel color: 1 BW, 2 BWR, 3 BWRY\n"
+        "  -m <mode>     display mode: calendar (default) or clock\n"
+        "  -t <time>     unix timestamp or \"YYYY-MM-DD HH:MM\" (default: now, UTC+8)\n"
+        "  -w <day>      week start, 0: Sunday (default), 1: Monday, ...\n"
+        "  -T <temp>     temperature (default 25)\n"
+        "  -V <voltage>  battery voltage (default 3.2)\n"
+        "  -B <percent>  battery icon fill (default 100)\n"
+        "  -s <name>     device name (default NRF_EPD_84AC)\n"
+        "  -o <file>     output image, PBM for BW panels, PPM otherwise (default epd.pbm/epd.ppm, - for stdout)\n"
+        "  -b <days>     benchmark all models (or the one given by -i) over <days> frames instead\n"
+        "  -S <seconds>  time step between benchmark frames (default 86400)\n"
+        "  -g <dir>      render the golden set of all models (or the one given by -i) into <dir>\n"
+        "  -G <dir>      compare against the golden set in <dir>, exit status 1 on any mismatch\n"
+        "  -k <file>     write the hashes of the golden set to <file> (host/golden.txt)\n"
+        "  -K <file>     compare against the golden hashes in <file>, exit status 1 on any mismatch,\n"
+        "                mismatching frames are saved next to <file> as *.fail.pbm/ppm\n"
+        "  -l            list panel models\n",
+        prog);
+}
+
+int main(int argc, char *argv[])
+{
+    const emu_model_t *model = FindModel(1);
+    emu_model_t custom = { 0, "CUSTOM", 0, 0, 1 };
+    const char *output = NULL;
+    const char *golden_dir = NULL;
+    bool golden_update = false, golden_hashes = false;
+    uint32_t bench_days = 0, bench_step = 86400;
+    bool model_set = false;
+    int opt;
+
+    gui_data_t data = {
+        .mode            = MODE_CALENDAR,
+        .timestamp       = time(NULL) + 8 * 3600,
+        .week_start      = 0,
+        .temperature     = 25,
+        .voltage         = 3.2f,
+        .battery         = 100,
+        .ssid            = "NRF_EPD_84AC",
+    };
+
+    while ((opt = getopt(argc, argv, "i:W:H:c:m:t:w:T:V:B:s:o:b:S:g:G:k:K:lh")) != -1) {
+        switch (opt) {
+            case 'i':
+                model = FindModel(atoi(optarg));
+                if (model == NULL) {
+                    fprintf(stderr, "unknown model id: %s\n", optarg);
+                    return 1;
+                }
+                model_set = true;
+                break;
+            case 'W': custom.width = atoi(optarg); break;
+            case 'H': custom.height = atoi(optarg); break;
+            case 'c': custom.color = atoi(optarg); break;
+            case 'm':
+                if (strcmp(optarg, "clock") == 0 || strcmp(optarg, "2") == 0)
+                    data.mode = MODE_CLOCK;
+                else
+                    data.mode = MODE_CALENDAR;
+                break;
+            case 't':
+                if (ParseTime(optarg, &data.timestamp) != 0) {
+                    fprintf(stderr, "invalid time: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'w': data.week_start = atoi(optarg); break;
+            case 'T': data.temperature = atoi(optarg); break;
+            case 'V': data.voltage = atof(optarg); break;
+            case 'B': data.battery = atoi(optarg); break;
+            case 's':
+                strncpy(data.ssid, optarg, sizeof(data.ssid) - 1);
+                data.ssid[sizeof(data.ssid) - 1] = '\0';
+                break;
+            case 'o': output = optarg; break;
+            case 'b': bench_days = strtoul(optarg, NULL, 0); break;
+            case 'S': bench_step = strtoul(optarg, NULL, 0); break;
+            case 'g': golden_dir = optarg; golden_update = true; break;
+            case 'G': golden_dir = optarg; golden_update = false; break;
+            case 'k': golden_dir = optarg; golden_update = true; golden_hashes = true; break;
+            case 'K': golden_dir = optarg; golden_update = false; golden_hashes = true; break;
+            case 'l':
+                for (uint8_t i = 0; i < EMU_MODEL_COUNT; i++)
+                    printf("%2d  %-18s %dx%d %s\n", emu_models[i].id, emu_models[i].name,
+                           emu_models[i].width, emu_models[i].height,
+                           emu_models[i].color == 1 ? "BW" : (emu_models[i].color == 2 ? "BWR" : "BWRY"));
+                return 0;
+            default:
+                Usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (custom.width > 0 || custom.height > 0) {
+        if (custom.width < 8 || custom.height < 8 || custom.color < 1 || custom.color > 3) {
+            fprintf(stderr, "invalid custom panel: %dx%d color %d\n", custom.width, custom.height, custom.color);
+            return 1;
+        }
+        model = &custom;
+        model_set = true;
+    }
+
+    if (golden_dir != NULL) {
+        int failed = model_set ? Golden(golden_dir, model, 1, golden_update, golden_hashes)
+                               : Golden(golden_dir, emu_models, EMU_MODEL_COUNT, golden_update, golden_hashes);
+        return failed == 0 ? 0 : 1;
+    }
+
+    if (bench_days > 0) {
+        if (model_set)
+            Benchmark(&data, model, 1, bench_days, bench_step);
+        else
+            Benchmark(&data, emu_models, EMU_MODEL_COUNT, bench_days, bench_step);
+        return 0;
+    }
+
+    data.color = model->color;
+    data.width = model->width;
+    data.height = model->height;
+
+    emu_frame_t frame = { model->width, model->height, model->color };
+    frame.pixels = malloc((uint32_t)model->width * model->height);
+    if (frame.pixels == NULL) return 1;
+
+    Render(&data, &frame);
+    int ret = WriteImage(&frame, output ? output : (model->color == 1 ? "epd.pbm" : "epd.ppm"));
+    free(frame.pixels);
+
+    return ret == 0 ? 0 : 1;
+}
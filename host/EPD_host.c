@@ -0,0 +1,431 @@
+// Host implementation of the EPD HAL (EPD_driver.h), replaces EPD_driver.c.
+// Bus traffic goes to the virtual controller in EPD_panel.c, delays and BUSY
+// waits advance its modeled time instead of blocking.
+#include <stdio.h>
+#include <string.h>
+#include "EPD_driver.h"
+#include "EPD_panel.h"
+#include "EPD_battery.h"
+#include "EPD_capture.h"
+#include "EPD_energy.h"
+#include "EPD_sequence.h"
+#include "nrf_log.h"
+
+#define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+#define BUFFER_SIZE 128
+
+// SPI clock of NRF_DRV_SPI_DEFAULT_CONFIG, and a rough per-call cost of
+// nrf_drv_spi_transfer() plus the pin checks in EPD_SPI_Write() on nRF51
+#define HOST_SPI_FREQ_HZ 4000000
+#define HOST_SPI_CALL_US 10
+
+static uint32_t m_pins[32];
+static uint32_t m_rst = HIGH;
+static uint8_t m_dc = LOW;
+static uint16_t m_driver_refs = 0;
+static float m_voltage = 3.0f;
+static uint32_t m_en_pin = 0xFF;
+static epd_state_t m_state = EPD_STATE_OFF;
+static epd_model_t *m_epd = NULL;
+
+// Arduino like function wrappers
+void pinMode(uint32_t pin, uint32_t mode)
+{
+    (void)pin;
+    (void)mode;
+}
+
+void nrf_gpio_pin_write(uint32_t pin, uint32_t value)
+{
+    if (pin < ARRAY_SIZE(m_pins)) m_pins[pin] = value;
+}
+
+uint32_t nrf_gpio_pin_read(uint32_t pin)
+{
+    return pin < ARRAY_SIZE(m_pins) ? m_pins[pin] : LOW;
+}
+
+void nrf_gpio_pin_toggle(uint32_t pin)
+{
+    if (pin < ARRAY_SIZE(m_pins)) m_pins[pin] = !m_pins[pin];
+}
+
+void nrf_gpio_cfg_sense_input(uint32_t pin, nrf_gpio_pin_pull_t pull_config, nrf_gpio_pin_sense_t sense_config)
+{
+    (void)pin;
+    (void)pull_config;
+    (void)sense_config;
+}
+
+void nrf_delay_ms(uint32_t ms)
+{
+    nrf_delay_us(ms * 1000);
+}
+
+void nrf_delay_us(uint32_t us)
+{
+    epd_panel_stats()->delay_us += us;
+    epd_panel_advance(us);
+}
+
+// GPIO
+static bool EPD_GPIO_Retain(void)
+{
+    return m_state == EPD_STATE_STANDBY && m_epd != NULL && m_epd->drv->wake != NULL && m_en_pin == 0xFF;
+}
+
+void EPD_GPIO_Load(epd_config_t *cfg)
+{
+    if (cfg == NULL) return;
+    EPD_GPIO_Release();
+    m_en_pin = cfg->en_pin;
+}
+
+void EPD_GPIO_Init(void)
+{
+    if (m_driver_refs++ > 0) return;
+    m_dc = LOW;
+}
+
+void EPD_GPIO_Uninit(void)
+{
+    if (--m_driver_refs > 0) return;
+    if (EPD_GPIO_Retain()) return;
+    m_state = EPD_STATE_OFF;
+    epd_panel_release();
+}
+
+void EPD_GPIO_Release(void)
+{
+    if (m_driver_refs > 0 || m_state == EPD_STATE_OFF) return;
+    m_state = EPD_STATE_OFF;
+    epd_panel_release();
+}
+
+// SPI
+static void EPD_SPI_Transfer(uint8_t len)
+{
+    epd_panel_stats_t *stats = epd_panel_stats();
+    uint64_t us = HOST_SPI_CALL_US + (uint64_t)len * 8 * 1000000 / HOST_SPI_FREQ_HZ;
+
+    stats->transfers++;
+    stats->spi_us += us;
+    epd_panel_advance(us);
+}
+
+void EPD_SPI_Write(uint8_t *value, uint8_t len)
+{
+    EPD_SPI_Transfer(len);
+    epd_energy_spi(len);
+    if (m_dc == LOW) {
+        for (uint8_t i = 0; i < len; i++)
+            epd_panel_command(value[i]);
+    } else {
+        epd_panel_data(value, len);
+    }
+}
+
+void EPD_SPI_Read(uint8_t *value, uint8_t len)
+{
+    EPD_SPI_Transfer(len);
+    epd_energy_spi(len);
+    epd_panel_read(value, len);
+}
+
+// EPD
+void EPD_WriteCmd(uint8_t cmd)
+{
+    EPD_Capture_Record(EPD_CAPTURE_CMD, &cmd, 1);
+    m_dc = LOW;
+    EPD_SPI_Write(&cmd, 1);
+}
+
+void EPD_WriteData(uint8_t *value, uint8_t len)
+{
+    EPD_Capture_Record(EPD_CAPTURE_DATA, value, len);
+    m_dc = HIGH;
+    EPD_SPI_Write(value, len);
+}
+
+void EPD_ReadData(uint8_t *value, uint8_t len)
+{
+    m_dc = HIGH;
+    EPD_SPI_Read(value, len);
+    EPD_Capture_Record(EPD_CAPTURE_READ, value, len);
+}
+
+void EPD_WriteByte(uint8_t value)
+{
+    EPD_Capture_Record(EPD_CAPTURE_DATA, &value, 1);
+    m_dc = HIGH;
+    EPD_SPI_Write(&value, 1);
+}
+
+uint8_t EPD_ReadByte(void)
+{
+    uint8_t value;
+    m_dc = HIGH;
+    EPD_SPI_Read(&value, 1);
+    EPD_Capture_Record(EPD_CAPTURE_READ, &value, 1);
+    return value;
+}
+
+void EPD_FillRAM(uint8_t cmd, uint8_t value, uint32_t len)
+{
+    uint8_t buffer[BUFFER_SIZE];
+    for (uint8_t i = 0; i < BUFFER_SIZE; i++)
+        buffer[i] = value;
+
+    EPD_WriteCmd(cmd);
+    uint16_t remaining = len;
+    while (remaining > 0) {
+        uint16_t chunk_size = (remaining > BUFFER_SIZE) ? BUFFER_SIZE : remaining;
+        EPD_WriteData(buffer, chunk_size);
+        remaining -= chunk_size;
+    }
+}
+
+void EPD_WaitBusy(uint32_t value, uint16_t timeout)
+{
+    epd_panel_stats_t *stats = epd_panel_stats();
+    uint16_t wait_ms = timeout;
+
+    stats->busy_waits++;
+    NRF_LOG_DEBUG("[EPD]: check busy\n");
+    while (epd_panel_busy_pin() == value) {
+        stats->busy_us += 1000;
+        epd_panel_advance(1000);
+        timeout--;
+        if (timeout == 0) {
+            NRF_LOG_DEBUG("[EPD]: busy timeout!\n");
+            stats->busy_timeouts++;
+            break;
+        }
+    }
+    NRF_LOG_DEBUG("[EPD]: busy release\n");
+    EPD_Capture_Busy(wait_ms - timeout);
+    epd_energy_busy(wait_ms - timeout);
+}
+
+epd_state_t EPD_State(void)
+{
+    return m_state;
+}
+
+void EPD_SetState(epd_state_t state)
+{
+    m_state = state;
+}
+
+void EPD_ResetPin(uint32_t value)
+{
+    if (value == LOW && m_rst != LOW)
+        EPD_Capture_Record(EPD_CAPTURE_RESET, NULL, 0);
+    if (value != LOW && m_rst == LOW)
+        epd_panel_reset(); // controller leaves reset on the rising edge
+    m_rst = value;
+}
+
+uint32_t EPD_BusyPin(void)
+{
+    return epd_panel_busy_pin();
+}
+
+// Expires at once, after the modeled time of the wait
+void EPD_SeqTimerStart(uint16_t ms)
+{
+    epd_panel_stats()->wait_us += (uint64_t)ms * 1000;
+    epd_panel_advance((uint64_t)ms * 1000);
+    epd_sequence_timeout();
+}
+
+void EPD_SeqTimerStop(void)
+{
+}
+
+// Modeled time as RTC1 ticks (32768Hz, 24-bit)
+uint32_t EPD_Ticks(void)
+{
+    return (uint32_t)(epd_panel_time() * 32768 / 1000000) & 0xFFFFFF;
+}
+
+#if EPD_CAPTURE_SIZE > 0
+uint32_t EPD_Capture_Ticks(void)
+{
+    return EPD_Ticks();
+}
+#endif
+
+// lED
+void EPD_LED_ON(void)
+{
+}
+
+void EPD_LED_OFF(void)
+{
+}
+
+void EPD_LED_Toggle(void)
+{
+}
+
+void EPD_LED_BLINK(void)
+{
+    delay(200);
+}
+
+void EPD_VoltageInit(void)
+{
+}
+
+void EPD_VoltageStart(void)
+{
+}
+
+float EPD_ReadVoltage(void)
+{
+    return m_voltage;
+}
+
+// EPD_driver.c with the default battery_empty threshold
+uint8_t EPD_VoltageLevel(float voltage)
+{
+    uint16_t mv = (uint16_t)(voltage * 1000);
+    if (mv >= BATTERY_FULL_MV) return 100;
+    if (mv <= BATTERY_EMPTY_MV) return 0;
+    return (uint8_t)((uint32_t)(mv - BATTERY_EMPTY_MV) * 100 / (BATTERY_FULL_MV - BATTERY_EMPTY_MV));
+}
+
+int8_t EPD_ReadDieTemp(void)
+{
+    return epd_panel_temperature();
+}
+
+void epd_host_set_voltage(float voltage)
+{
+    m_voltage = voltage;
+}
+
+// EPD models
+extern epd_model_t epd_uc8176_420_bw;
+extern epd_model_t epd_uc8176_420_bwr;
+extern epd_model_t epd_uc8159_750_bw;
+extern epd_model_t epd_uc8159_750_bwr;
+extern epd_model_t epd_uc8179_750_bw;
+extern epd_model_t epd_uc8179_750_bwr;
+extern epd_model_t epd_ssd1619_420_bwr;
+extern epd_model_t epd_ssd1619_420_bw;
+extern epd_model_t epd_ssd1677_750_bwr;
+extern epd_model_t epd_ssd1677_750_bw;
+extern epd_model_t epd_jd79668_420_bwry;
+extern epd_model_t epd_jd79668_750_bwry;
+
+static epd_model_t *epd_models[] = {
+    &epd_uc8176_420_bw,
+    &epd_uc8176_420_bwr,
+    &epd_uc8159_750_bw,
+    &epd_uc8159_750_bwr,
+    &epd_uc8179_750_bw,
+    &epd_uc8179_750_bwr,
+    &epd_ssd1619_420_bwr,
+    &epd_ssd1619_420_bw,
+    &epd_ssd1677_750_bwr,
+    &epd_ssd1677_750_bw,
+    &epd_jd79668_420_bwry,
+    &epd_jd79668_750_bwry,
+};
+
+static epd_model_t *m_custom = NULL; // uploaded model
+
+// Same lookup as the firmware, without running the init sequence
+epd_model_t *epd_host_model(epd_model_id_t id)
+{
+    if (m_custom != NULL && m_custom->id == id) return m_custom;
+    for (uint8_t i = 0; i < ARRAY_SIZE(epd_models); i++) {
+        if (epd_models[i]->id == id)
+            return epd_models[i];
+    }
+    return NULL;
+}
+
+epd_driver_t *epd_driver(epd_driver_ic_t ic)
+{
+    for (uint8_t i = 0; i < ARRAY_SIZE(epd_models); i++) {
+        if (epd_models[i]->drv->ic == ic)
+            return epd_models[i]->drv;
+    }
+    return NULL;
+}
+
+void epd_model_register(epd_model_t *epd)
+{
+    epd_sequence_flush();
+    m_custom = epd;
+    if (m_state == EPD_STATE_STANDBY) m_state = EPD_STATE_DEEP_SLEEP;
+}
+
+static const uint8_t m_probe_reset[] = { EPD_SEQ_RESET(10), EPD_SEQ_END };
+
+bool epd_probe(epd_model_id_t id, epd_probe_t *result)
+{
+    epd_model_t *epd = epd_host_model(id);
+    if (epd == NULL) epd = epd_models[0];
+
+    memset(result, 0, sizeof(epd_probe_t));
+    result->model = epd->id;
+    epd_sequence_run(NULL, m_probe_reset);
+    m_state = EPD_STATE_OFF;
+    // every probe once, in the order of the models (UC81xx first)
+    for (uint8_t i = 0; i < ARRAY_SIZE(epd_models); i++) {
+        epd_driver_t *drv = epd_models[i]->drv;
+        bool tried = drv->probe == NULL;
+        for (uint8_t j = 0; j < i && !tried; j++)
+            tried = epd_models[j]->drv->probe == drv->probe;
+        if (tried) continue;
+
+        result->len = drv->probe(result->id);
+        if (result->len == 0) continue;
+        if (epd->drv->probe != drv->probe) epd = epd_models[i];
+        result->model = epd->id;
+        result->family = drv->family;
+        return true;
+    }
+    return false;
+}
+
+static epd_ready_t m_ready = NULL;
+
+epd_model_t *epd_init(epd_model_id_t id)
+{
+    epd_model_t *epd = epd_host_model(id);
+    if (epd == NULL) epd = epd_models[0];
+    epd_sequence_run(epd, epd->drv->init_seq);
+    if (epd->drv->init != NULL) epd->drv->init(epd);
+    m_state = EPD_STATE_STANDBY;
+    m_epd = epd;
+    return epd;
+}
+
+static void epd_resume_init(void)
+{
+    if (m_epd->drv->init != NULL) m_epd->drv->init(m_epd);
+    m_state = EPD_STATE_STANDBY;
+    m_ready(m_epd);
+}
+
+void epd_resume(epd_model_id_t id, epd_ready_t ready)
+{
+    epd_sequence_flush();
+    epd_model_t *epd = epd_host_model(id);
+    if (epd == NULL) epd = epd_models[0];
+
+    if (m_state == EPD_STATE_STANDBY && m_epd == epd && epd->drv->wake != NULL) {
+        epd->drv->wake(epd);
+        ready(epd);
+        return;
+    }
+    // the state stays until the init is done, its hook tells a power cut from a reset
+    m_epd = epd;
+    m_ready = ready;
+    epd_sequence_start(epd, epd->drv->init_seq, epd_resume_init);
+}
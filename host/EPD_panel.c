@@ -0,0 +1,647 @@
+// Virtual e-paper controller for the host build, see EPD_panel.h
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "EPD_panel.h"
+
+#define MS(ms) ((uint64_t)(ms) * 1000)
+
+// Ballpark OTP waveform durations at room temperature, only meant to compare
+// driver changes against each other, not to predict a real panel.
+typedef struct
+{
+    epd_driver_ic_t ic;
+    epd_color_t color;
+    uint16_t refresh_ms;
+} panel_timing_t;
+
+static const panel_timing_t panel_timings[] = {
+    {EPD_DRIVER_IC_UC8176,  BW,    3200},
+    {EPD_DRIVER_IC_UC8176,  BWR,  15000},
+    {EPD_DRIVER_IC_UC8179,  BW,    3500},
+    {EPD_DRIVER_IC_UC8179,  BWR,  16000},
+    {EPD_DRIVER_IC_UC8159,  BW,   11000},
+    {EPD_DRIVER_IC_UC8159,  BWR,  14000},
+    {EPD_DRIVER_IC_SSD1619, BW,    3000},
+    {EPD_DRIVER_IC_SSD1619, BWR,  15000},
+    {EPD_DRIVER_IC_SSD1677, BW,    3500},
+    {EPD_DRIVER_IC_SSD1677, BWR,  17000},
+    {EPD_DRIVER_IC_JD79668, BWRY, 20000},
+    {EPD_DRIVER_IC_JD79665, BWRY, 22000},
+};
+
+#define PANEL_POWER_ON_MS   60
+#define PANEL_POWER_OFF_MS  25
+#define PANEL_TSENSOR_MS    10
+#define PANEL_SW_RESET_MS   10
+#define PANEL_MODE2_MS      600 // SSD16xx display mode 2 (BW, differential)
+
+#define PLANE_NONE 0xFF
+
+static struct
+{
+    epd_model_t *epd;
+    bool ssd;               // SSD16xx command set, UC81xx otherwise
+    uint8_t bpp;            // RAM bits per pixel: 1, 2 (JD79668) or 4 (UC8159)
+    uint16_t row_bytes;
+    uint8_t *ram[2];        // DTM1/DTM2 or RAM1/RAM2
+    uint8_t *screen;
+    int8_t temperature;     // ambient, read by the controller sensor
+    int8_t lut_temp;        // temperature the refresh waveform is selected for
+    bool tsfix;             // UC81xx: TSSET value used instead of the sensor (CCSET TSFIX)
+    int8_t tsset;
+
+    uint8_t cmd;
+    uint32_t index;         // data bytes received since the command
+    uint8_t param[16];
+
+    uint16_t xs, xe, ys, ye; // RAM window, x in bytes, inclusive
+    uint16_t xc, yc;         // RAM address counter
+    uint8_t plane;           // RAM written / read by the current command
+    bool read_dummy;
+    bool partial;            // UC81xx: partial in (PTIN)
+    bool window;             // JD79668: partial window enabled
+    uint8_t psr;
+    uint8_t entry;           // SSD16xx data entry mode
+    uint8_t ctrl1;           // SSD16xx display update control 1
+    uint8_t ctrl2;           // SSD16xx display update sequence
+    uint8_t read_ram;        // SSD16xx RAM read option
+    bool powered;
+    bool sleeping;
+
+    uint64_t now;
+    uint64_t busy_until;
+    epd_panel_stats_t stats;
+
+    bool trace;
+    uint64_t trace_time;
+    uint32_t trace_len;
+    uint8_t trace_data[8];
+} panel;
+
+static void panel_trace_flush(void)
+{
+    if (!panel.trace || panel.epd == NULL || panel.cmd == 0xFF) return;
+    printf("%10.3f ms  %02X", panel.trace_time / 1000.0, panel.cmd);
+    for (uint32_t i = 0; i < panel.trace_len && i < sizeof(panel.trace_data); i++)
+        printf(" %02X", panel.trace_data[i]);
+    if (panel.trace_len > sizeof(panel.trace_data))
+        printf(" ... (%u bytes)", panel.trace_len);
+    printf("\n");
+}
+
+static void panel_busy(uint32_t ms)
+{
+    panel.busy_until = panel.now + MS(ms);
+}
+
+static bool panel_is_busy(void)
+{
+    return panel.now < panel.busy_until;
+}
+
+static uint32_t panel_refresh_ms(void)
+{
+    uint32_t ms = 15000;
+    for (uint8_t i = 0; i < sizeof(panel_timings) / sizeof(panel_timings[0]); i++) {
+        if (panel_timings[i].ic == panel.epd->drv->ic && panel_timings[i].color == panel.epd->color) {
+            ms = panel_timings[i].refresh_ms;
+            break;
+        }
+    }
+    // waveforms get slower in the cold
+    if (panel.lut_temp < 0) return ms * 2;
+    if (panel.lut_temp < 10) return ms * 3 / 2;
+    return ms;
+}
+
+static uint8_t panel_pixel(uint16_t x, uint16_t y)
+{
+    uint8_t *ram0 = panel.ram[0] + y * panel.row_bytes;
+    uint8_t *ram1 = panel.ram[1] + y * panel.row_bytes;
+
+    if (panel.bpp == 4) { // UC8159: 0 black, 1-2 gray, 3 white, 4 red
+        uint8_t v = (ram0[x / 2] >> ((x % 2) ? 0 : 4)) & 0x07;
+        if (v == 4) return PANEL_RED;
+        return v == 3 ? PANEL_WHITE : PANEL_BLACK;
+    }
+    if (panel.bpp == 2) { // JD79668: 0 black, 1 white, 2 yellow, 3 red
+        static const uint8_t map[4] = { PANEL_BLACK, PANEL_WHITE, PANEL_YELLOW, PANEL_RED };
+        return map[(ram0[x / 4] >> (6 - 2 * (x % 4))) & 0x03];
+    }
+
+    uint8_t bit = 0x80 >> (x % 8);
+    bool bw = (ram0[x / 8] & bit) != 0;  // 1: white
+    bool red = (ram1[x / 8] & bit) != 0;
+
+    if (panel.ssd) {
+        if (panel.epd->color != BWR) red = false; // BW panels: RAM2 is the previous image (display mode 2)
+        switch (panel.ctrl1 >> 4) { // red RAM option
+            case 0x4: red = false; break;
+            case 0x8: red = !red; break;
+            default: break;
+        }
+        switch (panel.ctrl1 & 0x0F) { // BW RAM option
+            case 0x4: bw = false; break;
+            case 0x8: bw = !bw; break;
+            default: break;
+        }
+        if (red) return PANEL_RED;
+        return bw ? PANEL_WHITE : PANEL_BLACK;
+    }
+
+    if (panel.psr & 0x10) // KW mode: DTM2 is the new image
+        return red ? PANEL_WHITE : PANEL_BLACK;
+    if (!red) return PANEL_RED;
+    return bw ? PANEL_WHITE : PANEL_BLACK;
+}
+
+// Transfer RAM to the glass, x in RAM bytes
+static void panel_display(uint16_t xs, uint16_t xe, uint16_t ys, uint16_t ye)
+{
+    uint16_t x0 = xs * 8 / panel.bpp;
+    uint16_t x1 = (xe + 1) * 8 / panel.bpp;
+    uint16_t width = panel.epd->width;
+
+    if (x1 > width) x1 = width;
+    if (ye >= panel.epd->height) ye = panel.epd->height - 1;
+    for (uint16_t y = ys; y <= ye; y++)
+        for (uint16_t x = x0; x < x1; x++)
+            panel.screen[y * width + x] = panel_pixel(x, y);
+}
+
+static void panel_reset_registers(void)
+{
+    panel.xs = 0;
+    panel.xe = panel.row_bytes - 1;
+    panel.ys = 0;
+    panel.ye = panel.epd->height - 1;
+    panel.xc = 0;
+    panel.yc = 0;
+    panel.plane = PLANE_NONE;
+    panel.partial = false;
+    panel.window = false;
+    panel.psr = 0x0F;
+    panel.entry = 0x03;
+    panel.ctrl1 = 0x00;
+    panel.ctrl2 = 0xFF;
+    panel.read_ram = 0x00;
+    panel.sleeping = false;
+    panel.tsfix = false;
+    panel.lut_temp = panel.temperature;
+}
+
+// Address counter in the data entry direction (SSD16xx), always X then Y increment on UC81xx
+static void panel_advance(void)
+{
+    bool am = panel.ssd && (panel.entry & 0x04);
+    bool xinc = !panel.ssd || (panel.entry & 0x01);
+    bool yinc = !panel.ssd || (panel.entry & 0x02);
+    bool wrap;
+
+    if (!am) {
+        wrap = xinc ? (panel.xc++ >= panel.xe) : (panel.xc-- <= panel.xs);
+        if (!wrap) return;
+        panel.xc = xinc ? panel.xs : panel.xe;
+        wrap = yinc ? (panel.yc++ >= panel.ye) : (panel.yc-- <= panel.ys);
+        if (wrap) panel.yc = yinc ? panel.ys : panel.ye;
+    } else {
+        wrap = yinc ? (panel.yc++ >= panel.ye) : (panel.yc-- <= panel.ys);
+        if (!wrap) return;
+        panel.yc = yinc ? panel.ys : panel.ye;
+        wrap = xinc ? (panel.xc++ >= panel.xe) : (panel.xc-- <= panel.xs);
+        if (wrap) panel.xc = xinc ? panel.xs : panel.xe;
+    }
+}
+
+static uint8_t *panel_ram_at(uint8_t plane)
+{
+    if (plane > 1 || panel.xc >= panel.row_bytes || panel.yc >= panel.epd->height)
+        return NULL;
+    return &panel.ram[plane][panel.yc * panel.row_bytes + panel.xc];
+}
+
+// UC81xx DTM1/DTM2 start at the window in partial mode, at 0 otherwise
+static void uc81xx_start_transmission(uint8_t plane)
+{
+    if (!panel.partial && !panel.window) {
+        panel.xs = 0;
+        panel.xe = panel.row_bytes - 1;
+        panel.ys = 0;
+        panel.ye = panel.epd->height - 1;
+    }
+    panel.xc = panel.xs;
+    panel.yc = panel.ys;
+    panel.plane = plane;
+}
+
+static void uc81xx_set_window(uint8_t *p)
+{
+    uint16_t xs = (p[0] << 8) | p[1];
+    uint16_t xe = (p[2] << 8) | p[3];
+    panel.xs = xs * panel.bpp / 8;
+    panel.xe = (xe + 1) * panel.bpp / 8 - 1;
+    panel.ys = (p[4] << 8) | p[5];
+    panel.ye = (p[6] << 8) | p[7];
+}
+
+static void uc81xx_command(uint8_t cmd)
+{
+    switch (cmd) {
+        case UC81xx_PON:
+            panel.powered = true;
+            panel_busy(PANEL_POWER_ON_MS);
+            break;
+        case UC81xx_POF:
+            panel.powered = false;
+            panel_busy(PANEL_POWER_OFF_MS);
+            break;
+        case UC81xx_DTM1:
+            uc81xx_start_transmission(0);
+            break;
+        case UC81xx_DTM2:
+            uc81xx_start_transmission(1);
+            break;
+        case UC81xx_DRF:
+            if (!panel.powered) {
+                panel.stats.errors++;
+                break;
+            }
+            panel.lut_temp = panel.tsfix ? panel.tsset : panel.temperature;
+            if (panel.partial || panel.window) {
+                panel_display(panel.xs, panel.xe, panel.ys, panel.ye);
+                panel.stats.partials++;
+            } else {
+                panel_display(0, panel.row_bytes - 1, 0, panel.epd->height - 1);
+                panel.stats.refreshes++;
+            }
+            panel_busy(panel_refresh_ms() + (panel.tsfix ? 0 : PANEL_TSENSOR_MS));
+            break;
+        case UC81xx_PTIN:
+            panel.partial = true;
+            break;
+        case UC81xx_PTOUT:
+            panel.partial = false;
+            break;
+        case UC81xx_TSC:
+            panel_busy(PANEL_TSENSOR_MS);
+            break;
+        default:
+            break;
+    }
+}
+
+static void uc81xx_data(uint8_t *p, uint32_t count)
+{
+    switch (panel.cmd) {
+        case UC81xx_PSR:
+            if (count == 1) panel.psr = p[0];
+            break;
+        case UC81xx_PTL:
+            if (count == 8) uc81xx_set_window(p);
+            break;
+        case 0x83: // JD79668 partial window
+            if (panel.epd->drv->ic != EPD_DRIVER_IC_JD79668 && panel.epd->drv->ic != EPD_DRIVER_IC_JD79665)
+                break;
+            if (count == 8) uc81xx_set_window(p);
+            if (count == 9) panel.window = p[8] & 0x01;
+            break;
+        case UC81xx_DSLP:
+            if (count == 1 && p[0] == 0xA5) panel.sleeping = true;
+            break;
+        case UC81xx_CCSET:
+            if (count == 1) panel.tsfix = p[0] & 0x02;
+            break;
+        case UC81xx_TSSET: // FLASH MODE on UC8159, only used with TSFIX
+            if (count == 1) panel.tsset = (int8_t)p[0];
+            break;
+        default:
+            break;
+    }
+}
+
+// Display mode 2 drives the pixels where RAM1 differs from RAM2, only right if RAM2 holds the
+// image on the glass and the panel has no red
+static bool ssd16xx_mode2_check(void)
+{
+    if (panel.epd->color == BWR) return false;
+    for (uint16_t y = 0; y < panel.epd->height; y++) {
+        for (uint16_t x = 0; x < panel.epd->width; x++) {
+            bool white = (panel.ram[1][y * panel.row_bytes + x / 8] & (0x80 >> (x % 8))) != 0;
+            if (white != (panel.screen[y * panel.epd->width + x] == PANEL_WHITE)) return false;
+        }
+    }
+    return true;
+}
+
+static void ssd16xx_command(uint8_t cmd)
+{
+    switch (cmd) {
+        case SSD16xx_SW_RESET:
+            panel_reset_registers();
+            panel_busy(PANEL_SW_RESET_MS);
+            break;
+        case SSD16xx_MASTER_ACTIVATE:
+            if (panel.ctrl2 & 0x40) panel.powered = true;  // enable analog
+            if (panel.ctrl2 & 0x04) {                      // display
+                if (!panel.powered) {
+                    panel.stats.errors++;
+                } else {
+                    bool load = panel.ctrl2 & 0x20;
+                    bool mode2 = panel.ctrl2 & 0x08;
+                    if (load) panel.lut_temp = panel.temperature;
+                    if (mode2 && !ssd16xx_mode2_check()) panel.stats.errors++;
+                    panel_display(0, panel.row_bytes - 1, 0, panel.epd->height - 1);
+                    if (mode2) panel.stats.partials++;
+                    else panel.stats.refreshes++;
+                    panel_busy((mode2 ? PANEL_MODE2_MS : panel_refresh_ms()) + (load ? PANEL_TSENSOR_MS : 0));
+                }
+            } else if (panel.ctrl2 & 0x20) {               // load temperature
+                panel.lut_temp = panel.temperature;
+                panel_busy(PANEL_TSENSOR_MS);
+            }
+            if (panel.ctrl2 & 0x02) panel.powered = false; // disable analog
+            break;
+        case SSD16xx_WRITE_RAM1:
+            panel.plane = 0;
+            break;
+        case SSD16xx_WRITE_RAM2:
+            panel.plane = 1;
+            break;
+        case SSD16xx_READ_RAM:
+            panel.plane = panel.read_ram & 0x01;
+            panel.read_dummy = true;
+            break;
+        default:
+            break;
+    }
+}
+
+static void ssd16xx_data(uint8_t *p, uint32_t count)
+{
+    bool hd = panel.epd->drv->ic == EPD_DRIVER_IC_SSD1677; // X addresses in pixels
+
+    switch (panel.cmd) {
+        case SSD16xx_ENTRY_MODE:
+            if (count == 1) panel.entry = p[0];
+            break;
+        case SSD16xx_RAM_XPOS:
+            if (!hd && count == 2) {
+                panel.xs = p[0];
+                panel.xe = p[1];
+            } else if (hd && count == 4) {
+                panel.xs = (p[0] | (p[1] << 8)) / 8;
+                panel.xe = (p[2] | (p[3] << 8)) / 8;
+            }
+            break;
+        case SSD16xx_RAM_YPOS:
+            if (count == 4) {
+                panel.ys = p[0] | (p[1] << 8);
+                panel.ye = p[2] | (p[3] << 8);
+            }
+            break;
+        case SSD16xx_RAM_XCOUNT:
+            if (!hd && count == 1) panel.xc = p[0];
+            else if (hd && count == 2) panel.xc = (p[0] | (p[1] << 8)) / 8;
+            break;
+        case SSD16xx_RAM_YCOUNT:
+            if (count == 2) panel.yc = p[0] | (p[1] << 8);
+            break;
+        case SSD16xx_TSENSOR_WRITE:
+            if (count == 1) panel.lut_temp = (int8_t)p[0];
+            break;
+        case SSD16xx_DISP_CTRL1:
+            if (count == 1) panel.ctrl1 = p[0];
+            break;
+        case SSD16xx_DISP_CTRL2:
+            if (count == 1) panel.ctrl2 = p[0];
+            break;
+        case SSD16xx_RAM_READ_CTRL:
+            if (count == 1) panel.read_ram = p[0];
+            break;
+        case SSD16xx_SLEEP_MODE:
+            if (count == 1 && (p[0] & 0x03)) panel.sleeping = true;
+            break;
+        default:
+            break;
+    }
+}
+
+void epd_panel_init(epd_model_t *epd, int8_t temperature)
+{
+    bool trace = panel.trace;
+
+    epd_panel_uninit();
+    memset(&panel, 0, sizeof(panel));
+    panel.trace = trace;
+
+    panel.epd = epd;
+    panel.ssd = epd->drv->ic == EPD_DRIVER_IC_SSD1619 || epd->drv->ic == EPD_DRIVER_IC_SSD1677;
+    if (epd->drv->ic == EPD_DRIVER_IC_UC8159)
+        panel.bpp = 4;
+    else if (epd->drv->ic == EPD_DRIVER_IC_JD79668 || epd->drv->ic == EPD_DRIVER_IC_JD79665)
+        panel.bpp = 2;
+    else
+        panel.bpp = 1;
+    panel.row_bytes = (epd->width * panel.bpp + 7) / 8;
+    panel.temperature = temperature;
+    panel.cmd = 0xFF;
+
+    uint32_t ram_size = (uint32_t)panel.row_bytes * epd->height;
+    panel.ram[0] = malloc(ram_size);
+    panel.ram[1] = malloc(ram_size);
+    panel.screen = malloc((uint32_t)epd->width * epd->height);
+    if (panel.ram[0] == NULL || panel.ram[1] == NULL || panel.screen == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    // white in every RAM format: 1bpp 0xFF, UC8159 0x33, JD79668 0x55
+    memset(panel.ram[0], panel.bpp == 4 ? 0x33 : (panel.bpp == 2 ? 0x55 : 0xFF), ram_size);
+    memset(panel.ram[1], 0xFF, ram_size);
+    memset(panel.screen, PANEL_WHITE, (uint32_t)epd->width * epd->height);
+
+    panel_reset_registers();
+}
+
+void epd_panel_uninit(void)
+{
+    panel_trace_flush();
+    panel.cmd = 0xFF;
+    free(panel.ram[0]);
+    free(panel.ram[1]);
+    free(panel.screen);
+    panel.ram[0] = panel.ram[1] = panel.screen = NULL;
+}
+
+void epd_panel_reset(void)
+{
+    if (panel.epd == NULL) return;
+    panel_trace_flush();
+    panel.cmd = 0xFF;
+    panel.stats.resets++;
+    panel.powered = false;
+    panel.busy_until = panel.now;
+    panel_reset_registers();
+}
+
+void epd_panel_release(void)
+{
+    if (panel.epd == NULL || panel.ram[0] == NULL) return;
+    panel_trace_flush();
+    panel.cmd = 0xFF;
+    panel.powered = false;
+    panel.busy_until = panel.now;
+    panel_reset_registers();
+    // the RAM does not survive, garbage shows up if a driver relies on it
+    uint32_t ram_size = (uint32_t)panel.row_bytes * panel.epd->height;
+    memset(panel.ram[0], 0x11, ram_size);
+    memset(panel.ram[1], 0x11, ram_size);
+}
+
+void epd_panel_command(uint8_t cmd)
+{
+    panel_trace_flush();
+    if (panel.epd == NULL) { // no panel attached (epd_panel_init)
+        panel.cmd = 0xFF;
+        return;
+    }
+    panel.stats.commands++;
+    if (panel.sleeping) {
+        panel.stats.ignored++;
+        panel.cmd = 0xFF;
+        return;
+    }
+    if (panel_is_busy()) // the controllers do not accept commands while BUSY
+        panel.stats.errors++;
+
+    panel.cmd = cmd;
+    panel.index = 0;
+    panel.plane = PLANE_NONE;
+    panel.trace_time = panel.now;
+    panel.trace_len = 0;
+
+    if (panel.ssd)
+        ssd16xx_command(cmd);
+    else
+        uc81xx_command(cmd);
+}
+
+void epd_panel_data(uint8_t *value, uint8_t len)
+{
+    panel.stats.data_bytes += len;
+    if (panel.sleeping || panel.cmd == 0xFF) {
+        panel.stats.ignored += len;
+        return;
+    }
+
+    for (uint8_t i = 0; i < len; i++) {
+        if (panel.trace_len < sizeof(panel.trace_data))
+            panel.trace_data[panel.trace_len] = value[i];
+        panel.trace_len++;
+
+        if (panel.plane != PLANE_NONE) {
+            uint8_t *ram = panel_ram_at(panel.plane);
+            if (ram != NULL)
+                *ram = value[i];
+            else
+                panel.stats.errors++;
+            panel_advance();
+            continue;
+        }
+
+        if (panel.index < sizeof(panel.param))
+            panel.param[panel.index] = value[i];
+        panel.index++;
+        if (panel.ssd)
+            ssd16xx_data(panel.param, panel.index);
+        else
+            uc81xx_data(panel.param, panel.index);
+    }
+}
+
+void epd_panel_read(uint8_t *value, uint8_t len)
+{
+    panel.stats.read_bytes += len;
+    memset(value, 0xFF, len);
+    if (panel.sleeping || panel.epd == NULL || panel.cmd == 0xFF) return;
+
+    for (uint8_t i = 0; i < len; i++) {
+        if (panel.ssd && panel.cmd == SSD16xx_READ_RAM) {
+            if (panel.read_dummy) {
+                panel.read_dummy = false;
+                value[i] = 0x00;
+                continue;
+            }
+            uint8_t *ram = panel_ram_at(panel.plane);
+            value[i] = ram ? *ram : 0x00;
+            panel_advance();
+            continue;
+        }
+
+        switch (panel.ssd ? panel.cmd | 0x100 : panel.cmd) {
+            case UC81xx_TSC:
+            case SSD16xx_TSENSOR_READ | 0x100:
+                value[i] = panel.index++ == 0 ? (uint8_t)panel.temperature : 0x00;
+                break;
+            case UC81xx_FLG: // BUSY_N, POF, PON
+                value[i] = (panel_is_busy() ? 0x00 : 0x01) | (panel.powered ? 0x04 : 0x02);
+                break;
+            case SSD16xx_READ_STATUS | 0x100: // busy flag, chip ID 01
+                value[i] = panel.index++ == 0 ? (panel_is_busy() ? 0x04 : 0x00) | 0x01 : 0xFF;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+uint32_t epd_panel_busy_pin(void)
+{
+    bool busy = panel_is_busy();
+    if (panel.epd == NULL) return LOW; // not connected
+    // UC81xx/JD79668 pull BUSY low while busy, SSD16xx drive it high
+    if (panel.ssd)
+        return busy ? HIGH : LOW;
+    return busy ? LOW : HIGH;
+}
+
+int8_t epd_panel_temperature(void)
+{
+    return panel.temperature;
+}
+
+uint64_t epd_panel_time(void)
+{
+    return panel.now;
+}
+
+void epd_panel_advance(uint64_t us)
+{
+    panel.now += us;
+    panel.stats.time_us += us;
+}
+
+void epd_panel_trace(bool enable)
+{
+    panel.trace = enable;
+}
+
+epd_panel_stats_t *epd_panel_stats(void)
+{
+    return &panel.stats;
+}
+
+uint8_t *epd_panel_screen(void)
+{
+    return panel.screen;
+}
+
+uint16_t epd_panel_width(void)
+{
+    return panel.epd->width;
+}
+
+uint16_t epd_panel_height(void)
+{
+    return panel.epd->height;
+}
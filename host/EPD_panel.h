@@ -0,0 +1,70 @@
+// Virtual e-paper controller for the host build.
+// Decodes the UC81xx / SSD16xx / JD79668 command streams sent through the host
+// HAL (EPD_host.c) into controller RAM and a displayed image, and models the
+// BUSY timing of power, reset and refresh sequences.
+#ifndef __EPD_PANEL_H
+#define __EPD_PANEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "EPD_driver.h"
+
+enum { PANEL_WHITE = 0, PANEL_BLACK, PANEL_RED, PANEL_YELLOW };
+
+typedef struct
+{
+    uint32_t commands;      /**< command bytes (D/C low) */
+    uint32_t data_bytes;    /**< data bytes written (D/C high) */
+    uint32_t read_bytes;    /**< data bytes read back */
+    uint32_t transfers;     /**< SPI transactions, one per EPD_WriteCmd/EPD_WriteData/EPD_ReadData */
+    uint32_t resets;        /**< hardware resets */
+    uint32_t refreshes;     /**< full refreshes */
+    uint32_t partials;      /**< partial refreshes */
+    uint32_t busy_waits;    /**< EPD_WaitBusy calls */
+    uint32_t busy_timeouts; /**< EPD_WaitBusy calls that timed out */
+    uint32_t ignored;       /**< bytes sent while the controller was in deep sleep */
+    uint32_t errors;        /**< protocol errors, e.g. refresh while powered off */
+    uint64_t spi_us;        /**< modeled SPI transfer time */
+    uint64_t busy_us;       /**< time spent in EPD_WaitBusy */
+    uint64_t delay_us;      /**< time spent in delay() */
+    uint64_t wait_us;       /**< timer waits of the step executor (EPD_sequence.c), the MCU sleeps */
+    uint64_t time_us;       /**< total modeled time */
+} epd_panel_stats_t;
+
+// Setup the controller of a model, RAM is filled with white
+void epd_panel_init(epd_model_t *epd, int8_t temperature);
+void epd_panel_uninit(void);
+
+// Bus interface, used by the host HAL
+void epd_panel_reset(void);
+void epd_panel_release(void); // RST held low or power removed: registers back to their reset values
+void epd_panel_command(uint8_t cmd);
+void epd_panel_data(uint8_t *value, uint8_t len);
+void epd_panel_read(uint8_t *value, uint8_t len);
+uint32_t epd_panel_busy_pin(void);
+
+// Ambient temperature of the panel, also returned as the MCU die temperature
+int8_t epd_panel_temperature(void);
+
+// Modeled time, advanced by SPI transfers, delays and busy waits
+uint64_t epd_panel_time(void);
+void epd_panel_advance(uint64_t us);
+
+// Print every command with its data while true
+void epd_panel_trace(bool enable);
+
+// Statistics since the last epd_panel_init()
+epd_panel_stats_t *epd_panel_stats(void);
+
+// Displayed image, one PANEL_* value per pixel (what the glass shows after the last refresh)
+uint8_t *epd_panel_screen(void);
+uint16_t epd_panel_width(void);
+uint16_t epd_panel_height(void);
+
+// Model lookup of the host HAL (EPD_host.c), does not touch the controller
+epd_model_t *epd_host_model(epd_model_id_t id);
+
+// Supply voltage returned by EPD_ReadVoltage() (default 3.0 V)
+void epd_host_set_voltage(float voltage);
+
+#endif
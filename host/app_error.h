@@ -0,0 +1,19 @@
+// Host replacement of the nRF5 SDK header. The device resets on a failed
+// check, the host aborts so that the harness and fuzzer report it.
+#ifndef APP_ERROR_H__
+#define APP_ERROR_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "sdk_errors.h"
+
+#define APP_ERROR_CHECK(ERR_CODE)                                                           \
+    do {                                                                                    \
+        const uint32_t LOCAL_ERR_CODE = (ERR_CODE);                                         \
+        if (LOCAL_ERR_CODE != NRF_SUCCESS) {                                                \
+            fprintf(stderr, "%s:%d: error 0x%x\n", __FILE__, __LINE__, (unsigned)LOCAL_ERR_CODE); \
+            abort();                                                                        \
+        }                                                                                   \
+    } while (0)
+
+#endif
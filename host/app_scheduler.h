@@ -0,0 +1,13 @@
+// Host replacement of the nRF5 SDK header, events are queued in sdk_host.c and
+// run by app_sched_execute() as in the firmware main loop
+#ifndef APP_SCHEDULER_H__
+#define APP_SCHEDULER_H__
+
+#include <stdint.h>
+
+typedef void (*app_sched_event_handler_t)(void * p_event_data, uint16_t event_size);
+
+uint32_t app_sched_event_put(void const * p_event_data, uint16_t event_size, app_sched_event_handler_t handler);
+void app_sched_execute(void);
+
+#endif
@@ -0,0 +1,40 @@
+// Host replacement of the nRF5 SDK header. Timers run on the modeled time of
+// sdk_host_timers_advance() (sdk_host.c), one tick per millisecond.
+#ifndef APP_TIMER_H__
+#define APP_TIMER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef void (*app_timer_timeout_handler_t)(void * p_context);
+
+typedef struct {
+    app_timer_timeout_handler_t handler;
+    bool repeated;
+    bool active;
+    uint32_t interval;
+    uint32_t remaining;
+    void *p_context;
+} app_timer_t;
+
+typedef app_timer_t * app_timer_id_t;
+
+typedef enum {
+    APP_TIMER_MODE_SINGLE_SHOT,
+    APP_TIMER_MODE_REPEATED,
+} app_timer_mode_t;
+
+#define APP_TIMER_DEF(timer_id)                   \
+    static app_timer_t timer_id##_data = { 0 };   \
+    static const app_timer_id_t timer_id = &timer_id##_data
+
+#define APP_TIMER_TICKS(MS) (MS)
+
+uint32_t app_timer_init(void);
+uint32_t app_timer_create(app_timer_id_t const * p_timer_id, app_timer_mode_t mode,
+                          app_timer_timeout_handler_t timeout_handler);
+uint32_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void * p_context);
+uint32_t app_timer_stop(app_timer_id_t timer_id);
+uint32_t app_timer_cnt_get(void);
+
+#endif
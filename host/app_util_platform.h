@@ -0,0 +1,8 @@
+// Host replacement of the nRF5 SDK header, single threaded: no critical regions needed
+#ifndef APP_UTIL_PLATFORM_H__
+#define APP_UTIL_PLATFORM_H__
+
+#define CRITICAL_REGION_ENTER() {
+#define CRITICAL_REGION_EXIT()  }
+
+#endif
@@ -0,0 +1,84 @@
+// Host replacement of the SoftDevice header, the events and calls used by the
+// EPD service. The SoftDevice itself is stubbed in sdk_host.c.
+#ifndef BLE_H__
+#define BLE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "nrf.h"
+#include "nordic_common.h"
+#include "sdk_errors.h"
+
+#define BLE_CONN_HANDLE_INVALID     0xFFFF
+#define BLE_UUID_TYPE_VENDOR_BEGIN  0x02
+#define BLE_GATTS_SRVC_TYPE_PRIMARY 0x01
+#define BLE_GATT_HVX_NOTIFICATION   0x01
+
+enum {
+    BLE_GAP_EVT_CONNECTED    = 0x10,
+    BLE_GAP_EVT_DISCONNECTED = 0x11,
+    BLE_GATTS_EVT_WRITE      = 0x50,
+};
+
+typedef struct {
+    uint16_t uuid;
+    uint8_t type;
+} ble_uuid_t;
+
+typedef struct {
+    uint8_t uuid128[16];
+} ble_uuid128_t;
+
+typedef struct {
+    uint16_t value_handle;
+    uint16_t user_desc_handle;
+    uint16_t cccd_handle;
+    uint16_t sccd_handle;
+} ble_gatts_char_handles_t;
+
+typedef struct {
+    uint16_t handle;
+    uint8_t type;
+    uint16_t offset;
+    uint16_t *p_len;
+    uint8_t const *p_data;
+} ble_gatts_hvx_params_t;
+
+typedef struct {
+    uint16_t handle;
+    uint8_t op;
+    uint16_t offset;
+    uint16_t len;
+    uint8_t data[1]; // variable length, as in the SoftDevice
+} ble_gatts_evt_write_t;
+
+typedef struct {
+    uint16_t evt_id;
+    uint16_t evt_len;
+} ble_evt_hdr_t;
+
+typedef struct {
+    uint16_t conn_handle;
+} ble_gap_evt_t;
+
+typedef struct {
+    uint16_t conn_handle;
+    union {
+        ble_gatts_evt_write_t write;
+    } params;
+} ble_gatts_evt_t;
+
+typedef struct {
+    ble_evt_hdr_t header;
+    union {
+        ble_gap_evt_t gap_evt;
+        ble_gatts_evt_t gatts_evt;
+    } evt;
+} ble_evt_t;
+
+uint32_t sd_ble_uuid_vs_add(ble_uuid128_t const *p_vs_uuid, uint8_t *p_uuid_type);
+uint32_t sd_ble_gatts_service_add(uint8_t type, ble_uuid_t const *p_uuid, uint16_t *p_handle);
+uint32_t sd_ble_gatts_hvx(uint16_t conn_handle, ble_gatts_hvx_params_t const *p_hvx_params);
+uint32_t sd_ble_gap_device_name_get(uint8_t *p_dev_name, uint16_t *p_len);
+
+#endif
@@ -0,0 +1,45 @@
+// Host replacement of the nRF5 SDK header
+#ifndef BLE_SRV_COMMON_H__
+#define BLE_SRV_COMMON_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "app_error.h"
+#include "ble.h"
+
+typedef enum {
+    SEC_NO_ACCESS = 0,
+    SEC_OPEN      = 1,
+} security_req_t;
+
+typedef struct {
+    uint8_t broadcast;
+    uint8_t read;
+    uint8_t write_wo_resp;
+    uint8_t write;
+    uint8_t notify;
+    uint8_t indicate;
+    uint8_t auth_signed_wr;
+} ble_gatt_char_props_t;
+
+typedef struct {
+    uint16_t uuid;
+    uint8_t uuid_type;
+    uint16_t max_len;
+    uint16_t init_len;
+    uint8_t *p_init_value;
+    bool is_var_len;
+    ble_gatt_char_props_t char_props;
+    bool is_defered_read;
+    bool is_defered_write;
+    security_req_t read_access;
+    security_req_t write_access;
+    security_req_t cccd_write_access;
+    bool is_value_user;
+} ble_add_char_params_t;
+
+uint32_t characteristic_add(uint16_t service_handle, ble_add_char_params_t *p_char_props,
+                            ble_gatts_char_handles_t *p_char_handle);
+bool ble_srv_is_notification_enabled(uint8_t const *p_encoded_data);
+
+#endif
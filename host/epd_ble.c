@@ -0,0 +1,447 @@
+// BLE command parser harness
+// Runs EPD_service.c and EPD_config.c on the host, against the SoftDevice/FDS
+// stubs in sdk_host.c and the panel drivers on the virtual controller. GATT
+// writes come from a session file, which is also the input format of the
+// libFuzzer target (make -f Makefile.linux fuzz):
+//
+//   len payload[len]   one write to the EPD characteristic, len is clamped to
+//                      the data length of the connection (ATT MTU - 3)
+//   0x00               disconnect and reconnect
+//   0xFF               one minute passes (RTC tick at hh:mm:00)
+//
+// The firmware resets (SYS_RESET, CFG_ERASE, SYS_SLEEP) reboot the service
+// with the flash content kept, and the peer reconnects.
+#define _POSIX_C_SOURCE 200809L
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include "app_scheduler.h"
+#include "EPD_service.h"
+#include "EPD_panel.h"
+#include "EPD_capture.h"
+#include "EPD_energy.h"
+#include "sdk_host.h"
+#include "main.h"
+
+#define SESSION_RECONNECT 0x00
+#define SESSION_MINUTE    0xFF
+#define SESSION_TIMESTAMP 1735689600 // 2025-01-01 00:00:00
+#define DEFAULT_ATT_MTU   (NRF_SDH_BLE_GATT_MAX_MTU_SIZE)
+#define ADV_INTERVAL_MS   1000 // APP_ADV_INTERVAL
+
+typedef struct {
+    uint32_t writes;
+    uint32_t bytes;
+    uint32_t reconnects;
+    uint32_t minutes;
+    uint32_t reboots;
+} session_stats_t;
+
+static ble_epd_t m_epd;
+static uint32_t m_timestamp;
+static epd_model_t *m_panel_model;
+static uint16_t m_data_len;
+static bool m_verbose;
+static session_stats_t m_session;
+
+// main.c
+uint32_t timestamp(void)
+{
+    return m_timestamp;
+}
+
+void set_timestamp(uint32_t timestamp)
+{
+    m_timestamp = timestamp;
+}
+
+// the session advances the time itself, there is no timer to reschedule
+void clock_reschedule(void)
+{
+}
+
+void sleep_mode_enter(void)
+{
+    epd_config_flush(sdk_host_request_reset);
+}
+
+void app_feed_wdt(void)
+{
+}
+
+static void HexDump(const char *prefix, uint8_t const *data, uint16_t len)
+{
+    printf("%s", prefix);
+    for (uint16_t i = 0; i < len; i++) printf(" %02x", data[i]);
+    printf("\n");
+}
+
+static void OnNotify(uint8_t const *data, uint16_t len)
+{
+    if (m_verbose) HexDump("<-", data, len);
+}
+
+// Keep the virtual controller on the model the firmware is about to drive,
+// epd_init() falls back to the first model for unknown ids
+static void PanelSelect(uint8_t id)
+{
+    epd_model_t *model = epd_host_model((epd_model_id_t)id);
+    if (model == NULL) model = epd_host_model(EPD_UC8176_420_BW);
+    if (model == m_panel_model) return;
+
+    if (m_panel_model) epd_panel_uninit();
+    epd_panel_init(model, 25);
+    m_panel_model = model;
+}
+
+static void BleEvent(uint16_t evt_id)
+{
+    ble_evt_t evt;
+    memset(&evt, 0, sizeof(evt));
+    evt.header.evt_id = evt_id;
+    ble_epd_on_ble_evt(&m_epd, &evt);
+}
+
+// The event is allocated with the exact payload size (variable length, as
+// from the SoftDevice) so that reads past the end are caught by the address
+// sanitizer
+static void GattWrite(uint16_t handle, uint8_t const *data, uint16_t len)
+{
+    size_t size = offsetof(ble_evt_t, evt.gatts_evt.params.write.data) + len;
+    ble_evt_t *evt = malloc(size);
+    if (evt == NULL) return;
+
+    memset(evt, 0, size);
+    evt->header.evt_id = BLE_GATTS_EVT_WRITE;
+    evt->evt.gatts_evt.params.write.handle = handle;
+    evt->evt.gatts_evt.params.write.len = len;
+    memcpy(evt->evt.gatts_evt.params.write.data, data, len);
+    ble_epd_on_ble_evt(&m_epd, evt);
+    free(evt);
+}
+
+// Power on / reset, as main()
+static void Boot(void)
+{
+    memset(&m_epd, 0, sizeof(ble_epd_t));
+    EPD_Capture_Stop();
+    ble_epd_init(&m_epd);
+}
+
+// Connection, MTU exchange and CCCD write of the web UI
+static void Connect(void)
+{
+    uint8_t cccd[2] = { 0x01, 0x00 };
+
+    BleEvent(BLE_GAP_EVT_CONNECTED);
+    epd_energy_radio(ENERGY_CONNECTED, 0, m_timestamp);
+    m_epd.max_data_len = m_data_len;
+    GattWrite(m_epd.char_handles.cccd_handle, cccd, sizeof(cccd));
+}
+
+static void Disconnect(void)
+{
+    PanelSelect(m_epd.epd ? m_epd.epd->id : m_epd.config.model_id);
+    BleEvent(BLE_GAP_EVT_DISCONNECTED);
+    epd_energy_radio(ENERGY_ADVERTISING, ADV_INTERVAL_MS, m_timestamp);
+}
+
+// Main loop after an event: scheduled GUI updates, then a reboot if requested
+static void Idle(void)
+{
+    PanelSelect(m_epd.config.model_id);
+    app_sched_execute();
+    if (sdk_host_reset_pending()) {
+        m_session.reboots++;
+        Boot();
+        Connect();
+    }
+}
+
+static void Write(uint8_t const *data, uint16_t len)
+{
+    if (m_verbose) HexDump("->", data, len);
+    if (len > 0 && data[0] == EPD_CMD_INIT)
+        PanelSelect(len > 1 ? data[1] : m_epd.config.model_id);
+    else
+        PanelSelect(m_epd.epd ? m_epd.epd->id : m_epd.config.model_id);
+
+    m_session.writes++;
+    m_session.bytes += len;
+    GattWrite(m_epd.char_handles.value_handle, data, len);
+    Idle();
+}
+
+// One session on a freshly erased device
+static void Session(uint8_t const *data, size_t size)
+{
+    memset(&m_session, 0, sizeof(m_session));
+    sdk_host_flash_erase();
+    m_timestamp = SESSION_TIMESTAMP;
+    if (m_panel_model) epd_panel_uninit();
+    m_panel_model = NULL;
+
+    Boot();
+    Connect();
+    for (size_t pos = 0; pos < size;) {
+        uint8_t len = data[pos++];
+        if (len == SESSION_RECONNECT) {
+            Disconnect();
+            Connect();
+            m_session.reconnects++;
+        } else if (len == SESSION_MINUTE) {
+            m_timestamp += 60 - m_timestamp % 60;
+            sdk_host_timers_advance(60000);
+            ble_epd_on_timer(&m_epd, m_timestamp, false);
+            Idle();
+            m_session.minutes++;
+        } else {
+            if (len > size - pos) len = size - pos;
+            Write(&data[pos], len > m_data_len ? m_data_len : len);
+            pos += len;
+        }
+    }
+    Disconnect();
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    m_data_len = DEFAULT_ATT_MTU - 3;
+    Session(data, size);
+    return 0;
+}
+
+#if !defined(EPD_BLE_FUZZER)
+static uint8_t *LoadFile(const char *path, size_t *size)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        perror(path);
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    long len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    uint8_t *data = malloc(len > 0 ? len : 1);
+    if (data && fread(data, 1, len, fp) != (size_t)len) {
+        free(data);
+        data = NULL;
+    }
+    fclose(fp);
+    *size = len;
+    return data;
+}
+
+static void SessionAppend(uint8_t **buf, size_t *size, uint8_t const *data, uint8_t len)
+{
+    *buf = realloc(*buf, *size + 1 + len);
+    (*buf)[(*size)++] = len;
+    memcpy(*buf + *size, data, len);
+    *size += len;
+}
+
+// Image upload of the web UI (sendimg in html/js/main.js): INIT, the frame in
+// WRITE_IMAGE chunks of (data length - 2) bytes, REFRESH
+static int Generate(const char *path, uint8_t id, uint16_t data_len)
+{
+    epd_model_t *model = epd_host_model((epd_model_id_t)id);
+    uint8_t *buf = NULL, chunk[BLE_EPD_MAX_DATA_LEN];
+    size_t size = 0;
+    uint32_t seed = 1;
+
+    if (model == NULL) {
+        fprintf(stderr, "unknown model id: %d\n", id);
+        return 1;
+    }
+    if (data_len < 3 || data_len > BLE_EPD_MAX_DATA_LEN) {
+        fprintf(stderr, "data length out of range: %d\n", data_len);
+        return 1;
+    }
+
+    // bytes and cfg of the black ('bw') and red steps
+    uint32_t plane = (uint32_t)model->width * model->height / 8;
+    uint32_t lens[2] = { plane, 0 };
+    uint8_t cfgs[2] = { 0x0F, 0x00 };
+    if (model->color == BWRY) {
+        lens[0] = plane * 2;                        // 'color', 2bpp
+        cfgs[0] = 0x00;
+    } else if (model->color == BWR && model->drv->ic == EPD_DRIVER_IC_UC8159) {
+        lens[0] = plane * 4;                        // convertUC8159, 4bpp
+    } else if (model->color == BWR) {
+        lens[1] = plane;
+    }
+
+    chunk[0] = EPD_CMD_INIT;
+    chunk[1] = id;
+    SessionAppend(&buf, &size, chunk, 2);
+    for (uint8_t s = 0; s < 2; s++) {
+        for (uint32_t i = 0; i < lens[s]; i += data_len - 2) {
+            uint32_t n = lens[s] - i < (uint32_t)(data_len - 2) ? lens[s] - i : (uint32_t)(data_len - 2);
+            chunk[0] = EPD_CMD_WRITE_IMAGE;
+            chunk[1] = cfgs[s] | (i == 0 ? 0x00 : 0xF0);
+            for (uint32_t j = 0; j < n; j++) {
+                seed = seed * 1103515245 + 12345;
+                chunk[2 + j] = seed >> 16;
+            }
+            SessionAppend(&buf, &size, chunk, n + 2);
+        }
+    }
+    chunk[0] = EPD_CMD_REFRESH;
+    SessionAppend(&buf, &size, chunk, 1);
+
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        perror(path);
+        free(buf);
+        return 1;
+    }
+    fwrite(buf, 1, size, fp);
+    fclose(fp);
+    free(buf);
+    return 0;
+}
+
+static uint64_t NowUs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int Replay(const char *path, uint32_t count)
+{
+    size_t size;
+    uint8_t *data = LoadFile(path, &size);
+    if (data == NULL) return 1;
+
+    uint64_t start = NowUs();
+    for (uint32_t i = 0; i < count; i++)
+        Session(data, size);
+    double us = (double)(NowUs() - start) / count;
+
+    epd_panel_stats_t *panel = epd_panel_stats();
+    sdk_host_stats_t *sdk = sdk_host_stats();
+    printf("%s: %u write(s), %u byte(s), %u reconnect(s), %u minute(s), %u reboot(s)\n", path,
+           m_session.writes, m_session.bytes, m_session.reconnects, m_session.minutes, m_session.reboots);
+    printf("  %.1f us/session, %.2f us/write, %.1f MB/s (host, including the virtual controller)\n",
+           us, m_session.writes ? us / m_session.writes : 0.0, us > 0 ? m_session.bytes / us : 0.0);
+    printf("  panel: %u refresh(es), %u partial(s), %u data byte(s), %u error(s)\n",
+           panel->refreshes, panel->partials, panel->data_bytes, panel->errors + panel->ignored + panel->busy_timeouts);
+    printf("  sdk: %u notification(s), %u flash write(s) (%u words), %u gc, %u scheduler overflow(s)\n",
+           sdk->notifications, sdk->flash_writes, sdk->flash_words, sdk->gc_runs, sdk->sched_overflows);
+    free(data);
+    return 0;
+}
+
+// Random mutations of the given sessions, a quick check without libFuzzer
+// (build with SANITIZE=1 to catch memory errors)
+static int Mutate(char **paths, int num, uint32_t count, uint32_t seed)
+{
+    static const uint8_t commands[] = {
+        EPD_CMD_SET_PINS, EPD_CMD_INIT, EPD_CMD_CLEAR, EPD_CMD_SEND_COMMAND, EPD_CMD_SEND_DATA,
+        EPD_CMD_REFRESH, EPD_CMD_SLEEP, EPD_CMD_SET_TIME, EPD_CMD_SET_WEEK_START, EPD_CMD_WRITE_IMAGE,
+        EPD_CMD_CAPTURE_START, EPD_CMD_CAPTURE_STOP, EPD_CMD_CAPTURE_READ, EPD_CMD_SET_CONFIG,
+        EPD_CMD_SYS_RESET, EPD_CMD_SYS_SLEEP, EPD_CMD_CFG_ERASE,
+    };
+    uint8_t *inputs[16];
+    size_t sizes[16];
+    int n = 0;
+
+    for (int i = 0; i < num && n < 16; i++)
+        if ((inputs[n] = LoadFile(paths[i], &sizes[n])) != NULL) n++;
+    srand(seed);
+
+    for (uint32_t iter = 0; iter < count; iter++) {
+        size_t size = n > 0 ? sizes[iter % n] : 0;
+        size_t alloc = size + 64;
+        uint8_t *data = malloc(alloc);
+        if (n > 0) memcpy(data, inputs[iter % n], size);
+        for (int m = rand() % 8 + 1; m > 0; m--) {
+            size_t pos = size ? rand() % size : 0;
+            switch (rand() % 4) {
+                case 0: if (size) data[pos] ^= 1 << (rand() % 8); break;   // bit flip
+                case 1: if (size) data[pos] = rand(); break;                // byte
+                case 2: if (size) size = pos; break;                        // truncate
+                default: {                                                  // insert a command
+                    uint8_t len = rand() % 8 + 1;
+                    if (size + len + 1 <= alloc) {
+                        memmove(&data[pos + len + 1], &data[pos], size - pos);
+                        data[pos] = len;
+                        data[pos + 1] = commands[rand() % sizeof(commands)];
+                        for (uint8_t i = 1; i < len; i++) data[pos + 1 + i] = rand();
+                        size += len + 1;
+                    }
+                } break;
+            }
+        }
+        LLVMFuzzerTestOneInput(data, size);
+        free(data);
+    }
+    for (int i = 0; i < n; i++) free(inputs[i]);
+    printf("%u mutated session(s) done\n", count);
+    return 0;
+}
+
+static void Usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s [options] <session>...\n"
+        "  replay the sessions and report the parser throughput\n"
+        "  -n <count>    replay each session <count> times (default 100)\n"
+        "  -u <mtu>      ATT MTU of the connection (default %d)\n"
+        "  -g <file>     write an image upload session like the web UI instead\n"
+        "  -i <id>       panel model id of the generated session (default 1)\n"
+        "  -z <count>    run <count> random mutations of the sessions (fuzz smoke test)\n"
+        "  -s <seed>     random seed for -z (default 1)\n"
+        "  -V <volts>    supply voltage seen by the firmware (default 3.0)\n"
+        "  -v            print every write and notification\n",
+        prog, DEFAULT_ATT_MTU);
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t count = 100, mutations = 0, seed = 1;
+    uint16_t mtu = DEFAULT_ATT_MTU;
+    const char *generate = NULL;
+    int id = EPD_UC8176_420_BW;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:u:g:i:z:s:V:vh")) != -1) {
+        switch (opt) {
+            case 'n': count = strtoul(optarg, NULL, 0); break;
+            case 'u': mtu = atoi(optarg); break;
+            case 'g': generate = optarg; break;
+            case 'i': id = atoi(optarg); break;
+            case 'z': mutations = strtoul(optarg, NULL, 0); break;
+            case 's': seed = strtoul(optarg, NULL, 0); break;
+            case 'V': epd_host_set_voltage(atof(optarg)); break;
+            case 'v': m_verbose = true; break;
+            default:
+                Usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (mtu < 23 || mtu > DEFAULT_ATT_MTU) {
+        fprintf(stderr, "ATT MTU out of range: %d\n", mtu);
+        return 1;
+    }
+    m_data_len = mtu - 3;
+    sdk_host_on_notify(OnNotify);
+
+    if (generate) return Generate(generate, id, m_data_len);
+    if (mutations > 0) return Mutate(&argv[optind], argc - optind, mutations, seed);
+    if (optind >= argc || count == 0) {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    int ret = 0;
+    for (int i = optind; i < argc; i++)
+        ret |= Replay(argv[i], count);
+    return ret;
+}
+#endif
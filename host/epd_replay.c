@@ -0,0 +1,321 @@
+// SPI capture decoder and replay tool
+// Reads a capture stream (EPD/EPD_capture.h) saved from the device over BLE
+// (EPD_CMD_CAPTURE_READ) or by epd_sim -c, lists its records, or replays them
+// into the virtual controller (EPD_panel.c) of a panel model.
+//
+// Records keep at most EPD_CAPTURE_DATA_MAX data bytes, longer transfers are
+// rebuilt by repeating the stored bytes. That is exact for RAM fills and
+// register writes, the checksum tells which transfers could not be rebuilt.
+#define _POSIX_C_SOURCE 200809L
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "EPD_driver.h"
+#include "EPD_panel.h"
+#include "EPD_capture.h"
+
+typedef struct {
+    uint8_t type;
+    uint16_t dt;         // ms since the previous record
+    uint8_t cmd;         // CMD
+    uint16_t wait_ms;    // BUSY
+    uint16_t len;        // DATA/READ: transfer length (saturated at 0xFFFF)
+    uint16_t xfers;
+    uint16_t sum;
+    uint8_t count;       // stored bytes
+    uint8_t *data;
+} capture_record_t;
+
+typedef struct {
+    uint8_t *buf;
+    uint32_t size;
+    uint32_t pos;
+    uint16_t dropped;
+    uint8_t flags;
+} capture_t;
+
+static uint16_t Get16(uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint16_t Checksum(uint16_t sum, uint8_t *data, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++)
+        sum = ((sum << 1) | (sum >> 15)) ^ data[i];
+    return sum;
+}
+
+static int Load(const char *path, capture_t *cap)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    memset(cap, 0, sizeof(*cap));
+    uint32_t alloc = 0;
+    size_t n;
+    do {
+        if (cap->size == alloc) {
+            alloc = alloc ? alloc * 2 : 4096;
+            cap->buf = realloc(cap->buf, alloc);
+            if (cap->buf == NULL) {
+                fclose(fp);
+                return -1;
+            }
+        }
+        n = fread(cap->buf + cap->size, 1, alloc - cap->size, fp);
+        cap->size += n;
+    } while (n > 0);
+    fclose(fp);
+
+    uint8_t *h = cap->buf;
+    if (cap->size < EPD_CAPTURE_HEADER_SIZE || h[0] != EPD_CAPTURE_MAGIC0 || h[1] != EPD_CAPTURE_MAGIC1) {
+        fprintf(stderr, "%s: not a capture file\n", path);
+        return -1;
+    }
+    if (h[2] != EPD_CAPTURE_VERSION) {
+        fprintf(stderr, "%s: unsupported capture version %d\n", path, h[2]);
+        return -1;
+    }
+    uint32_t size = EPD_CAPTURE_HEADER_SIZE + Get16(&h[4]);
+    if (size < cap->size) cap->size = size;
+    else if (size > cap->size) fprintf(stderr, "%s: truncated, %u of %u bytes\n", path, cap->size, size);
+    cap->flags = h[3];
+    cap->dropped = Get16(&h[6]);
+    cap->pos = EPD_CAPTURE_HEADER_SIZE;
+    return 0;
+}
+
+// Next record, false at the end of the stream or on a broken record
+static bool Next(capture_t *cap, capture_record_t *rec)
+{
+    uint8_t *p = cap->buf + cap->pos;
+    uint32_t left = cap->size - cap->pos;
+    uint32_t size;
+
+    if (left < 3) return false;
+    memset(rec, 0, sizeof(*rec));
+    rec->type = p[0];
+    rec->dt = Get16(&p[1]);
+    switch (rec->type) {
+        case EPD_CAPTURE_CMD:
+            size = 4;
+            if (left >= size) rec->cmd = p[3];
+            break;
+        case EPD_CAPTURE_RESET:
+            size = 3;
+            break;
+        case EPD_CAPTURE_BUSY:
+            size = 5;
+            if (left >= size) rec->wait_ms = Get16(&p[3]);
+            break;
+        case EPD_CAPTURE_DATA:
+        case EPD_CAPTURE_READ:
+            if (left < 10) return false;
+            rec->len = Get16(&p[3]);
+            rec->xfers = Get16(&p[5]);
+            rec->sum = Get16(&p[7]);
+            rec->count = p[9];
+            rec->data = &p[10];
+            size = 10 + rec->count;
+            break;
+        default:
+            fprintf(stderr, "unknown record type 0x%02x at offset %u\n", rec->type, cap->pos);
+            return false;
+    }
+    if (left < size) return false;
+    cap->pos += size;
+    return true;
+}
+
+// Print one record per line, without timing when quiet so that two captures
+// can be compared with diff(1)
+static int List(capture_t *cap, bool quiet)
+{
+    capture_record_t rec;
+    uint32_t ms = 0, records = 0;
+
+    if (!quiet)
+        printf("# %u bytes, %u record(s) dropped%s\n", cap->size - EPD_CAPTURE_HEADER_SIZE,
+               cap->dropped, (cap->flags & 0x01) ? ", still capturing" : "");
+    while (Next(cap, &rec)) {
+        ms += rec.dt;
+        records++;
+        if (!quiet) printf("%8u.%03u ", ms / 1000, ms % 1000);
+        switch (rec.type) {
+            case EPD_CAPTURE_CMD:   printf("CMD   %02x\n", rec.cmd); break;
+            case EPD_CAPTURE_RESET: printf("RESET\n"); break;
+            case EPD_CAPTURE_BUSY:
+                if (quiet) printf("BUSY\n");
+                else printf("BUSY  %u ms\n", rec.wait_ms);
+                break;
+            default:
+                printf("%s  len=%u xfers=%u sum=%04x ", rec.type == EPD_CAPTURE_DATA ? "DATA" : "READ",
+                       rec.len, rec.xfers, rec.sum);
+                for (uint8_t i = 0; i < rec.count; i++) printf("%02x", rec.data[i]);
+                printf("%s\n", rec.count < rec.len ? "..." : "");
+                break;
+        }
+    }
+    if (cap->pos < cap->size) {
+        fprintf(stderr, "broken record at offset %u\n", cap->pos);
+        return 1;
+    }
+    if (!quiet) printf("# %u record(s), %u.%03u s\n", records, ms / 1000, ms % 1000);
+    return 0;
+}
+
+static int WriteScreen(const char *path)
+{
+    static const uint8_t rgb[4][3] = { {255, 255, 255}, {0, 0, 0}, {255, 0, 0}, {255, 255, 0} };
+    uint16_t width = epd_panel_width(), height = epd_panel_height();
+    uint8_t *screen = epd_panel_screen();
+
+    FILE *fp = strcmp(path, "-") == 0 ? stdout : fopen(path, "wb");
+    if (fp == NULL) {
+        perror(path);
+        return -1;
+    }
+    fprintf(fp, "P6\n%d %d\n255\n", width, height);
+    for (uint32_t i = 0; i < (uint32_t)width * height; i++)
+        fwrite(rgb[screen[i]], 1, 3, fp);
+    if (fp != stdout) fclose(fp);
+    return 0;
+}
+
+// Send a DATA record to the controller, rebuilding the bytes that were not stored
+static bool ReplayData(capture_record_t *rec)
+{
+    uint8_t chunk[255];
+    uint32_t sent = 0;
+    uint16_t sum = 0;
+
+    if (rec->count == 0) return rec->len == 0;
+    while (sent < rec->len) {
+        uint8_t n = rec->len - sent > sizeof(chunk) ? sizeof(chunk) : rec->len - sent;
+        for (uint8_t i = 0; i < n; i++)
+            chunk[i] = rec->data[(sent + i) % rec->count];
+        sum = Checksum(sum, chunk, n);
+        EPD_WriteData(chunk, n);
+        sent += n;
+    }
+    return sum == rec->sum;
+}
+
+// Reset pulse of the init sequences
+static const uint8_t m_reset[] = { EPD_SEQ_RESET(10), EPD_SEQ_END };
+
+static int Replay(capture_t *cap, epd_model_t *model, int8_t temperature, const char *output)
+{
+    uint32_t busy = model->drv->ic == EPD_DRIVER_IC_SSD1619 || model->drv->ic == EPD_DRIVER_IC_SSD1677 ? HIGH : LOW;
+    uint32_t records = 0, rebuilt = 0, approx = 0, reads = 0;
+    capture_record_t rec;
+
+    epd_panel_init(model, temperature);
+    while (Next(cap, &rec)) {
+        records++;
+        switch (rec.type) {
+            case EPD_CAPTURE_CMD:
+                EPD_WriteCmd(rec.cmd);
+                break;
+            case EPD_CAPTURE_RESET:
+                epd_sequence_run(NULL, m_reset);
+                break;
+            case EPD_CAPTURE_BUSY:
+                // the modeled timing is not exact, only flag waits the firmware would not survive
+                EPD_WaitBusy(busy, UINT16_MAX);
+                break;
+            case EPD_CAPTURE_DATA:
+                if (rec.count < rec.len) {
+                    if (ReplayData(&rec)) rebuilt++;
+                    else approx++;
+                } else {
+                    EPD_WriteData(rec.data, rec.len);
+                }
+                break;
+            case EPD_CAPTURE_READ: {
+                uint8_t value[255];
+                for (uint32_t left = rec.len; left > 0;) {
+                    uint8_t n = left > sizeof(value) ? sizeof(value) : left;
+                    EPD_ReadData(value, n);
+                    left -= n;
+                }
+                reads++;
+                break;
+            }
+        }
+    }
+
+    int ret = cap->pos < cap->size ? 1 : 0;
+    if (ret) fprintf(stderr, "broken record at offset %u, replay stopped\n", cap->pos);
+    if (output && WriteScreen(output) != 0) ret = 1;
+
+    epd_panel_stats_t stats = *epd_panel_stats();
+    epd_panel_uninit();
+
+    printf("%u record(s)%s, %u truncated transfer(s) rebuilt, %u approximated, %u read(s)\n", records,
+           cap->dropped ? " (oldest dropped)" : "", rebuilt, approx, reads);
+    printf("%u command(s), %u data byte(s), %u refresh(es), %u partial refresh(es), %u reset(s)\n",
+           stats.commands, stats.data_bytes, stats.refreshes, stats.partials, stats.resets);
+    printf("modeled time %.1f ms, busy %.1f ms, %u busy timeout(s), %u error(s)\n",
+           stats.time_us / 1000.0, stats.busy_us / 1000.0, stats.busy_timeouts, stats.errors + stats.ignored);
+    return ret || stats.errors + stats.ignored + stats.busy_timeouts > 0 ? 1 : 0;
+}
+
+static void Usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s [options] <capture>\n"
+        "  -i <id>       replay into the controller of panel model <id>, list the records if not set\n"
+        "  -T <temp>     panel temperature for the replay (default 25)\n"
+        "  -o <file>     save the displayed image after the replay as PPM\n"
+        "  -q            list without timing, for comparing two captures with diff\n",
+        prog);
+}
+
+int main(int argc, char *argv[])
+{
+    int id = 0;
+    int8_t temperature = 25;
+    const char *output = NULL;
+    bool quiet = false;
+    capture_t cap;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "i:T:o:qh")) != -1) {
+        switch (opt) {
+            case 'i': id = atoi(optarg); break;
+            case 'T': temperature = atoi(optarg); break;
+            case 'o': output = optarg; break;
+            case 'q': quiet = true; break;
+            default:
+                Usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind >= argc) {
+        Usage(argv[0]);
+        return 1;
+    }
+    if (Load(argv[optind], &cap) != 0) return 1;
+
+    int ret;
+    if (id == 0) {
+        ret = List(&cap, quiet);
+    } else {
+        epd_model_t *model = epd_host_model((epd_model_id_t)id);
+        if (model == NULL) {
+            fprintf(stderr, "unknown model id: %d\n", id);
+            free(cap.buf);
+            return 1;
+        }
+        ret = Replay(&cap, model, temperature, output);
+    }
+    free(cap.buf);
+    return ret;
+}
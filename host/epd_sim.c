@@ -0,0 +1,506 @@
+// EPD driver simulator for Linux (and other POSIX systems)
+// Runs the real panel drivers (EPD/UC81xx.c, EPD/SSD16xx.c) against the
+// virtual controller in EPD_panel.c, following the same steps as the firmware
+// (epd_gui_update / on_disconnect), and reports the bus traffic and modeled
+// time of every step. The displayed image is checked against the GUI output.
+#define _POSIX_C_SOURCE 200809L
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include "EPD_driver.h"
+#include "EPD_panel.h"
+#include "EPD_capture.h"
+#include "EPD_energy.h"
+#include "EPD_temp.h"
+#include "GUI.h"
+#include "Lunar.h"
+
+typedef struct {
+    const char *name;
+    epd_panel_stats_t stats;
+} sim_phase_t;
+
+typedef struct {
+    uint8_t *pixels;
+    uint16_t width;
+    uint16_t height;
+    uint8_t color;
+} sim_frame_t;
+
+static uint8_t m_en_pin = 0xFF; // -E: panel power switched between updates
+static epd_model_t *m_ready = NULL;
+static bool m_overlay = false;  // the overlay is on the picture
+
+// on_disconnect(): deep sleep entry before the pins are released
+static const uint8_t m_sleep_settle[] = { EPD_SEQ_DELAY(200), EPD_SEQ_END };
+
+static const char *ModelName(epd_model_id_t id)
+{
+    static const char *names[] = {
+        NULL, "UC8176_420_BW", "SSD1619_420_BWR", "UC8176_420_BWR", "SSD1619_420_BW",
+        "JD79668_420_BWRY", "UC8179_750_BW", "UC8179_750_BWR", "UC8159_750_BW",
+        "UC8159_750_BWR", "SSD1677_750_BW", "SSD1677_750_BWR", "JD79668_750_BWRY",
+    };
+    return id < sizeof(names) / sizeof(names[0]) && names[id] ? names[id] : "UNKNOWN";
+}
+
+// Reference image straight from the GUI buffers, same decoding as emulator_headless.c
+static void DrawReference(void *user_data, uint8_t *black, uint8_t *color, uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    sim_frame_t *frame = (sim_frame_t *)user_data;
+    uint16_t wb = (w + 7) / 8;
+
+    for (uint16_t row = 0; row < h && y + row < frame->height; row++) {
+        for (uint16_t col = 0; col < w && x + col < frame->width; col++) {
+            uint8_t pixel;
+            if (frame->color == BWRY) {
+                static const uint8_t map[4] = { PANEL_BLACK, PANEL_WHITE, PANEL_YELLOW, PANEL_RED };
+                pixel = map[(black[row * (w / 4) + col / 4] >> (6 - 2 * (col % 4))) & 0x03];
+            } else {
+                uint32_t pos = row * wb + col / 8;
+                uint8_t bit = 0x80 >> (col % 8);
+                if (color && !(color[pos] & bit))
+                    pixel = PANEL_RED;
+                else
+                    pixel = (black[pos] & bit) ? PANEL_WHITE : PANEL_BLACK;
+            }
+            frame->pixels[(y + row) * frame->width + x + col] = pixel;
+        }
+    }
+}
+
+// Back from the reference image to the GUI buffers (BW and BWR), for the overlay
+static void ReadReference(void *user_data, uint8_t *black, uint8_t *color, uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    sim_frame_t *frame = (sim_frame_t *)user_data;
+    uint16_t wb = (w + 7) / 8;
+
+    memset(black, 0xFF, (uint32_t)wb * h);
+    if (color) memset(color, 0xFF, (uint32_t)wb * h);
+    for (uint16_t row = 0; row < h && y + row < frame->height; row++) {
+        for (uint16_t col = 0; col < w && x + col < frame->width; col++) {
+            uint8_t pixel = frame->pixels[(y + row) * frame->width + x + col];
+            uint32_t pos = row * wb + col / 8;
+            uint8_t bit = 0x80 >> (col % 8);
+            if (pixel == PANEL_BLACK) black[pos] &= ~bit;
+            if (pixel == PANEL_RED && color) color[pos] &= ~bit;
+        }
+    }
+}
+
+// Number of pixels where the glass differs from what the GUI drew, in picture mode the
+// uploaded picture (MODE_CALENDAR) with the overlay of data if it was drawn
+static uint32_t CheckScreen(gui_data_t *data, gui_data_t *picture)
+{
+    sim_frame_t frame = { NULL, data->width, data->height, data->color };
+    uint32_t size = (uint32_t)data->width * data->height;
+    uint32_t diff = 0;
+
+    frame.pixels = malloc(size);
+    if (frame.pixels == NULL) return size;
+    memset(frame.pixels, PANEL_WHITE, size);
+    if (data->mode == MODE_PICTURE) {
+        gui_rect_t rect;
+        DrawGUI(picture, DrawReference, &frame);
+        GetGUIOverlayRect(data, &rect);
+        if (m_overlay) DrawGUIOverlay(data, &rect, ReadReference, DrawReference, &frame);
+    } else {
+        DrawGUI(data, DrawReference, &frame);
+    }
+
+    uint8_t *screen = epd_panel_screen();
+    for (uint32_t i = 0; i < size; i++)
+        if (screen[i] != frame.pixels[i]) diff++;
+
+    free(frame.pixels);
+    return diff;
+}
+
+static int WriteScreen(const char *path)
+{
+    static const uint8_t rgb[4][3] = { {255, 255, 255}, {0, 0, 0}, {255, 0, 0}, {255, 255, 0} };
+    uint16_t width = epd_panel_width(), height = epd_panel_height();
+    uint8_t *screen = epd_panel_screen();
+
+    FILE *fp = strcmp(path, "-") == 0 ? stdout : fopen(path, "wb");
+    if (fp == NULL) {
+        perror(path);
+        return -1;
+    }
+    fprintf(fp, "P6\n%d %d\n255\n", width, height);
+    for (uint32_t i = 0; i < (uint32_t)width * height; i++)
+        fwrite(rgb[screen[i]], 1, 3, fp);
+    if (fp != stdout) fclose(fp);
+    return 0;
+}
+
+// Save the SPI capture stream in the format read over BLE (EPD_CMD_CAPTURE_READ)
+static int WriteCapture(const char *path)
+{
+    uint8_t buf[256];
+    uint16_t offset = 0, len;
+
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        perror(path);
+        return -1;
+    }
+    while ((len = EPD_Capture_Read(offset, buf, sizeof(buf))) > 0) {
+        fwrite(buf, 1, len, fp);
+        offset += len;
+    }
+    fclose(fp);
+    return 0;
+}
+
+static void PhaseBegin(sim_phase_t *phase, const char *name)
+{
+    phase->name = name;
+    phase->stats = *epd_panel_stats();
+}
+
+static void PhaseEnd(sim_phase_t *phase, uint32_t count)
+{
+    epd_panel_stats_t *now = epd_panel_stats();
+    epd_panel_stats_t *s = &phase->stats;
+
+    s->commands = now->commands - s->commands;
+    s->data_bytes = now->data_bytes - s->data_bytes;
+    s->read_bytes = now->read_bytes - s->read_bytes;
+    s->transfers = now->transfers - s->transfers;
+    s->resets = now->resets - s->resets;
+    s->refreshes = now->refreshes - s->refreshes;
+    s->partials = now->partials - s->partials;
+    s->busy_waits = now->busy_waits - s->busy_waits;
+    s->busy_timeouts = now->busy_timeouts - s->busy_timeouts;
+    s->ignored = now->ignored - s->ignored;
+    s->errors = now->errors - s->errors;
+    s->spi_us = now->spi_us - s->spi_us;
+    s->busy_us = now->busy_us - s->busy_us;
+    s->delay_us = now->delay_us - s->delay_us;
+    s->wait_us = now->wait_us - s->wait_us;
+    s->time_us = now->time_us - s->time_us;
+
+    if (count > 1) { // average per run
+        s->commands /= count;
+        s->data_bytes /= count;
+        s->transfers /= count;
+        s->spi_us /= count;
+        s->busy_us /= count;
+        s->delay_us /= count;
+        s->wait_us /= count;
+        s->time_us /= count;
+    }
+}
+
+static void PhasePrint(sim_phase_t *phase)
+{
+    epd_panel_stats_t *s = &phase->stats;
+    printf("%-10s %6u %8u %8u %9.1f %9.1f %9.1f %9.1f %10.1f %4u %4u\n",
+           phase->name, s->commands, s->data_bytes, s->transfers,
+           s->spi_us / 1000.0, s->busy_us / 1000.0, s->delay_us / 1000.0, s->wait_us / 1000.0, s->time_us / 1000.0,
+           s->busy_timeouts, s->errors + s->ignored);
+}
+
+// The host timer expires at once, epd_resume() returns after this
+static void Ready(epd_model_t *epd)
+{
+    m_ready = epd;
+}
+
+// One screen update, as epd_gui_update() and epd_gui_draw() in EPD_service.c, returns its charge (uC)
+static uint32_t Update(gui_data_t *data, gui_data_t *last, epd_model_id_t id, sim_phase_t *refresh)
+{
+    gui_rect_t rect;
+    bool full = true;
+
+    if (data->mode == MODE_PICTURE && data->overlay != 0 && EPD_State() == EPD_STATE_OFF)
+        return 0; // the picture is lost with the controller RAM
+    epd_energy_update_begin();
+    EPD_GPIO_Init();
+    epd_resume(id, Ready);
+    epd_model_t *epd = m_ready;
+    data->color = epd->color;
+    data->width = epd->width;
+    data->height = epd->height;
+    data->temperature = epd_temp_update_begin(epd, (uint32_t)data->timestamp);
+
+    buffer_callback write = (buffer_callback)(epd->drv->write_partial ? epd->drv->write_partial : epd->drv->write_image);
+    if (data->mode == MODE_PICTURE && data->overlay != 0) {
+        full = false;
+        GetGUIOverlayRect(data, &rect);
+        if (epd->drv->read_image != NULL && rect.w > 0 && rect.h > 0) {
+            DrawGUIOverlay(data, &rect, (buffer_callback)epd->drv->read_image, write, epd);
+            if (refresh) PhaseBegin(refresh, refresh->name);
+            if (epd->drv->partial_refresh == NULL || !epd->drv->partial_refresh(epd, rect.x, rect.y, rect.w, rect.h))
+                epd->drv->refresh(epd);
+            m_overlay = true;
+        }
+    } else if (epd->drv->partial_refresh != NULL && GetGUIDirtyRect(last, data, &rect)) {
+        full = false;
+        if (rect.w > 0 && rect.h > 0) {
+            DrawGUIPartial(data, &rect, write, epd);
+            if (refresh) PhaseBegin(refresh, refresh->name);
+            full = !epd->drv->partial_refresh(epd, rect.x, rect.y, rect.w, rect.h);
+        }
+    }
+    if (full) {
+        DrawGUI(data, (buffer_callback)epd->drv->write_image, epd);
+        if (refresh) PhaseBegin(refresh, refresh->name);
+        epd->drv->refresh(epd);
+    }
+    if (refresh) PhaseEnd(refresh, 1);
+    epd_temp_update_end(epd, (uint32_t)data->timestamp);
+    *last = *data;
+    EPD_GPIO_Uninit();
+    return epd_energy_update_end((uint32_t)data->timestamp);
+}
+
+// Charge of a day (mAh) with the display updates of the mode, advertising at APP_ADV_INTERVAL
+// and sleeping otherwise, and the days a battery of capacity (mAh) lasts
+static void PrintEnergy(energy_chip_t chip, uint32_t update, uint32_t minute, uint32_t capacity)
+{
+    static const struct {
+        const char *mode;
+        uint32_t updates;
+    } modes[] = { { "calendar", 1 }, { "clock", 1440 } };
+    energy_report_t idle;
+
+    epd_energy_init(chip, 0);
+    epd_energy_radio(ENERGY_ADVERTISING, 1000, 0);
+    epd_energy_report(0, 86400 - 1, &idle);
+    double base = (idle.charge[ENERGY_SLEEP] + idle.charge[ENERGY_ADVERTISING]) / 3.6e6;
+
+    printf("\nenergy (%s): update %u uC, minute %u uC, advertising and sleep %.3f mAh/day\n",
+           epd_energy_chip_name(), update, minute, base);
+    for (uint8_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        double day = base + (update + (double)minute * (modes[i].updates - 1)) / 3.6e6;
+        printf("%-10s %5u update(s)/day %8.3f mAh/day %8.0f day(s) on %u mAh\n",
+               modes[i].mode, modes[i].updates, day, capacity / day, capacity);
+    }
+}
+
+// Picture mode: a calendar image uploaded over BLE (EPD_CMD_WRITE_IMAGE, EPD_CMD_REFRESH) and
+// the disconnect, the minute updates draw the overlay over it
+static uint32_t Upload(gui_data_t *picture, epd_model_id_t id, sim_phase_t *refresh)
+{
+    epd_energy_update_begin();
+    EPD_GPIO_Init();
+    epd_resume(id, Ready);
+    epd_model_t *epd = m_ready;
+    picture->color = epd->color;
+    picture->width = epd->width;
+    picture->height = epd->height;
+    DrawGUI(picture, (buffer_callback)epd->drv->write_image, epd);
+    PhaseBegin(refresh, refresh->name);
+    epd->drv->refresh(epd);
+    PhaseEnd(refresh, 1);
+    if (epd->drv->read_image == NULL) { // on_disconnect(): kept in standby for the overlay otherwise
+        epd->drv->sleep(epd);
+        epd_sequence_start(NULL, m_sleep_settle, NULL);
+    }
+    EPD_GPIO_Uninit();
+    return epd_energy_update_end((uint32_t)picture->timestamp);
+}
+
+// Simulate connect + one full update + <minutes> clock updates + disconnect
+static int Simulate(epd_model_id_t id, gui_data_t *base, uint32_t minutes, int8_t temperature,
+                    bool summary, const char *output, const char *capture, energy_chip_t chip, uint32_t capacity)
+{
+    epd_model_t *model = epd_host_model(id);
+    gui_data_t data = *base, last = { .mode = MODE_PICTURE }, picture = *base;
+    sim_phase_t update = { "update" }, refresh = { "refresh" }, minute = { "minute" }, sleep = { "sleep" };
+    uint32_t diff, update_charge, minute_charge = 0;
+    epd_config_t config;
+
+    if (model == NULL) return -1;
+    memset(&config, 0xFF, sizeof(config)); // temp_ttl: TEMP_TTL_DEFAULT
+    config.en_pin = m_en_pin;
+    EPD_GPIO_Load(&config);
+    epd_temp_init(&config);
+    epd_panel_init(model, temperature);
+    epd_energy_init(chip, (uint32_t)data.timestamp);
+    if (capture) EPD_Capture_Start();
+
+    m_overlay = false;
+    PhaseBegin(&update, update.name);
+    if (data.mode == MODE_PICTURE) {
+        picture.mode = MODE_CALENDAR;
+        update_charge = Upload(&picture, id, &refresh);
+        data.color = picture.color;
+        data.width = picture.width;
+        data.height = picture.height;
+        last = data;
+    } else {
+        update_charge = Update(&data, &last, id, &refresh);
+    }
+    PhaseEnd(&update, 1);
+    diff = CheckScreen(&data, &picture);
+
+    PhaseBegin(&minute, minute.name);
+    for (uint32_t n = 0; n < minutes; n++) {
+        data.timestamp += 60;
+        minute_charge += Update(&data, &last, id, NULL);
+    }
+    PhaseEnd(&minute, minutes);
+    minute_charge = minutes > 0 ? minute_charge / minutes : update_charge;
+    if (minutes > 0) diff += CheckScreen(&data, &picture);
+
+    // on_disconnect()
+    PhaseBegin(&sleep, sleep.name);
+    model->drv->sleep(model);
+    epd_sequence_start(NULL, m_sleep_settle, NULL);
+    PhaseEnd(&sleep, 1);
+
+    int ret = 0;
+    if (output) ret = WriteScreen(output);
+    if (capture) {
+        EPD_Capture_Stop();
+        ret |= WriteCapture(capture);
+    }
+    epd_panel_stats_t total = *epd_panel_stats();
+    epd_panel_uninit();
+
+    if (summary) {
+        printf("%-18s %6u %8u %8u %10.1f %8u %8u %10.1f %4u %s\n", ModelName(id),
+               update.stats.commands, update.stats.data_bytes, update.stats.transfers, update.stats.time_us / 1000.0,
+               minute.stats.data_bytes, minute.stats.transfers, minute.stats.time_us / 1000.0,
+               total.errors + total.ignored + total.busy_timeouts, diff ? "MISMATCH" : "ok");
+    } else {
+        printf("%s, %u refresh(es), %u partial refresh(es), %u reset(s), display %s (%u pixels differ)\n\n",
+               ModelName(id), total.refreshes, total.partials, total.resets, diff ? "MISMATCH" : "ok", diff);
+        printf("%-10s %6s %8s %8s %9s %9s %9s %9s %10s %4s %4s\n",
+               "step", "cmds", "bytes", "xfers", "spi(ms)", "busy(ms)", "delay(ms)", "wait(ms)", "total(ms)", "tmo", "err");
+        PhasePrint(&update);
+        PhasePrint(&refresh);
+        if (minutes > 0) PhasePrint(&minute);
+        PhasePrint(&sleep);
+        PrintEnergy(chip, update_charge, minute_charge, capacity);
+    }
+
+    return ret == 0 && diff == 0 ? 0 : 1;
+}
+
+// Boot detection (epd_probe_panel in EPD_service.c) on every model, id is the configured one
+static int Probe(epd_model_id_t id)
+{
+    epd_config_t config;
+    int failed = 0;
+
+    memset(&config, 0xFF, sizeof(config));
+    config.en_pin = m_en_pin;
+    EPD_GPIO_Load(&config);
+    printf("%-18s %-18s %4s %9s %s\n", "panel", "detected", "fam", "time(ms)", "id");
+    for (int i = EPD_UC8176_420_BW; i <= EPD_JD79668_750_BWRY; i++) {
+        epd_model_t *panel = epd_host_model((epd_model_id_t)i);
+        epd_probe_t result;
+
+        epd_panel_init(panel, 25);
+        EPD_GPIO_Init();
+        bool found = epd_probe(id, &result);
+        EPD_GPIO_Uninit();
+        epd_model_t *model = found ? epd_host_model(result.model) : NULL;
+        // the family is all that can be told apart, the configured model wins within it
+        bool ok = model != NULL && model->drv->probe == panel->drv->probe;
+        printf("%-18s %-18s 0x%02x %9.1f", ModelName((epd_model_id_t)i), found ? ModelName(result.model) : "-",
+               result.family, epd_panel_stats()->time_us / 1000.0);
+        for (uint8_t n = 0; n < result.len; n++)
+            printf(" %02x", result.id[n]);
+        printf("%s\n", ok ? "" : "  MISMATCH");
+        failed |= !ok;
+        epd_panel_uninit();
+    }
+    return failed;
+}
+
+static void Usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -i <id>       panel model id (default 1), 0 for a summary of all models\n"
+        "  -m <mode>     display mode: calendar (default), clock or picture (a calendar uploaded\n"
+        "                over BLE, the updates draw the clock and battery overlay over it)\n"
+        "  -t <time>     unix timestamp (local time, default: now, UTC+8)\n"
+        "  -n <minutes>  also simulate <minutes> clock updates after the first one (averaged)\n"
+        "  -T <temp>     panel temperature (default 25)\n"
+        "  -o <file>     save the displayed image as PPM\n"
+        "  -c <file>     save the SPI capture of the session (see epd_replay)\n"
+        "  -e <chip>     energy model: 51 (nRF51822, default) or 52 (nRF52811)\n"
+        "  -C <mAh>      battery capacity for the battery life estimate (default 220)\n"
+        "  -P            detect every model as the panel (boot probe), -i is the configured model\n"
+        "  -E            the panel power is switched (EN pin): no resume from standby between updates\n"
+        "  -v            trace every command sent to the controller\n",
+        prog);
+}
+
+int main(int argc, char *argv[])
+{
+    int id = 1;
+    uint32_t minutes = 0;
+    int8_t temperature = 25;
+    const char *output = NULL;
+    const char *capture = NULL;
+    bool trace = false;
+    bool probe = false;
+    energy_chip_t chip = ENERGY_CHIP_NRF51822;
+    uint32_t capacity = 220; // CR2032
+    int opt;
+
+    gui_data_t data = {
+        .mode            = MODE_CALENDAR,
+        .timestamp       = time(NULL) + 8 * 3600,
+        .week_start      = 0,
+        .voltage         = 3.0f,
+        .battery         = 100,
+        .ssid            = "NRF_EPD_84AC",
+    };
+
+    while ((opt = getopt(argc, argv, "i:m:t:n:T:o:c:e:C:EPvh")) != -1) {
+        switch (opt) {
+            case 'i': id = atoi(optarg); break;
+            case 'm':
+                if (strcmp(optarg, "picture") == 0 || strcmp(optarg, "0") == 0) {
+                    data.mode = MODE_PICTURE;
+                    data.overlay = GUI_OVERLAY_CLOCK | GUI_OVERLAY_BATTERY;
+                } else {
+                    data.mode = strcmp(optarg, "clock") == 0 || strcmp(optarg, "2") == 0 ? MODE_CLOCK : MODE_CALENDAR;
+                }
+                break;
+            case 't': data.timestamp = strtoul(optarg, NULL, 0); break;
+            case 'n': minutes = strtoul(optarg, NULL, 0); break;
+            case 'T': temperature = atoi(optarg); break;
+            case 'o': output = optarg; break;
+            case 'c': capture = optarg; break;
+            case 'e': chip = atoi(optarg) == 52 ? ENERGY_CHIP_NRF52811 : ENERGY_CHIP_NRF51822; break;
+            case 'C': capacity = strtoul(optarg, NULL, 0); break;
+            case 'E': m_en_pin = 0; break;
+            case 'P': probe = true; break;
+            case 'v': trace = true; break;
+            default:
+                Usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    epd_panel_trace(trace);
+    if (probe) return Probe((epd_model_id_t)id);
+
+    if (id == 0) {
+        int failed = 0;
+        printf("%-18s %6s %8s %8s %10s %8s %8s %10s %4s %s\n", "model", "cmds", "bytes", "xfers", "time(ms)",
+               "min.bytes", "min.xfer", "min.ms", "err", "display");
+        for (int i = EPD_UC8176_420_BW; i <= EPD_JD79668_750_BWRY; i++)
+            failed |= Simulate((epd_model_id_t)i, &data, minutes, temperature, true, NULL, NULL,
+                               chip, capacity);
+        return failed;
+    }
+
+    if (epd_host_model((epd_model_id_t)id) == NULL) {
+        fprintf(stderr, "unknown model id: %d\n", id);
+        return 1;
+    }
+    return Simulate((epd_model_id_t)id, &data, minutes, temperature, false, output, capture, chip, capacity);
+}
@@ -0,0 +1,95 @@
+// Host replacement of the nRF5 SDK 17 FDS header. Records live in RAM for the
+// lifetime of the process, so they survive the simulated resets (see sdk_host.c).
+#ifndef FDS_H__
+#define FDS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sdk_errors.h"
+
+#define FDS_ERR_NOT_FOUND          0x8609
+#define FDS_ERR_NO_SPACE_IN_FLASH  0x8606
+#define FDS_ERR_USER_LIMIT_REACHED 0x860B
+
+typedef struct {
+    uint16_t record_key;
+    uint16_t length_words;
+    uint16_t file_id;
+    uint16_t crc16;
+    uint32_t record_id;
+} fds_header_t;
+
+typedef struct {
+    uint32_t record_id;
+    uint32_t const *p_record;
+    uint16_t gc_run_count;
+    bool record_is_open;
+} fds_record_desc_t;
+
+typedef struct {
+    fds_header_t const *p_header;
+    void const *p_data;
+} fds_flash_record_t;
+
+typedef struct {
+    uint16_t file_id;
+    uint16_t key;
+    struct {
+        void const *p_data;
+        uint32_t length_words;
+    } data;
+} fds_record_t;
+
+typedef struct {
+    uint32_t const *p_addr;
+    uint16_t page;
+} fds_find_token_t;
+
+typedef enum {
+    FDS_EVT_INIT,
+    FDS_EVT_WRITE,
+    FDS_EVT_UPDATE,
+    FDS_EVT_DEL_RECORD,
+    FDS_EVT_DEL_FILE,
+    FDS_EVT_GC
+} fds_evt_id_t;
+
+typedef struct {
+    fds_evt_id_t id;
+    ret_code_t result;
+    union {
+        struct {
+            uint32_t record_id;
+            uint16_t file_id;
+            uint16_t record_key;
+        } write; // FDS_EVT_WRITE, FDS_EVT_UPDATE
+        struct {
+            uint32_t record_id;
+            uint16_t file_id;
+            uint16_t record_key;
+        } del;   // FDS_EVT_DEL_RECORD
+    };
+} fds_evt_t;
+
+typedef struct {
+    uint16_t valid_records;
+    uint16_t dirty_records;
+    uint16_t words_used;
+    uint16_t largest_contig;
+    uint16_t freeable_words;
+} fds_stat_t;
+
+typedef void (*fds_cb_t)(fds_evt_t const *p_evt);
+
+ret_code_t fds_register(fds_cb_t cb);
+ret_code_t fds_init(void);
+ret_code_t fds_gc(void);
+ret_code_t fds_record_find(uint16_t file_id, uint16_t record_key, fds_record_desc_t *p_desc, fds_find_token_t *p_token);
+ret_code_t fds_record_open(fds_record_desc_t *p_desc, fds_flash_record_t *p_flash_record);
+ret_code_t fds_record_close(fds_record_desc_t *p_desc);
+ret_code_t fds_record_write(fds_record_desc_t *p_desc, fds_record_t const *p_record);
+ret_code_t fds_record_update(fds_record_desc_t *p_desc, fds_record_t const *p_record);
+ret_code_t fds_record_delete(fds_record_desc_t *p_desc);
+ret_code_t fds_stat(fds_stat_t *p_stat);
+
+#endif
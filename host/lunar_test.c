@@ -0,0 +1,363 @@
+// Host test of the calendar engine (GUI/Lunar.c)
+// Checks the integer civil date functions (days_from_civil, civil_from_days,
+// weekday_from_days, week_of_year) against timegm/gmtime/strftime of libc for
+// every day of the supported range, every lunar year and solar term against the
+// reference data in host/lunar_ref.txt, and the lunar date iterator (LUNAR_IterInit/
+// Next/Advance) against per-day conversion (LUNAR_SolarToLunar) for every day of
+// the benchmark range. With -b, times the iterator against per-day conversion instead.
+#define _DEFAULT_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include "Lunar.h"
+
+// Range and repeat count of the benchmark
+#define BENCH_FIRST_YEAR 2000
+#define BENCH_LAST_YEAR  2050
+#define BENCH_ROUNDS     20
+
+// 1970 (day 0) up to the last year of the lunar table
+#define CIVIL_FIRST_YEAR 1970
+#define CIVIL_LAST_YEAR  2199
+
+static int m_failed = 0;
+
+#define CHECK(cond, ...)                     \
+    do {                                     \
+        if (!(cond)) {                       \
+            if (m_failed++ < 20) {           \
+                printf("FAIL " __VA_ARGS__); \
+                printf("\n");                \
+            }                                \
+        }                                    \
+    } while (0)
+
+typedef struct {
+    uint16_t year;
+    uint8_t month;
+    uint8_t day;
+} date_t;
+
+static uint8_t MonthDays(uint16_t year, uint8_t month)
+{
+    static const uint8_t days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    int leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    return days[month - 1] + (month == 2 && leap);
+}
+
+static void NextDay(date_t *date)
+{
+    if (++date->day > MonthDays(date->year, date->month)) {
+        date->day = 1;
+        if (++date->month > 12) {
+            date->month = 1;
+            date->year++;
+        }
+    }
+}
+
+static void TestCivil(void)
+{
+    uint32_t first = days_from_civil(CIVIL_FIRST_YEAR, 1, 1);
+    uint32_t last = days_from_civil(CIVIL_LAST_YEAR, 12, 31);
+    uint32_t count = 0;
+
+    CHECK(first == 0, "days_from_civil(%d-01-01) = %u, expected 0", CIVIL_FIRST_YEAR, first);
+
+    for (uint32_t days = first; days <= last; days++) {
+        time_t t = (time_t)days * SEC_PER_DY;
+        struct tm tm;
+        char week[4];
+
+        gmtime_r(&t, &tm);
+        strftime(week, sizeof(week), "%V", &tm);
+
+        uint16_t year = tm.tm_year + 1900;
+        uint8_t month = tm.tm_mon + 1, day = tm.tm_mday;
+        uint16_t y;
+        uint8_t m, d;
+
+        civil_from_days(days, &y, &m, &d);
+        CHECK(y == year && m == month && d == day, "civil_from_days(%u) = %d-%02d-%02d, expected %d-%02d-%02d",
+              days, y, m, d, year, month, day);
+        CHECK(days_from_civil(year, month, day) == days, "days_from_civil(%d-%02d-%02d) = %u, expected %u",
+              year, month, day, days_from_civil(year, month, day), days);
+        CHECK((time_t)days * SEC_PER_DY == timegm(&tm), "timegm(%d-%02d-%02d) differs", year, month, day);
+        CHECK(weekday_from_days(days) == tm.tm_wday, "weekday_from_days(%u) = %d, expected %d",
+              days, weekday_from_days(days), tm.tm_wday);
+        CHECK(week_of_year(year, month, day) == atoi(week), "week_of_year(%d-%02d-%02d) = %d, expected %s",
+              year, month, day, week_of_year(year, month, day), week);
+        CHECK(thisMonthMaxDays(year, month) == MonthDays(year, month), "thisMonthMaxDays(%d, %d) = %d, expected %d",
+              year, month, thisMonthMaxDays(year, month), MonthDays(year, month));
+        count++;
+    }
+
+    printf("civil: %u days (%d-%d) checked against libc\n", count, CIVIL_FIRST_YEAR, CIVIL_LAST_YEAR);
+}
+
+static int SameLunar(const struct Lunar_Date *a, const struct Lunar_Date *b)
+{
+    return a->Year == b->Year && a->Month == b->Month && a->IsLeap == b->IsLeap && a->Date == b->Date;
+}
+
+// One iterator stepped a day and one stepped a week at a time over the range, against LUNAR_SolarToLunar
+static void TestIterator(void)
+{
+    date_t date = { BENCH_FIRST_YEAR, 1, 1 };
+    lunar_iter_t iter, week;
+    uint32_t count = 0;
+
+    LUNAR_IterInit(&iter, date.year, date.month, date.day);
+    week = iter;
+    for (; date.year <= BENCH_LAST_YEAR; NextDay(&date), LUNAR_IterNext(&iter), count++) {
+        struct Lunar_Date lunar;
+
+        LUNAR_SolarToLunar(&lunar, date.year, date.month, date.day);
+        CHECK(SameLunar(&iter.date, &lunar), "LUNAR_IterNext(%d-%02d-%02d) = %d %s%d-%d, expected %d %s%d-%d",
+              date.year, date.month, date.day, iter.date.Year, iter.date.IsLeap ? "leap " : "", iter.date.Month,
+              iter.date.Date, lunar.Year, lunar.IsLeap ? "leap " : "", lunar.Month, lunar.Date);
+        if (count % 7 == 0) {
+            if (count > 0) LUNAR_IterAdvance(&week, 7);
+            CHECK(SameLunar(&week.date, &lunar), "LUNAR_IterAdvance(%d-%02d-%02d) = %d %s%d-%d, expected %d %s%d-%d",
+                  date.year, date.month, date.day, week.date.Year, week.date.IsLeap ? "leap " : "", week.date.Month,
+                  week.date.Date, lunar.Year, lunar.IsLeap ? "leap " : "", lunar.Month, lunar.Date);
+        }
+    }
+
+    printf("iterator: %u days (%d-%d) checked against LUNAR_SolarToLunar\n", count, BENCH_FIRST_YEAR,
+           BENCH_LAST_YEAR);
+}
+
+// Every day of the lunar year, by LUNAR_SolarToLunar and by an iterator walking the whole table
+static uint32_t CheckLunarYear(lunar_iter_t *iter, uint16_t lunar_year, uint32_t new_year, uint8_t leap,
+                               const uint8_t *month_days, uint8_t count)
+{
+    uint32_t days = new_year, checked = 0;
+
+    for (uint8_t i = 0; i < count; i++) {
+        struct Lunar_Date expected = {
+            .IsLeap = leap != 0 && i == leap,
+            .Month  = leap != 0 && i >= leap ? i : i + 1,
+            .Year   = lunar_year,
+        };
+        for (expected.Date = 1; expected.Date <= month_days[i]; expected.Date++, days++) {
+            struct Lunar_Date lunar;
+            uint16_t year;
+            uint8_t month, day;
+
+            civil_from_days(days, &year, &month, &day);
+            if (year <= 1999 || year >= 2200) continue; // solar years of LUNAR_SolarToLunar
+            if (iter->date.Year == 0)
+                LUNAR_IterInit(iter, year, month, day);
+            else
+                LUNAR_IterNext(iter);
+
+            LUNAR_SolarToLunar(&lunar, year, month, day);
+            CHECK(SameLunar(&lunar, &expected),
+                  "LUNAR_SolarToLunar(%d-%02d-%02d) = %d %s%d-%d, expected %d %s%d-%d", year, month, day,
+                  lunar.Year, lunar.IsLeap ? "leap " : "", lunar.Month, lunar.Date,
+                  expected.Year, expected.IsLeap ? "leap " : "", expected.Month, expected.Date);
+            CHECK(SameLunar(&iter->date, &expected),
+                  "LUNAR_IterNext(%d-%02d-%02d) = %d %s%d-%d, expected %d %s%d-%d", year, month, day,
+                  iter->date.Year, iter->date.IsLeap ? "leap " : "", iter->date.Month, iter->date.Date,
+                  expected.Year, expected.IsLeap ? "leap " : "", expected.Month, expected.Date);
+            checked++;
+        }
+    }
+    return checked;
+}
+
+static void CheckJieQi(uint16_t year, const uint8_t *term_days)
+{
+    for (uint8_t k = 0; k < 24; k++) {
+        uint8_t day = 0;
+        uint8_t ret = GetJieQi(year, k / 2 + 1, k % 2 ? 15 : 1, &day);
+        CHECK(ret == 1 && day == term_days[k], "GetJieQi(%d, %s) = %d-%02d, expected %d-%02d", year, JieQiStr[k],
+              k / 2 + 1, day, k / 2 + 1, term_days[k]);
+    }
+}
+
+static void TestReference(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    char line[256];
+    uint32_t years = 0, terms = 0, days = 0, next_new_year = 0;
+    lunar_iter_t iter = { .date.Year = 0 };
+
+    if (fp == NULL) {
+        perror(path);
+        m_failed++;
+        return;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        uint8_t values[24];
+        unsigned int year, solar_year, month, day, leap, v[24];
+        int n;
+
+        if (line[0] == 'L' && sscanf(line, "L %u %u-%u-%u %u %n", &year, &solar_year, &month, &day, &leap, &n) == 5) {
+            uint8_t count = 0;
+            uint32_t new_year = days_from_civil(solar_year, month, day), length = 0;
+            for (char *p = line + n; count < 13 && sscanf(p, "%u%n", &v[count], &n) == 1; p += n) {
+                values[count] = v[count];
+                length += v[count++];
+            }
+            CHECK(count == (leap ? 13 : 12), "%s: %u months in lunar year %u", path, count, year);
+            CHECK(next_new_year == 0 || new_year == next_new_year, "%s: lunar year %u does not follow %u",
+                  path, year, year - 1);
+            days += CheckLunarYear(&iter, year, new_year, leap, values, count);
+            next_new_year = new_year + length;
+            years++;
+        } else if (line[0] == 'T' && sscanf(line, "T %u %n", &year, &n) == 1) {
+            uint8_t count = 0;
+            for (char *p = line + n; count < 24 && sscanf(p, "%u%n", &v[count], &n) == 1; p += n) {
+                values[count] = v[count];
+                count++;
+            }
+            CHECK(count == 24, "%s: %u terms in year %u", path, count, year);
+            CheckJieQi(year, values);
+            terms += count;
+        }
+    }
+    fclose(fp);
+
+    printf("lunar: %u years (%u days), %u solar terms checked against %s\n", years, days, terms, path);
+}
+
+static uint32_t m_bench_sink;
+
+static double Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void Sink(const struct Lunar_Date *lunar)
+{
+    m_bench_sink += lunar->Year + lunar->Month + lunar->IsLeap + lunar->Date;
+}
+
+static void BenchLine(const char *name, const char *base, double base_s, const char *iter, double iter_s,
+                      uint32_t steps)
+{
+    printf("  %-11s %-19s %6.1f  %-19s %6.1f  %.1fx\n", name, base, base_s * 1e9 / steps / BENCH_ROUNDS,
+           iter, iter_s * 1e9 / steps / BENCH_ROUNDS, base_s / iter_s);
+}
+
+// Every day of BENCH_FIRST_YEAR..BENCH_LAST_YEAR: LUNAR_SolarToLunar per day against one
+// LUNAR_IterInit and LUNAR_IterNext, and the month view of DrawMonthDays (one iterator per
+// month) against per-day conversion; LUNAR_IterAdvance by a week against LUNAR_IterInit per week.
+static void Benchmark(void)
+{
+    double t, per_day, iter_next, month_day, month_iter, week_init, week_advance;
+    uint32_t count = 0, weeks = 0;
+    struct Lunar_Date lunar;
+    lunar_iter_t iter;
+    date_t date;
+
+    t = Now();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        for (date = (date_t){ BENCH_FIRST_YEAR, 1, 1 }; date.year <= BENCH_LAST_YEAR; NextDay(&date)) {
+            LUNAR_SolarToLunar(&lunar, date.year, date.month, date.day);
+            Sink(&lunar);
+        }
+    }
+    per_day = Now() - t;
+
+    t = Now();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        LUNAR_IterInit(&iter, BENCH_FIRST_YEAR, 1, 1);
+        count = 0;
+        for (date = (date_t){ BENCH_FIRST_YEAR, 1, 1 }; date.year <= BENCH_LAST_YEAR;
+             NextDay(&date), LUNAR_IterNext(&iter), count++)
+            Sink(&iter.date);
+    }
+    iter_next = Now() - t;
+
+    t = Now();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        for (uint16_t year = BENCH_FIRST_YEAR; year <= BENCH_LAST_YEAR; year++) {
+            for (uint8_t month = 1; month <= 12; month++) {
+                for (uint8_t day = 1; day <= MonthDays(year, month); day++) {
+                    LUNAR_SolarToLunar(&lunar, year, month, day);
+                    Sink(&lunar);
+                }
+            }
+        }
+    }
+    month_day = Now() - t;
+
+    t = Now();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        for (uint16_t year = BENCH_FIRST_YEAR; year <= BENCH_LAST_YEAR; year++) {
+            for (uint8_t month = 1; month <= 12; month++) {
+                LUNAR_IterInit(&iter, year, month, 1);
+                for (uint8_t day = 1; day <= MonthDays(year, month); day++, LUNAR_IterNext(&iter))
+                    Sink(&iter.date);
+            }
+        }
+    }
+    month_iter = Now() - t;
+
+    t = Now();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        date = (date_t){ BENCH_FIRST_YEAR, 1, 1 };
+        for (weeks = 0; date.year <= BENCH_LAST_YEAR; weeks++) {
+            LUNAR_IterInit(&iter, date.year, date.month, date.day);
+            Sink(&iter.date);
+            for (uint8_t i = 0; i < 7; i++) NextDay(&date);
+        }
+    }
+    week_init = Now() - t;
+
+    t = Now();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        LUNAR_IterInit(&iter, BENCH_FIRST_YEAR, 1, 1);
+        for (uint32_t i = 0; i < weeks; i++, LUNAR_IterAdvance(&iter, 7))
+            Sink(&iter.date);
+    }
+    week_advance = Now() - t;
+
+    printf("%u days (%d-%d), %d rounds, ns per day (per step for weekly)\n", count, BENCH_FIRST_YEAR,
+           BENCH_LAST_YEAR, BENCH_ROUNDS);
+    BenchLine("all days", "LUNAR_SolarToLunar", per_day, "LUNAR_IterNext", iter_next, count);
+    BenchLine("month view", "LUNAR_SolarToLunar", month_day, "LUNAR_IterInit+Next", month_iter, count);
+    BenchLine("weekly", "LUNAR_IterInit", week_init, "LUNAR_IterAdvance", week_advance, weeks);
+}
+
+static void Usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s [options] [reference]\n"
+        "  reference     lunar years and solar terms to check (default host/lunar_ref.txt)\n"
+        "  -b            time the lunar iterator against per-day conversion (%d-%d) instead\n",
+        prog, BENCH_FIRST_YEAR, BENCH_LAST_YEAR);
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "bh")) != -1) {
+        switch (opt) {
+            case 'b':
+                Benchmark();
+                return 0;
+            default:
+                Usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    TestCivil();
+    TestReference(optind < argc ? argv[optind] : "host/lunar_ref.txt");
+    TestIterator();
+
+    if (m_failed > 0)
+        printf("%d checks failed\n", m_failed);
+    return m_failed == 0 ? 0 : 1;
+}
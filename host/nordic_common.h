@@ -0,0 +1,12 @@
+// Host replacement of the nRF5 SDK header
+#ifndef NORDIC_COMMON_H__
+#define NORDIC_COMMON_H__
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) < (b) ? (b) : (a))
+#define UNUSED_PARAMETER(X) (void)(X)
+#define UNUSED_VARIABLE(X) (void)(X)
+#define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+#define BYTES_TO_WORDS(n_bytes) (((n_bytes) + 3) >> 2)
+
+#endif
@@ -0,0 +1,19 @@
+// Host replacement of the nRF5 SDK header, the few registers the application touches
+#ifndef NRF_H
+#define NRF_H
+
+#include <stdint.h>
+
+typedef struct {
+    struct {
+        uint32_t PART;
+    } INFO;
+} NRF_FICR_Type;
+
+extern NRF_FICR_Type host_ficr;
+#define NRF_FICR (&host_ficr)
+
+// Does not return on the device, the host marks a pending reset instead (see sdk_host.c)
+void NVIC_SystemReset(void);
+
+#endif
@@ -0,0 +1,11 @@
+// Host replacement of the nRF5 SDK header, delays advance the modeled time
+// of the virtual panel instead of sleeping (see EPD_host.c)
+#ifndef __NRF_DELAY_H__
+#define __NRF_DELAY_H__
+
+#include <stdint.h>
+
+void nrf_delay_ms(uint32_t ms);
+void nrf_delay_us(uint32_t us);
+
+#endif
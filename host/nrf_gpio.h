@@ -0,0 +1,16 @@
+// Host replacement of the nRF5 SDK header, pins are plain variables (see EPD_host.c)
+#ifndef NRF_GPIO_H__
+#define NRF_GPIO_H__
+
+#include <stdint.h>
+
+void nrf_gpio_pin_write(uint32_t pin, uint32_t value);
+uint32_t nrf_gpio_pin_read(uint32_t pin);
+void nrf_gpio_pin_toggle(uint32_t pin);
+
+typedef enum { NRF_GPIO_PIN_NOPULL, NRF_GPIO_PIN_PULLDOWN, NRF_GPIO_PIN_PULLUP = 3 } nrf_gpio_pin_pull_t;
+typedef enum { NRF_GPIO_PIN_NOSENSE, NRF_GPIO_PIN_SENSE_LOW = 3, NRF_GPIO_PIN_SENSE_HIGH = 2 } nrf_gpio_pin_sense_t;
+
+void nrf_gpio_cfg_sense_input(uint32_t pin, nrf_gpio_pin_pull_t pull_config, nrf_gpio_pin_sense_t sense_config);
+
+#endif
@@ -0,0 +1,28 @@
+// Host replacement of the nRF5 SDK header.
+// Release firmware is built with NRF_LOG_ENABLED = 0, where the log macros
+// expand to nothing and their arguments are NOT evaluated. Keep it that way by
+// default so the simulated command stream matches the device, and build with
+// -DEPD_HOST_LOG to print the driver logs instead.
+#ifndef NRF_LOG_H_
+#define NRF_LOG_H_
+
+#include <stdio.h>
+
+#if defined(EPD_HOST_LOG)
+#define NRF_LOG_DEBUG(...) printf(__VA_ARGS__)
+#define NRF_LOG_INFO(...) printf(__VA_ARGS__)
+#define NRF_LOG_ERROR(...) printf(__VA_ARGS__)
+#define NRF_LOG_HEXDUMP_DEBUG(p_data, len) \
+    do { \
+        for (uint32_t _i = 0; _i < (uint32_t)(len); _i++) \
+            printf("%02x%s", ((const uint8_t *)(p_data))[_i], (_i % 16 == 15) ? "\n" : " "); \
+        printf("\n"); \
+    } while (0)
+#else
+#define NRF_LOG_DEBUG(...)
+#define NRF_LOG_INFO(...)
+#define NRF_LOG_ERROR(...)
+#define NRF_LOG_HEXDUMP_DEBUG(p_data, len)
+#endif
+
+#endif
@@ -0,0 +1,10 @@
+// Host replacement of the nRF5 SDK header, the host calls the event handlers directly
+#ifndef NRF_SDH_BLE_H__
+#define NRF_SDH_BLE_H__
+
+#include "ble.h"
+#include "sdk_config.h"
+
+#define NRF_SDH_BLE_OBSERVER(_name, _prio, _handler, _context)
+
+#endif
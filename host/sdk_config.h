@@ -0,0 +1,7 @@
+// Host replacement of the application sdk_config.h, only what the service code uses
+#ifndef SDK_CONFIG_H
+#define SDK_CONFIG_H
+
+#define NRF_SDH_BLE_GATT_MAX_MTU_SIZE 247
+
+#endif
@@ -0,0 +1,398 @@
+// Host stubs of the SoftDevice, FDS, app_scheduler, app_timer and power management.
+// Only the calls made by EPD_service.c and EPD_config.c are implemented, with
+// the same contracts (buffer sizes, error codes) as on the device.
+#include <stdlib.h>
+#include <string.h>
+#include "ble.h"
+#include "ble_srv_common.h"
+#include "fds.h"
+#include "app_scheduler.h"
+#include "app_timer.h"
+#include "nrf_pwr_mgmt.h"
+#include "sdk_host.h"
+
+#define SCHED_QUEUE_SIZE      10   // as main.c
+#define SCHED_MAX_EVENT_SIZE  32
+#define TIMER_MAX             8
+#define FDS_MAX_RECORDS       32
+#define FDS_MAX_USERS         4    // sdk_config.h
+#define FDS_HEADER_WORDS      3    // record header, SDK 17
+#define FDS_PAGE_HEADER_WORDS 2
+#define FDS_DATA_WORDS        (SDK_HOST_FDS_DATA_PAGES * (SDK_HOST_FDS_PAGE_WORDS - FDS_PAGE_HEADER_WORDS))
+
+#define DEVICE_NAME "NRF_EPD_84AC"
+
+NRF_FICR_Type host_ficr = { .INFO = { .PART = 0x52811 } };
+
+static sdk_host_stats_t m_stats;
+static sdk_host_notify_t m_notify_handler;
+static bool m_reset_pending;
+static uint16_t m_next_handle = 1;
+
+void sdk_host_on_notify(sdk_host_notify_t handler)
+{
+    m_notify_handler = handler;
+}
+
+bool sdk_host_reset_pending(void)
+{
+    bool pending = m_reset_pending;
+    m_reset_pending = false;
+    return pending;
+}
+
+void sdk_host_request_reset(void)
+{
+    m_reset_pending = true;
+    m_stats.resets++;
+}
+
+sdk_host_stats_t *sdk_host_stats(void)
+{
+    return &m_stats;
+}
+
+void NVIC_SystemReset(void)
+{
+    sdk_host_request_reset();
+}
+
+void nrf_pwr_mgmt_shutdown(nrf_pwr_mgmt_shutdown_t shutdown_type)
+{
+    (void)shutdown_type;
+    sdk_host_request_reset();
+}
+
+// SoftDevice
+uint32_t sd_ble_uuid_vs_add(ble_uuid128_t const *p_vs_uuid, uint8_t *p_uuid_type)
+{
+    if (p_vs_uuid == NULL || p_uuid_type == NULL) return NRF_ERROR_NULL;
+    *p_uuid_type = BLE_UUID_TYPE_VENDOR_BEGIN;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gatts_service_add(uint8_t type, ble_uuid_t const *p_uuid, uint16_t *p_handle)
+{
+    (void)type;
+    if (p_uuid == NULL || p_handle == NULL) return NRF_ERROR_NULL;
+    *p_handle = m_next_handle++;
+    return NRF_SUCCESS;
+}
+
+uint32_t characteristic_add(uint16_t service_handle, ble_add_char_params_t *p_char_props,
+                            ble_gatts_char_handles_t *p_char_handle)
+{
+    (void)service_handle;
+    if (p_char_props == NULL || p_char_handle == NULL) return NRF_ERROR_NULL;
+    memset(p_char_handle, 0, sizeof(*p_char_handle));
+    m_next_handle++; // declaration
+    p_char_handle->value_handle = m_next_handle++;
+    if (p_char_props->char_props.notify || p_char_props->char_props.indicate)
+        p_char_handle->cccd_handle = m_next_handle++;
+    return NRF_SUCCESS;
+}
+
+bool ble_srv_is_notification_enabled(uint8_t const *p_encoded_data)
+{
+    return (p_encoded_data[0] | (p_encoded_data[1] << 8)) & 0x0001;
+}
+
+uint32_t sd_ble_gatts_hvx(uint16_t conn_handle, ble_gatts_hvx_params_t const *p_hvx_params)
+{
+    if (conn_handle == BLE_CONN_HANDLE_INVALID) return NRF_ERROR_INVALID_STATE;
+    if (p_hvx_params == NULL || p_hvx_params->p_len == NULL) return NRF_ERROR_NULL;
+
+    m_stats.notifications++;
+    m_stats.notify_bytes += *p_hvx_params->p_len;
+    if (m_notify_handler) m_notify_handler(p_hvx_params->p_data, *p_hvx_params->p_len);
+    return NRF_SUCCESS;
+}
+
+// *p_len is the buffer size on input, the name is not NUL terminated
+uint32_t sd_ble_gap_device_name_get(uint8_t *p_dev_name, uint16_t *p_len)
+{
+    uint16_t len = strlen(DEVICE_NAME);
+    if (p_len == NULL) return NRF_ERROR_NULL;
+    if (p_dev_name == NULL) {
+        *p_len = len;
+        return NRF_SUCCESS;
+    }
+    if (*p_len < len) return NRF_ERROR_NO_MEM;
+    memcpy(p_dev_name, DEVICE_NAME, len);
+    *p_len = len;
+    return NRF_SUCCESS;
+}
+
+// Scheduler
+static struct {
+    app_sched_event_handler_t handler;
+    uint16_t size;
+    uint64_t data[SCHED_MAX_EVENT_SIZE / sizeof(uint64_t)]; // aligned as the SDK queue
+} m_sched_queue[SCHED_QUEUE_SIZE];
+static uint8_t m_sched_head, m_sched_count;
+
+uint32_t app_sched_event_put(void const *p_event_data, uint16_t event_size, app_sched_event_handler_t handler)
+{
+    if (event_size > SCHED_MAX_EVENT_SIZE) return NRF_ERROR_INVALID_PARAM;
+    if (m_sched_count == SCHED_QUEUE_SIZE) {
+        m_stats.sched_overflows++;
+        return NRF_ERROR_NO_MEM;
+    }
+
+    uint8_t idx = (m_sched_head + m_sched_count) % SCHED_QUEUE_SIZE;
+    m_sched_queue[idx].handler = handler;
+    m_sched_queue[idx].size = event_size;
+    if (p_event_data && event_size > 0) memcpy(m_sched_queue[idx].data, p_event_data, event_size);
+    m_sched_count++;
+    return NRF_SUCCESS;
+}
+
+void app_sched_execute(void)
+{
+    while (m_sched_count > 0) {
+        uint8_t idx = m_sched_head;
+        m_sched_head = (m_sched_head + 1) % SCHED_QUEUE_SIZE;
+        m_sched_count--;
+        m_stats.sched_events++;
+        m_sched_queue[idx].handler(m_sched_queue[idx].size ? m_sched_queue[idx].data : NULL, m_sched_queue[idx].size);
+    }
+}
+
+// app_timer, handlers run from sdk_host_timers_advance() as from the RTC interrupt
+static app_timer_t *m_timers[TIMER_MAX];
+static uint32_t m_timer_ms;
+
+uint32_t app_timer_init(void)
+{
+    return NRF_SUCCESS;
+}
+
+uint32_t app_timer_create(app_timer_id_t const *p_timer_id, app_timer_mode_t mode,
+                          app_timer_timeout_handler_t timeout_handler)
+{
+    app_timer_t *timer = *p_timer_id;
+
+    if (timeout_handler == NULL) return NRF_ERROR_INVALID_PARAM;
+    for (uint8_t i = 0; i < TIMER_MAX; i++) {
+        if (m_timers[i] == NULL || m_timers[i] == timer) {
+            memset(timer, 0, sizeof(app_timer_t));
+            timer->handler = timeout_handler;
+            timer->repeated = mode == APP_TIMER_MODE_REPEATED;
+            m_timers[i] = timer;
+            return NRF_SUCCESS;
+        }
+    }
+    return NRF_ERROR_NO_MEM;
+}
+
+uint32_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void *p_context)
+{
+    if (timer_id->handler == NULL) return NRF_ERROR_INVALID_STATE;
+    if (timeout_ticks == 0) return NRF_ERROR_INVALID_PARAM;
+    timer_id->interval = timer_id->remaining = timeout_ticks;
+    timer_id->p_context = p_context;
+    timer_id->active = true;
+    return NRF_SUCCESS;
+}
+
+uint32_t app_timer_stop(app_timer_id_t timer_id)
+{
+    timer_id->active = false;
+    return NRF_SUCCESS;
+}
+
+uint32_t app_timer_cnt_get(void)
+{
+    return m_timer_ms;
+}
+
+void sdk_host_timers_advance(uint32_t ms)
+{
+    for (uint32_t step; ms > 0; ms -= step) {
+        step = ms;
+        for (uint8_t i = 0; i < TIMER_MAX; i++)
+            if (m_timers[i] && m_timers[i]->active && m_timers[i]->remaining < step) step = m_timers[i]->remaining;
+        m_timer_ms += step;
+        for (uint8_t i = 0; i < TIMER_MAX; i++) {
+            app_timer_t *timer = m_timers[i];
+            if (timer == NULL || !timer->active) continue;
+            timer->remaining -= step;
+            if (timer->remaining > 0) continue;
+            if (timer->repeated) timer->remaining = timer->interval;
+            else timer->active = false;
+            timer->handler(timer->p_context);
+        }
+        app_sched_execute();
+    }
+}
+
+// FDS, records in RAM. Updates and deletes leave the old copy in flash until
+// fds_gc(), like the real page layout, so the flash usage and GC runs follow
+// the device.
+static struct {
+    bool valid;
+    fds_header_t header;
+    uint32_t *data;
+} m_records[FDS_MAX_RECORDS];
+static uint32_t m_fds_used;  // words written since the last GC, live or not
+static uint32_t m_record_id;
+static fds_cb_t m_fds_cb[FDS_MAX_USERS];
+
+static void fds_event(fds_evt_id_t id, ret_code_t result, fds_header_t const *header)
+{
+    fds_evt_t evt = { .id = id, .result = result };
+    if (header) {
+        evt.write.record_id = header->record_id;
+        evt.write.file_id = header->file_id;
+        evt.write.record_key = header->record_key;
+    }
+    for (uint8_t i = 0; i < FDS_MAX_USERS; i++)
+        if (m_fds_cb[i]) m_fds_cb[i](&evt);
+}
+
+void sdk_host_flash_erase(void)
+{
+    for (uint8_t i = 0; i < FDS_MAX_RECORDS; i++) {
+        free(m_records[i].data);
+        m_records[i].data = NULL;
+        m_records[i].valid = false;
+    }
+    m_fds_used = 0;
+    m_sched_count = 0;
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+// Handlers registered again after a simulated reset replace their old slot
+ret_code_t fds_register(fds_cb_t cb)
+{
+    for (uint8_t i = 0; i < FDS_MAX_USERS; i++) {
+        if (m_fds_cb[i] == NULL || m_fds_cb[i] == cb) {
+            m_fds_cb[i] = cb;
+            return NRF_SUCCESS;
+        }
+    }
+    return FDS_ERR_USER_LIMIT_REACHED;
+}
+
+ret_code_t fds_init(void)
+{
+    fds_event(FDS_EVT_INIT, NRF_SUCCESS, NULL);
+    return NRF_SUCCESS;
+}
+
+ret_code_t fds_gc(void)
+{
+    m_fds_used = 0;
+    for (uint8_t i = 0; i < FDS_MAX_RECORDS; i++)
+        if (m_records[i].valid) m_fds_used += FDS_HEADER_WORDS + m_records[i].header.length_words;
+    m_stats.gc_runs++;
+    fds_event(FDS_EVT_GC, NRF_SUCCESS, NULL);
+    return NRF_SUCCESS;
+}
+
+// The token holds the index of the next record to look at
+ret_code_t fds_record_find(uint16_t file_id, uint16_t record_key, fds_record_desc_t *p_desc, fds_find_token_t *p_token)
+{
+    if (p_desc == NULL || p_token == NULL) return NRF_ERROR_NULL;
+    for (uint16_t i = p_token->page; i < FDS_MAX_RECORDS; i++) {
+        if (m_records[i].valid && m_records[i].header.file_id == file_id && m_records[i].header.record_key == record_key) {
+            memset(p_desc, 0, sizeof(*p_desc));
+            p_desc->record_id = m_records[i].header.record_id;
+            p_token->page = i + 1;
+            return NRF_SUCCESS;
+        }
+    }
+    return FDS_ERR_NOT_FOUND;
+}
+
+static int fds_record_index(fds_record_desc_t *p_desc)
+{
+    for (uint8_t i = 0; i < FDS_MAX_RECORDS; i++)
+        if (m_records[i].valid && m_records[i].header.record_id == p_desc->record_id) return i;
+    return -1;
+}
+
+ret_code_t fds_record_open(fds_record_desc_t *p_desc, fds_flash_record_t *p_flash_record)
+{
+    int i = fds_record_index(p_desc);
+    if (i < 0) return FDS_ERR_NOT_FOUND;
+    p_flash_record->p_header = &m_records[i].header;
+    p_flash_record->p_data = m_records[i].data;
+    p_desc->record_is_open = true;
+    return NRF_SUCCESS;
+}
+
+ret_code_t fds_record_close(fds_record_desc_t *p_desc)
+{
+    p_desc->record_is_open = false;
+    return NRF_SUCCESS;
+}
+
+ret_code_t fds_record_write(fds_record_desc_t *p_desc, fds_record_t const *p_record)
+{
+    uint32_t words = FDS_HEADER_WORDS + p_record->data.length_words;
+    int slot = -1;
+
+    for (uint8_t i = 0; i < FDS_MAX_RECORDS && slot < 0; i++)
+        if (!m_records[i].valid) slot = i;
+    if (slot < 0 || m_fds_used + words > FDS_DATA_WORDS) {
+        m_stats.flash_full++;
+        return FDS_ERR_NO_SPACE_IN_FLASH;
+    }
+
+    free(m_records[slot].data);
+    m_records[slot].data = malloc(p_record->data.length_words * sizeof(uint32_t) + 1);
+    if (m_records[slot].data == NULL) return FDS_ERR_NO_SPACE_IN_FLASH;
+    memcpy(m_records[slot].data, p_record->data.p_data, p_record->data.length_words * sizeof(uint32_t));
+    m_records[slot].header.file_id = p_record->file_id;
+    m_records[slot].header.record_key = p_record->key;
+    m_records[slot].header.length_words = p_record->data.length_words;
+    m_records[slot].header.record_id = ++m_record_id;
+    m_records[slot].valid = true;
+
+    m_fds_used += words;
+    m_stats.flash_writes++;
+    m_stats.flash_words += words;
+    if (p_desc) {
+        memset(p_desc, 0, sizeof(*p_desc));
+        p_desc->record_id = m_record_id;
+    }
+    fds_event(FDS_EVT_WRITE, NRF_SUCCESS, &m_records[slot].header);
+    return NRF_SUCCESS;
+}
+
+ret_code_t fds_record_update(fds_record_desc_t *p_desc, fds_record_t const *p_record)
+{
+    int i = fds_record_index(p_desc);
+    if (i < 0) return FDS_ERR_NOT_FOUND;
+
+    ret_code_t ret = fds_record_write(p_desc, p_record);
+    if (ret == NRF_SUCCESS) m_records[i].valid = false; // old copy is dirty until GC
+    return ret;
+}
+
+ret_code_t fds_record_delete(fds_record_desc_t *p_desc)
+{
+    int i = fds_record_index(p_desc);
+    if (i < 0) return FDS_ERR_NOT_FOUND;
+    m_records[i].valid = false;
+    m_stats.flash_deletes++;
+    fds_event(FDS_EVT_DEL_RECORD, NRF_SUCCESS, &m_records[i].header);
+    return NRF_SUCCESS;
+}
+
+ret_code_t fds_stat(fds_stat_t *p_stat)
+{
+    uint32_t live = 0;
+
+    memset(p_stat, 0, sizeof(*p_stat));
+    for (uint8_t i = 0; i < FDS_MAX_RECORDS; i++) {
+        if (!m_records[i].valid) continue;
+        p_stat->valid_records++;
+        live += FDS_HEADER_WORDS + m_records[i].header.length_words;
+    }
+    p_stat->words_used = m_fds_used;
+    p_stat->largest_contig = FDS_DATA_WORDS - m_fds_used;
+    p_stat->freeable_words = m_fds_used - live;
+    return NRF_SUCCESS;
+}
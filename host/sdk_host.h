@@ -0,0 +1,46 @@
+// Host stubs of the SoftDevice, FDS, app_scheduler, app_timer and power management
+// (sdk_host.c), enough to run EPD_service.c and EPD_config.c on a PC.
+#ifndef __SDK_HOST_H
+#define __SDK_HOST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Flash layout of the nRF52 build: FDS_VIRTUAL_PAGES 2 (one is the swap page), 1024 words each
+#define SDK_HOST_FDS_PAGE_WORDS 1024
+#define SDK_HOST_FDS_DATA_PAGES 1
+
+typedef struct
+{
+    uint32_t notifications;   /**< sd_ble_gatts_hvx calls */
+    uint32_t notify_bytes;    /**< bytes sent in notifications */
+    uint32_t sched_events;    /**< events run by app_sched_execute */
+    uint32_t sched_overflows; /**< app_sched_event_put calls rejected (queue full) */
+    uint32_t flash_writes;    /**< FDS record writes and updates */
+    uint32_t flash_words;     /**< words written to flash, including record headers */
+    uint32_t flash_deletes;   /**< FDS record deletes */
+    uint32_t flash_full;      /**< writes rejected with FDS_ERR_NO_SPACE_IN_FLASH */
+    uint32_t gc_runs;         /**< FDS garbage collections */
+    uint32_t resets;          /**< NVIC_SystemReset / nrf_pwr_mgmt_shutdown / sleep requests */
+} sdk_host_stats_t;
+
+typedef void (*sdk_host_notify_t)(uint8_t const *data, uint16_t len);
+
+// Called for every notification sent to the peer
+void sdk_host_on_notify(sdk_host_notify_t handler);
+
+// True once after the firmware requested a reset or system off, the caller
+// then reboots the application (flash content is kept)
+bool sdk_host_reset_pending(void);
+void sdk_host_request_reset(void);
+
+// Runs the app_timer handlers due in the next ms milliseconds, then the scheduler
+void sdk_host_timers_advance(uint32_t ms);
+
+// Erase all FDS records, as a fresh device
+void sdk_host_flash_erase(void);
+
+// Statistics since the last sdk_host_flash_erase()
+sdk_host_stats_t *sdk_host_stats(void);
+
+#endif
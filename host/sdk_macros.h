@@ -0,0 +1,14 @@
+// Host replacement of the nRF5 SDK header
+#ifndef SDK_MACROS_H__
+#define SDK_MACROS_H__
+
+#include "sdk_errors.h"
+
+#define VERIFY_SUCCESS(statement)           \
+    do {                                    \
+        uint32_t _err_code = (statement);   \
+        if (_err_code != NRF_SUCCESS)       \
+            return _err_code;               \
+    } while (0)
+
+#endif
@@ -2,6 +2,7 @@ let bleDevice, gattServer;
 let epdService, epdCharacteristic;
 let startTime, msgIndex, appVersion;
 let canvas, ctx, textDecoder;
+let captureData;
 
 const EpdCmd = {
   SET_PINS:  0x00,
@@ -13,9 +14,19 @@ const EpdCmd = {
   SLEEP:     0x06,
 
   SET_TIME:  0x20,
+  GET_CLOCK: 0x22,
 
   WRITE_IMG: 0x30, // v1.6
 
+  CAPTURE_START: 0x40,
+  CAPTURE_STOP:  0x41,
+  CAPTURE_READ:  0x42,
+
+  BATTERY_STATUS:  0x50,
+  BATTERY_HISTORY: 0x51,
+  BATTERY_POLICY:  0x52,
+  ENERGY:          0x53,
+
   SET_CONFIG: 0x90,
   SYS_RESET:  0x91,
   SYS_SLEEP:  0x92,
@@ -69,6 +80,7 @@ function resetVariables() {
   gattServer = null;
   epdService = null;
   epdCharacteristic = null;
+  captureData = null;
   msgIndex = 0;
   document.getElementById("log").value = '';
 }
@@ -155,6 +167,90 @@ async function clearScreen() {
   }
 }
 
+async function startCapture() {
+  if (await write(EpdCmd.CAPTURE_START)) {
+    addLog("已开始抓包，固件需使用 CAPTURE=<缓冲区大小> 编译。");
+  }
+}
+
+async function downloadCapture() {
+  await write(EpdCmd.CAPTURE_STOP);
+  captureData = [];
+  await write(EpdCmd.CAPTURE_READ, [0, 0]);
+}
+
+async function readBattery() {
+  await write(EpdCmd.BATTERY_STATUS);
+  await write(EpdCmd.BATTERY_HISTORY);
+  await write(EpdCmd.ENERGY, [0]);
+}
+
+// Voltage byte of the battery replies: 10 mV steps above 1 V, 0xFF: no sample
+function batteryVolts(level) {
+  return level == 0xFF ? '-' : ((level * 10 + 1000) / 1000).toFixed(2);
+}
+
+// Reply of BATTERY_STATUS: 0x50, state, capacity, mV, days left, policy, low/critical/empty thresholds
+// Reply of BATTERY_HISTORY: 0x51, hourly (24) and daily (14) minimum voltages, newest first
+function handleBattery(data) {
+  if (data[0] == EpdCmd.BATTERY_STATUS) {
+    const states = ['正常', '电量低', '电量严重不足', '电量耗尽'];
+    const mv = (data[3] << 8) | data[4];
+    const days = (data[5] << 8) | data[6];
+    addLog(`电池: ${states[data[1]] || data[1]}, ${(mv / 1000).toFixed(2)}V, ${data[2] == 0xFF ? '-' : data[2]}%` +
+           `, 预计剩余 ${days == 0xFFFF ? '未知' : days + ' 天'}`);
+    addLog(`电池策略: 0x${data[7].toString(16)}, 阈值 ${batteryVolts(data[8])}V / ${batteryVolts(data[9])}V / ${batteryVolts(data[10])}V`);
+  } else {
+    const hourly = Array.from(data.slice(1, 25), batteryVolts);
+    const daily = Array.from(data.slice(25, 39), batteryVolts);
+    addLog(`每小时电压: ${hourly.join(' ')}`);
+    if (daily.length > 0) addLog(`每日电压: ${daily.join(' ')}`);
+  }
+}
+
+// Reply of ENERGY: 0x53, day, seconds, charge of sleep/advertising/connected/SPI/BUSY/render,
+// last display update and last BLE session (uC, big endian), truncated to the MTU
+function handleEnergy(data) {
+  const view = new DataView(data.buffer, data.byteOffset, data.byteLength);
+  const values = [];
+  for (let pos = 2; pos + 4 <= data.length; pos += 4) values.push(view.getUint32(pos));
+  if (values.length < 1) return;
+  const seconds = values[0];
+  const names = ['休眠', '广播', '连接', 'SPI', '刷新', '绘制'];
+  const charges = values.slice(1, 7);
+  const total = charges.reduce((sum, uc) => sum + uc, 0);
+  addLog(`能耗 (${data[1] == 0 ? '今天' : '昨天'}, ${(seconds / 3600).toFixed(1)} 小时): ` +
+         charges.map((uc, i) => `${names[i]} ${(uc / 3600).toFixed(2)}`).join(', ') + ' uAh');
+  if (seconds > 0 && charges.length == names.length)
+    addLog(`平均 ${(total / seconds).toFixed(1)} uA, 约 ${(total / seconds * 86400 / 3.6e6).toFixed(3)} mAh/天`);
+  if (values.length >= 9)
+    addLog(`上次刷新 ${(values[7] / 1000).toFixed(1)} mC, 上次连接 ${(values[8] / 1000).toFixed(1)} mC`);
+}
+
+// Reply of CAPTURE_READ: 0x42, offset (big endian), data; no data at the end of the stream
+async function handleCapture(data) {
+  const offset = (data[1] << 8) | data[2];
+  if (offset != captureData.length) return;
+  if (data.length > 3) {
+    captureData.push(...data.slice(3));
+    setStatus(`抓包数据: ${captureData.length} 字节`);
+    const next = captureData.length;
+    await write(EpdCmd.CAPTURE_READ, [next >> 8, next & 0xFF]);
+    return;
+  }
+  if (captureData.length == 0) {
+    addLog("没有抓包数据，固件可能未启用抓包功能。");
+  } else {
+    const link = document.createElement('a');
+    link.download = 'capture.bin';
+    link.href = URL.createObjectURL(new Blob([Uint8Array.from(captureData)], { type: 'application/octet-stream' }));
+    link.click();
+    URL.revokeObjectURL(link.href);
+    addLog(`抓包数据已下载: ${captureData.length} 字节，可使用 epd_replay 解析。`);
+  }
+  captureData = null;
+}
+
 async function sendcmd() {
   const cmdTXT = document.getElementById('cmdTXT').value;
   if (cmdTXT == '') return;
@@ -303,6 +399,9 @@ function updateButtonStatus(forceDisabled = false) {
   document.getElementById("clearscreenbutton").disabled = status;
   document.getElementById("sendimgbutton").disabled = status;
   document.getElementById("setDriverbutton").disabled = status;
+  document.getElementById("startcapturebutton").disabled = status;
+  document.getElementById("downloadcapturebutton").disabled = status;
+  document.getElementById("batterybutton").disabled = status;
 }
 
 function disconnect() {
@@ -358,6 +457,12 @@ function handleNotify(value, idx) {
     if (data.length > 10) epdpins.value += bytes2hex(data.slice(10, 11));
     epddriver.value = bytes2hex(data.slice(7, 8));
     updateDitcherOptions();
+  } else if (captureData != null && data.length >= 3 && data[0] == EpdCmd.CAPTURE_READ) {
+    handleCapture(data);
+  } else if ((data[0] == EpdCmd.BATTERY_STATUS && data.length == 11) || (data[0] == EpdCmd.BATTERY_HISTORY && data.length > 1)) {
+    handleBattery(data);
+  } else if (data[0] == EpdCmd.ENERGY && data.length >= 6 && data[1] <= 1) {
+    handleEnergy(data);
   } else {
     if (textDecoder == null) textDecoder = new TextDecoder();
     const msg = textDecoder.decode(data);
@@ -370,6 +475,9 @@ function handleNotify(value, idx) {
       const t = parseInt(msg.substring(2)) + new Date().getTimezoneOffset() * 60;
       addLog(`远端时间: ${new Date(t * 1000).toLocaleString()}`);
       addLog(`本地时间: ${new Date().toLocaleString()}`);
+    } else if (msg.startsWith('drift=') && msg.length > 6) {
+      const drift = parseInt(msg.substring(6)) / 10;
+      addLog(`时钟偏差: ${drift.toFixed(1)} ppm (每天 ${(drift * 0.0864).toFixed(1)} 秒)`);
     }
   }
 }
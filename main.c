@@ -34,10 +34,13 @@
 #include "nrf_power.h"
 #include "app_error.h"
 #include "app_timer.h"
+#include "app_util_platform.h"
 #include "app_scheduler.h"
 #include "nrf_drv_gpiote.h"
 #include "nrf_pwr_mgmt.h"
 #include "EPD_service.h"
+#include "EPD_battery.h"
+#include "EPD_energy.h"
 #include "main.h"
 
 #include "nrf_log.h"
@@ -51,6 +54,7 @@
 
 #define DEVICE_NAME                      "NRF_EPD"                                      /**< Name of device. Will be included in the advertising data. */
 #define APP_ADV_INTERVAL                 1600                                           /**< The advertising interval (in units of 0.625 ms. This value corresponds to 1 s). */
+#define APP_ADV_INTERVAL_LOW_BATTERY     4800                                           /**< The advertising interval on low battery (3 s), see BATTERY_POLICY_SLOW_ADV. */
 #define APP_ADV_TIMEOUT_IN_SECONDS       120                                            /**< The advertising timeout (in units of seconds). */
 #define APP_TIMER_PRESCALER              0                                              /**< Value of the RTC1 PRESCALER register. */
 #define APP_TIMER_OP_QUEUE_SIZE          4                                              /**< Size of timer operation queues. */
@@ -79,7 +83,13 @@
 #define SCHED_MAX_EVENT_DATA_SIZE       EPD_GUI_SCHD_EVENT_DATA_SIZE                    /**< Maximum size of scheduler events. */
 #define SCHED_QUEUE_SIZE                10                                              /**< Maximum number of events in the scheduler queue. */
 
-#define CLOCK_TIMER_INTERVAL             TIMER_TICKS(1000)                              /**< Clock timer interval (ticks). */
+#define CLOCK_TICKS_PER_SECOND           TIMER_TICKS(1000)                              /**< RTC ticks in one second of the clock. */
+#define CLOCK_DRIFT_PER_SECOND           10000000                                       /**< Accumulated drift (0.1 ppm x seconds) worth one second. */
+#if defined(S112)
+#define CLOCK_TIMER_MAX_WAIT             450                                            /**< Longest clock timer wait (seconds), the 24-bit RTC wraps at 512 s, a refresh may delay the timer event. */
+#else
+#define CLOCK_TIMER_MAX_WAIT             240                                            /**< Longest clock timer wait (seconds), below half of the 24-bit RTC range (SDK 12 app_timer). */
+#endif
 
 #define DEAD_BEEF                        0xDEADBEEF                                     /**< Value used as error code on stack dump, can be used to identify stack location on stack unwind. */
 
@@ -94,8 +104,12 @@ static ble_uuid_t                        m_adv_uuids[] = {{BLE_UUID_EPD_SVC, \
                                                            EPD_SVC_UUID_TYPE}};         /**< Universally unique service identifier. */
 
 BLE_EPD_DEF(m_epd);                                                                     /**< Structure to identify the EPD Service. */
-static uint32_t                          m_timestamp = 1735689600;                      /**< Current timestamp. */
+static uint32_t                          m_timestamp = 1735689600;                      /**< Timestamp at m_clock_ticks. */
+static uint32_t                          m_clock_ticks;                                 /**< RTC counter value at the start of the current second. */
+static int32_t                           m_clock_drift;                                 /**< Drift correction not applied yet (0.1 ppm x seconds). */
+static uint32_t                          m_next_update;                                 /**< Timestamp of the next display update, 0 if none. */
 APP_TIMER_DEF(m_clock_timer_id);                                                        /**< Clock timer. */
+static uint32_t                          m_adv_interval = APP_ADV_INTERVAL;             /**< Advertising interval (in units of 0.625 ms). */
 static uint32_t                          m_wdt_last_feed_time = 0;
 static uint32_t                          m_resetreas;
 
@@ -115,18 +129,70 @@ void assert_nrf_callback(uint16_t line_num, const uint8_t * p_file_name)
     app_error_handler(DEAD_BEEF, line_num, p_file_name);
 }
 
+// advance the timestamp by the whole seconds counted by the RTC since the last call,
+// corrected by the measured drift of the RC oscillator, returns the ticks elapsed in
+// the current second
+static uint32_t clock_update(void)
+{
+    uint32_t elapsed, seconds;
+
+    CRITICAL_REGION_ENTER();
+    elapsed = (app_timer_cnt_get() - m_clock_ticks) & 0xFFFFFF; // 24-bit RTC
+    seconds = elapsed / CLOCK_TICKS_PER_SECOND;
+    m_timestamp += seconds;
+    m_clock_ticks = (m_clock_ticks + seconds * CLOCK_TICKS_PER_SECOND) & 0xFFFFFF;
+    elapsed -= seconds * CLOCK_TICKS_PER_SECOND;
+
+    // a fast clock drops a second, a slow one adds it
+    m_clock_drift += (int32_t)seconds * epd_config_clock_drift(&m_epd.config);
+    if (m_clock_drift >= CLOCK_DRIFT_PER_SECOND) {
+        m_timestamp--;
+        m_clock_drift -= CLOCK_DRIFT_PER_SECOND;
+    } else if (m_clock_drift <= -CLOCK_DRIFT_PER_SECOND) {
+        m_timestamp++;
+        m_clock_drift += CLOCK_DRIFT_PER_SECOND;
+    }
+    CRITICAL_REGION_EXIT();
+
+    return elapsed;
+}
+
+// start the clock timer for the next display update, the RTC keeps the time in between.
+// clock_update() only sees the 24-bit counter, so a far update is reached in steps of
+// CLOCK_TIMER_MAX_WAIT. Wakeups per day, nRF51 / nRF52: calendar and picture 360 / 192,
+// clock 1440 / 1440, clock on low battery (5 min) 576 / 288.
+void clock_reschedule(void)
+{
+    uint32_t elapsed = clock_update();
+    uint32_t wait = CLOCK_TIMER_MAX_WAIT;
+
+    m_next_update = ble_epd_next_update(&m_epd, m_timestamp);
+    if (m_next_update != 0 && m_next_update - m_timestamp < wait)
+        wait = m_next_update - m_timestamp;
+
+    uint32_t ticks = wait * CLOCK_TICKS_PER_SECOND - elapsed;
+    if (ticks < APP_TIMER_MIN_TIMEOUT_TICKS) ticks = APP_TIMER_MIN_TIMEOUT_TICKS;
+
+    app_timer_stop(m_clock_timer_id);
+    APP_ERROR_CHECK(app_timer_start(m_clock_timer_id, ticks, NULL));
+}
+
 // return current timestamp
 uint32_t timestamp(void)
 {
+    clock_update();
     return m_timestamp;
 }
 
 // set the timestamp
 void set_timestamp(uint32_t timestamp)
 {
-    app_timer_stop(m_clock_timer_id);
+    CRITICAL_REGION_ENTER();
+    m_clock_ticks = app_timer_cnt_get();
     m_timestamp = timestamp;
-    app_timer_start(m_clock_timer_id, CLOCK_TIMER_INTERVAL, NULL);
+    m_clock_drift = 0;
+    CRITICAL_REGION_EXIT();
+    clock_reschedule();
 }
 
 // reload the wdt channel
@@ -158,7 +224,7 @@ static void advertising_config_get(ble_adv_modes_config_t * p_config)
     memset(p_config, 0, sizeof(ble_adv_modes_config_t));
 
     p_config->ble_adv_fast_enabled  = true;
-    p_config->ble_adv_fast_interval = APP_ADV_INTERVAL;
+    p_config->ble_adv_fast_interval = m_adv_interval;
     p_config->ble_adv_fast_timeout  = APP_ADV_TIMEOUT_IN_SECONDS * 100;
 }
 
@@ -229,9 +295,11 @@ static void clock_timer_timeout_handler(void * p_context)
 {
     UNUSED_PARAMETER(p_context);
 
-    m_timestamp++;
+    clock_update();
+    if (m_next_update != 0 && m_timestamp >= m_next_update)
+        ble_epd_on_timer(&m_epd, m_next_update, false);
 
-    ble_epd_on_timer(&m_epd, m_timestamp, false);
+    clock_reschedule();
 }
 
 /**@brief Function for the Event Scheduler initialization.
@@ -255,7 +323,7 @@ static void timers_init(void)
 #endif
     // Create timers.
     APP_ERROR_CHECK(app_timer_create(&m_clock_timer_id,
-                                     APP_TIMER_MODE_REPEATED,
+                                     APP_TIMER_MODE_SINGLE_SHOT,
                                      clock_timer_timeout_handler));
 }
 
@@ -264,12 +332,19 @@ static void timers_init(void)
 static void application_timers_start(void)
 {
     // Start application timers.
-    APP_ERROR_CHECK(app_timer_start(m_clock_timer_id, CLOCK_TIMER_INTERVAL, NULL));
+    set_timestamp(m_timestamp);
+}
+
+static void sleep_mode_shutdown(void)
+{
+    ble_epd_sleep_prepare(&m_epd);
+    nrf_pwr_mgmt_shutdown(NRF_PWR_MGMT_SHUTDOWN_GOTO_SYSOFF);
 }
 
 /**@brief Function for putting the chip into sleep mode.
  *
- * @note This function will not return.
+ * @details The pending config change is written to flash first, the chip goes
+ *          to system off from the FDS event.
  */
 void sleep_mode_enter(void)
 {
@@ -277,8 +352,7 @@ void sleep_mode_enter(void)
     NRF_LOG_FINAL_FLUSH();
     nrf_delay_ms(100);
 
-    ble_epd_sleep_prepare(&m_epd);
-    nrf_pwr_mgmt_shutdown(NRF_PWR_MGMT_SHUTDOWN_GOTO_SYSOFF);
+    epd_config_flush(sleep_mode_shutdown);
 }
 
 /**@brief Function for initializing services that will be used by the application.
@@ -393,8 +467,22 @@ static void conn_params_init(void)
 }
 
 
+static void advertising_init(void);
+
 static void advertising_start(void)
 {
+    uint32_t interval = epd_battery_policy(BATTERY_POLICY_SLOW_ADV) ? APP_ADV_INTERVAL_LOW_BATTERY : APP_ADV_INTERVAL;
+    if (interval != m_adv_interval) {
+        m_adv_interval = interval;
+#if defined(S112)
+        ble_adv_modes_config_t config;
+        advertising_config_get(&config);
+        ble_advertising_modes_config_set(&m_advertising, &config);
+#else
+        advertising_init();
+#endif
+    }
+
     NRF_LOG_INFO("advertising start\n");
 #if defined(S112)
     APP_ERROR_CHECK(ble_advertising_start(&m_advertising, BLE_ADV_MODE_FAST));
@@ -426,6 +514,13 @@ static void setup_wakeup_pin(nrf_drv_gpiote_pin_t pin) {
 }
 
 
+/**@brief Function for reporting a radio state change to the energy model.
+ */
+static void energy_radio(energy_state_t state)
+{
+    epd_energy_radio(state, m_adv_interval * 625 / 1000, timestamp());
+}
+
 /**@brief Function for handling advertising events.
  *
  * @details This function will be called for advertising events which are passed to the application.
@@ -437,9 +532,11 @@ static void on_adv_evt(ble_adv_evt_t ble_adv_evt)
     switch (ble_adv_evt)
     {
         case BLE_ADV_EVT_FAST:
+            energy_radio(ENERGY_ADVERTISING);
             break;
         case BLE_ADV_EVT_IDLE:
             NRF_LOG_INFO("advertising timeout\n");
+            energy_radio(ENERGY_SLEEP);
             if (m_epd.config.wakeup_pin != 0xFF) {
                 if (m_epd.config.display_mode == MODE_PICTURE)
                     sleep_mode_enter();
@@ -465,11 +562,13 @@ static void on_ble_evt(ble_evt_t * p_ble_evt)
         case BLE_GAP_EVT_CONNECTED:
             NRF_LOG_INFO("CONNECTED\n");
             m_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+            energy_radio(ENERGY_CONNECTED);
             break;
 
         case BLE_GAP_EVT_DISCONNECTED:
             NRF_LOG_INFO("DISCONNECTED\n");
             m_conn_handle = BLE_CONN_HANDLE_INVALID;
+            energy_radio(ENERGY_ADVERTISING); // restarted after a disconnect
 #if !defined(S112)
             advertising_start();
 #endif
@@ -667,7 +766,7 @@ static void advertising_init(void)
     init.srdata.uuids_complete.p_uuids  = m_adv_uuids;
 
     init.config.ble_adv_fast_enabled  = true;
-    init.config.ble_adv_fast_interval = APP_ADV_INTERVAL;
+    init.config.ble_adv_fast_interval = m_adv_interval;
     init.config.ble_adv_fast_timeout  = APP_ADV_TIMEOUT_IN_SECONDS * 100;
     init.evt_handler = on_adv_evt;
 
@@ -691,7 +790,7 @@ static void advertising_init(void)
 
     memset(&options, 0, sizeof(options));
     options.ble_adv_fast_enabled  = true;
-    options.ble_adv_fast_interval = APP_ADV_INTERVAL;
+    options.ble_adv_fast_interval = m_adv_interval;
     options.ble_adv_fast_timeout  = APP_ADV_TIMEOUT_IN_SECONDS;
 
     APP_ERROR_CHECK(ble_advertising_init(&advdata, &scanrsp, &options, on_adv_evt, NULL));
@@ -775,6 +874,7 @@ int main(void)
 
     if (m_resetreas & NRF_POWER_RESETREAS_DOG_MASK) {
         m_epd.config.display_mode = MODE_CALENDAR;
+        clock_reschedule();
         ble_epd_on_timer(&m_epd, 0, true);
     } else {
         ble_epd_on_timer(&m_epd, m_timestamp, true);
@@ -2,5 +2,6 @@
 
 uint32_t timestamp(void);
 void set_timestamp(uint32_t timestamp);
+void clock_reschedule(void);
 void sleep_mode_enter(void);
 void app_feed_wdt(void);